@@ -0,0 +1,431 @@
+/*
+ * Bit sliced AES for ARM NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This unit is built with -mfpu=neon and must only be entered between
+ * kernel_neon_begin() and kernel_neon_end().
+ *
+ * Eight blocks are processed in parallel.  The 128 bytes are transposed
+ * into eight 16 byte planes, plane p holding bit 7 - p of every byte,
+ * with byte j of a plane collecting that bit of byte j of all eight
+ * blocks.  SubBytes then becomes a boolean circuit on the planes
+ * (Boyar and Peralta), ShiftRows and the column rotations of MixColumns
+ * become byte shuffles of each plane, and nothing depends on secret data
+ * through a table lookup.
+ */
+
+#include <linux/types.h>
+#include <linux/string.h>
+#include "aesbs.h"
+
+typedef u8 u8x16 __attribute__((vector_size(16)));
+
+#define DUP16(x)	{ x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x }
+
+static const u8x16 sr_mask = {
+	0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11
+};
+static const u8x16 isr_mask = {
+	0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3
+};
+static const u8x16 rot1_mask = {
+	1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12
+};
+static const u8x16 rot2_mask = {
+	2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13
+};
+
+#define SWAPMOVE(a, b, n, m) do {			\
+	u8x16 __t = ((b >> n) ^ a) & (u8x16)DUP16(m);	\
+	a ^= __t;					\
+	b ^= __t << n;					\
+} while (0)
+
+/* Involution: turns eight blocks into eight planes and back */
+static inline void bitslice(u8x16 s[8])
+{
+	SWAPMOVE(s[0], s[1], 1, 0x55);
+	SWAPMOVE(s[2], s[3], 1, 0x55);
+	SWAPMOVE(s[4], s[5], 1, 0x55);
+	SWAPMOVE(s[6], s[7], 1, 0x55);
+
+	SWAPMOVE(s[0], s[2], 2, 0x33);
+	SWAPMOVE(s[1], s[3], 2, 0x33);
+	SWAPMOVE(s[4], s[6], 2, 0x33);
+	SWAPMOVE(s[5], s[7], 2, 0x33);
+
+	SWAPMOVE(s[0], s[4], 4, 0x0f);
+	SWAPMOVE(s[1], s[5], 4, 0x0f);
+	SWAPMOVE(s[2], s[6], 4, 0x0f);
+	SWAPMOVE(s[3], s[7], 4, 0x0f);
+}
+
+static inline void add_round_key(u8x16 s[8], const u8x16 *rk)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		s[i] ^= rk[i];
+}
+
+static inline void shift_rows(u8x16 s[8], u8x16 mask)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		s[i] = __builtin_shuffle(s[i], mask);
+}
+
+static inline void sub_bytes(u8x16 s[8])
+{
+	u8x16 x0, x1, x2, x3, x4, x5, x6, x7;
+	u8x16 y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11;
+	u8x16 y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+	u8x16 z0, z1, z2, z3, z4, z5, z6, z7, z8;
+	u8x16 z9, z10, z11, z12, z13, z14, z15, z16, z17;
+	u8x16 t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	u8x16 t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	u8x16 t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	u8x16 t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	u8x16 t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	u8x16 t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	u8x16 t60, t61, t62, t63, t64, t65, t66, t67;
+
+	x0 = s[0]; x1 = s[1]; x2 = s[2]; x3 = s[3];
+	x4 = s[4]; x5 = s[5]; x6 = s[6]; x7 = s[7];
+
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s[0] = t59 ^ t63;
+	s[6] = t56 ^ ~t62;
+	s[7] = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s[3] = t53 ^ t66;
+	s[4] = t51 ^ t66;
+	s[5] = t47 ^ t65;
+	s[1] = t64 ^ ~s[3];
+	s[2] = t55 ^ ~t67;
+}
+
+/*
+ * The inverse affine map of the S-box, with its constant: plane 7 - i
+ * gets bits i + 2, i + 5 and i + 7 of (x ^ 0x63).
+ */
+static inline void inv_affine(u8x16 s[8])
+{
+	u8x16 q[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		q[i] = s[7 - i];
+	q[0] = ~q[0];
+	q[1] = ~q[1];
+	q[5] = ~q[5];
+	q[6] = ~q[6];
+	for (i = 0; i < 8; i++)
+		s[7 - i] = q[(i + 2) & 7] ^ q[(i + 5) & 7] ^ q[(i + 7) & 7];
+}
+
+/* InvSubBytes(x) = B(SubBytes(B(x ^ 0x63)) ^ 0x63) */
+static inline void inv_sub_bytes(u8x16 s[8])
+{
+	inv_affine(s);
+	sub_bytes(s);
+	inv_affine(s);
+}
+
+/* Multiplication by x in GF(2^8), plane 0 is the top bit */
+static inline void xtime(u8x16 d[8], const u8x16 b[8])
+{
+	u8x16 hi = b[0];
+
+	d[0] = b[1];
+	d[1] = b[2];
+	d[2] = b[3];
+	d[3] = b[4] ^ hi;
+	d[4] = b[5] ^ hi;
+	d[5] = b[6];
+	d[6] = b[7] ^ hi;
+	d[7] = hi;
+}
+
+/*
+ * out = 2 * (a ^ rot1(a)) ^ rot1(a) ^ rot2(a ^ rot1(a)), where rot<n>
+ * rotates every column up by n rows.
+ */
+static inline void mix_columns(u8x16 s[8])
+{
+	u8x16 r[8], b[8], x[8];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		r[i] = __builtin_shuffle(s[i], rot1_mask);
+		b[i] = s[i] ^ r[i];
+	}
+	xtime(x, b);
+	for (i = 0; i < 8; i++)
+		s[i] = x[i] ^ r[i] ^ __builtin_shuffle(b[i], rot2_mask);
+}
+
+/*
+ * InvMixColumns(a) = MixColumns(a ^ 4 * (a ^ rot2(a)))
+ */
+static inline void inv_mix_columns(u8x16 s[8])
+{
+	u8x16 d[8], x[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		d[i] = s[i] ^ __builtin_shuffle(s[i], rot2_mask);
+	xtime(x, d);
+	xtime(d, x);
+	for (i = 0; i < 8; i++)
+		s[i] ^= d[i];
+	mix_columns(s);
+}
+
+static void aesbs_encrypt(u8x16 s[8], const u8 *bskey, int rounds)
+{
+	const u8x16 *rk = (const u8x16 *)bskey;
+	int r;
+
+	bitslice(s);
+	add_round_key(s, rk);
+	for (r = 1; r < rounds; r++) {
+		rk += 8;
+		sub_bytes(s);
+		shift_rows(s, sr_mask);
+		mix_columns(s);
+		add_round_key(s, rk);
+	}
+	sub_bytes(s);
+	shift_rows(s, sr_mask);
+	add_round_key(s, rk + 8);
+	bitslice(s);
+}
+
+static void aesbs_decrypt(u8x16 s[8], const u8 *bskey, int rounds)
+{
+	const u8x16 *rk = (const u8x16 *)bskey + 8 * rounds;
+	int r;
+
+	bitslice(s);
+	add_round_key(s, rk);
+	for (r = rounds - 1; r > 0; r--) {
+		rk -= 8;
+		shift_rows(s, isr_mask);
+		inv_sub_bytes(s);
+		add_round_key(s, rk);
+		inv_mix_columns(s);
+	}
+	shift_rows(s, isr_mask);
+	inv_sub_bytes(s);
+	add_round_key(s, rk - 8);
+	bitslice(s);
+}
+
+static inline void load8(u8x16 s[8], const u8 *in)
+{
+	memcpy(s, in, 8 * AESBS_BLOCK_SIZE);
+}
+
+static inline void store8(u8 *out, const u8x16 s[8])
+{
+	memcpy(out, s, 8 * AESBS_BLOCK_SIZE);
+}
+
+void aesbs_ecb_encrypt8(u8 *out, const u8 *in, const u8 *bskey, int rounds)
+{
+	u8x16 s[8];
+
+	load8(s, in);
+	aesbs_encrypt(s, bskey, rounds);
+	store8(out, s);
+}
+
+void aesbs_ecb_decrypt8(u8 *out, const u8 *in, const u8 *bskey, int rounds)
+{
+	u8x16 s[8];
+
+	load8(s, in);
+	aesbs_decrypt(s, bskey, rounds);
+	store8(out, s);
+}
+
+/* @iv is updated to the last ciphertext block; @out may equal @in */
+void aesbs_cbc_decrypt8(u8 *out, const u8 *in, u8 *iv, const u8 *bskey,
+			int rounds)
+{
+	u8x16 s[8], c[8], v;
+	int i;
+
+	load8(c, in);
+	memcpy(s, c, sizeof(s));
+	aesbs_decrypt(s, bskey, rounds);
+
+	memcpy(&v, iv, AESBS_BLOCK_SIZE);
+	s[0] ^= v;
+	for (i = 1; i < 8; i++)
+		s[i] ^= c[i - 1];
+	memcpy(iv, &c[7], AESBS_BLOCK_SIZE);
+	store8(out, s);
+}
+
+/* @ctrblks holds the eight counter blocks to encrypt */
+void aesbs_ctr_encrypt8(u8 *out, const u8 *in, const u8 *ctrblks,
+			const u8 *bskey, int rounds)
+{
+	u8x16 s[8], d[8];
+	int i;
+
+	load8(s, ctrblks);
+	aesbs_encrypt(s, bskey, rounds);
+	load8(d, in);
+	for (i = 0; i < 8; i++)
+		s[i] ^= d[i];
+	store8(out, s);
+}
+
+/* @tweaks holds the eight XTS tweaks of the blocks */
+void aesbs_xts_encrypt8(u8 *out, const u8 *in, const u8 *tweaks,
+			const u8 *bskey, int rounds)
+{
+	u8x16 s[8], t[8];
+	int i;
+
+	load8(s, in);
+	load8(t, tweaks);
+	for (i = 0; i < 8; i++)
+		s[i] ^= t[i];
+	aesbs_encrypt(s, bskey, rounds);
+	for (i = 0; i < 8; i++)
+		s[i] ^= t[i];
+	store8(out, s);
+}
+
+void aesbs_xts_decrypt8(u8 *out, const u8 *in, const u8 *tweaks,
+			const u8 *bskey, int rounds)
+{
+	u8x16 s[8], t[8];
+	int i;
+
+	load8(s, in);
+	load8(t, tweaks);
+	for (i = 0; i < 8; i++)
+		s[i] ^= t[i];
+	aesbs_decrypt(s, bskey, rounds);
+	for (i = 0; i < 8; i++)
+		s[i] ^= t[i];
+	store8(out, s);
+}
@@ -0,0 +1,483 @@
+/*
+ * Glue code for the bit sliced NEON version of the AES Cipher Algorithm
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The NEON code handles eight blocks at a time.  CBC encryption, which
+ * cannot be parallelized, the tails of a walk and any call made from
+ * interrupt context, where NEON may not be used, go through the scalar
+ * ARM implementation instead.
+ */
+
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <linux/hardirq.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/gf128mul.h>
+#include <asm/neon.h>
+
+#include "aes_glue.h"
+#include "aesbs.h"
+
+#define AESBS_BATCH	(8 * AES_BLOCK_SIZE)
+
+struct aesbs_ctx {
+	u8 bskey[AESBS_KEY_SIZE] __aligned(16);
+	int rounds;
+	AES_KEY enc;
+	AES_KEY dec;
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx data;
+	AES_KEY twkey;
+};
+
+static inline bool aesbs_use_neon(void)
+{
+	return !in_interrupt();
+}
+
+/*
+ * Round key r becomes eight planes, plane p having byte j set to 0xff
+ * when bit 7 - p of byte j of the round key is set.
+ */
+static int aesbs_set_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			 unsigned int key_len)
+{
+	struct crypto_aes_ctx rk;
+	u8 *p = ctx->bskey;
+	int r, i, j;
+
+	if (crypto_aes_expand_key(&rk, in_key, key_len))
+		return -EINVAL;
+
+	ctx->rounds = 6 + key_len / 4;
+	for (r = 0; r <= ctx->rounds; r++)
+		for (i = 0; i < 8; i++)
+			for (j = 0; j < AES_BLOCK_SIZE; j++) {
+				u8 b = rk.key_enc[4 * r + j / 4] >> (8 * (j % 4));
+
+				*p++ = (b >> (7 - i)) & 1 ? 0xff : 0;
+			}
+
+	if (private_AES_set_encrypt_key(in_key, key_len * 8, &ctx->enc) == -1)
+		return -EINVAL;
+	ctx->dec = ctx->enc;
+	if (private_AES_set_decrypt_key(in_key, key_len * 8, &ctx->dec) == -1)
+		return -EINVAL;
+
+	memset(&rk, 0, sizeof(rk));
+	return 0;
+}
+
+static int aesbs_setkey(struct crypto_tfm *tfm, const u8 *in_key,
+			unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (aesbs_set_key(ctx, in_key, key_len)) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int aesbs_xts_setkey(struct crypto_tfm *tfm, const u8 *in_key,
+			    unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if ((key_len & 1) || aesbs_set_key(&ctx->data, in_key, key_len / 2) ||
+	    private_AES_set_encrypt_key(in_key + key_len / 2, key_len * 4,
+					&ctx->twkey) == -1) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int aesbs_ecb_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, bool enc)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	bool neon = aesbs_use_neon();
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_BATCH);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		if (neon && nbytes >= AESBS_BATCH) {
+			kernel_neon_begin();
+			do {
+				if (enc)
+					aesbs_ecb_encrypt8(out, in, ctx->bskey,
+							   ctx->rounds);
+				else
+					aesbs_ecb_decrypt8(out, in, ctx->bskey,
+							   ctx->rounds);
+				in += AESBS_BATCH;
+				out += AESBS_BATCH;
+				nbytes -= AESBS_BATCH;
+			} while (nbytes >= AESBS_BATCH);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			if (enc)
+				AES_encrypt(in, out, &ctx->enc);
+			else
+				AES_decrypt(in, out, &ctx->dec);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_ecb_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, true);
+}
+
+static int aesbs_ecb_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, false);
+}
+
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			crypto_xor(iv, in, AES_BLOCK_SIZE);
+			AES_encrypt(iv, out, &ctx->enc);
+			iv = out;
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		}
+		memcpy(walk.iv, iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	bool neon = aesbs_use_neon();
+	struct blkcipher_walk walk;
+	u8 buf[AES_BLOCK_SIZE];
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_BATCH);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		if (neon && nbytes >= AESBS_BATCH) {
+			kernel_neon_begin();
+			do {
+				aesbs_cbc_decrypt8(out, in, walk.iv,
+						   ctx->bskey, ctx->rounds);
+				in += AESBS_BATCH;
+				out += AESBS_BATCH;
+				nbytes -= AESBS_BATCH;
+			} while (nbytes >= AESBS_BATCH);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			memcpy(buf, in, AES_BLOCK_SIZE);
+			AES_decrypt(in, out, &ctx->dec);
+			crypto_xor(out, walk.iv, AES_BLOCK_SIZE);
+			memcpy(walk.iv, buf, AES_BLOCK_SIZE);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static inline void aesbs_ctr_inc(u8 *ctr)
+{
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i >= 0; i--)
+		if (++ctr[i])
+			break;
+}
+
+static int aesbs_ctr_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	bool neon = aesbs_use_neon();
+	struct blkcipher_walk walk;
+	u8 ctrblks[AESBS_BATCH];
+	u8 ks[AES_BLOCK_SIZE];
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_BATCH);
+
+	while (walk.nbytes >= AES_BLOCK_SIZE) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		nbytes = walk.nbytes;
+		if (neon && nbytes >= AESBS_BATCH) {
+			kernel_neon_begin();
+			do {
+				for (i = 0; i < 8; i++) {
+					memcpy(ctrblks + i * AES_BLOCK_SIZE,
+					       walk.iv, AES_BLOCK_SIZE);
+					aesbs_ctr_inc(walk.iv);
+				}
+				aesbs_ctr_encrypt8(out, in, ctrblks,
+						   ctx->bskey, ctx->rounds);
+				in += AESBS_BATCH;
+				out += AESBS_BATCH;
+				nbytes -= AESBS_BATCH;
+			} while (nbytes >= AESBS_BATCH);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			AES_encrypt(walk.iv, ks, &ctx->enc);
+			aesbs_ctr_inc(walk.iv);
+			if (out != in)
+				memcpy(out, in, AES_BLOCK_SIZE);
+			crypto_xor(out, ks, AES_BLOCK_SIZE);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	if (walk.nbytes) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		AES_encrypt(walk.iv, ks, &ctx->enc);
+		aesbs_ctr_inc(walk.iv);
+		crypto_xor(ks, in, walk.nbytes);
+		memcpy(out, ks, walk.nbytes);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+	return err;
+}
+
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, bool enc)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	bool neon = aesbs_use_neon();
+	struct blkcipher_walk walk;
+	be128 tweaks[8];
+	be128 t;
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_BATCH);
+	if (!walk.nbytes)
+		return err;
+
+	AES_encrypt(walk.iv, (u8 *)&t, &ctx->twkey);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		if (neon && nbytes >= AESBS_BATCH) {
+			kernel_neon_begin();
+			do {
+				for (i = 0; i < 8; i++) {
+					tweaks[i] = t;
+					gf128mul_x_ble(&t, &t);
+				}
+				if (enc)
+					aesbs_xts_encrypt8(out, in,
+							   (u8 *)tweaks,
+							   ctx->data.bskey,
+							   ctx->data.rounds);
+				else
+					aesbs_xts_decrypt8(out, in,
+							   (u8 *)tweaks,
+							   ctx->data.bskey,
+							   ctx->data.rounds);
+				in += AESBS_BATCH;
+				out += AESBS_BATCH;
+				nbytes -= AESBS_BATCH;
+			} while (nbytes >= AESBS_BATCH);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			be128 b;
+
+			memcpy(&b, in, AES_BLOCK_SIZE);
+			be128_xor(&b, &b, &t);
+			if (enc)
+				AES_encrypt((u8 *)&b, (u8 *)&b,
+					    &ctx->data.enc);
+			else
+				AES_decrypt((u8 *)&b, (u8 *)&b,
+					    &ctx->data.dec);
+			be128_xor(&b, &b, &t);
+			memcpy(out, &b, AES_BLOCK_SIZE);
+			gf128mul_x_ble(&t, &t);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		}
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, true);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, false);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "ecb(aes)",
+	.cra_driver_name	= "ecb-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.setkey		= aesbs_setkey,
+			.encrypt	= aesbs_ecb_encrypt,
+			.decrypt	= aesbs_ecb_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_setkey,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_setkey,
+			.encrypt	= aesbs_ctr_encrypt,
+			.decrypt	= aesbs_ctr_encrypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_setkey,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	crypto_unregister_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+module_init(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit sliced AES in ECB/CBC/CTR/XTS modes using NEON");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,29 @@
+/*
+ * Bit sliced AES for ARM NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __AESBS_H
+#define __AESBS_H
+
+#define AESBS_BLOCK_SIZE	16
+#define AESBS_MAXNR		14
+
+/* One 8 x 16 byte plane set per round key */
+#define AESBS_KEY_SIZE		((AESBS_MAXNR + 1) * 8 * AESBS_BLOCK_SIZE)
+
+void aesbs_ecb_encrypt8(u8 *out, const u8 *in, const u8 *bskey, int rounds);
+void aesbs_ecb_decrypt8(u8 *out, const u8 *in, const u8 *bskey, int rounds);
+void aesbs_cbc_decrypt8(u8 *out, const u8 *in, u8 *iv, const u8 *bskey,
+			int rounds);
+void aesbs_ctr_encrypt8(u8 *out, const u8 *in, const u8 *ctrblks,
+			const u8 *bskey, int rounds);
+void aesbs_xts_encrypt8(u8 *out, const u8 *in, const u8 *tweaks,
+			const u8 *bskey, int rounds);
+void aesbs_xts_decrypt8(u8 *out, const u8 *in, const u8 *tweaks,
+			const u8 *bskey, int rounds);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * SHA-256 and SHA-512 message schedules for ARM NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This unit is built with -mfpu=neon and must only be entered between
+ * kernel_neon_begin() and kernel_neon_end().
+ *
+ * The compression rounds are serial and stay in ARM code; what vectorizes
+ * is the message schedule, four SHA-256 or two SHA-512 words per step.
+ */
+
+#include <linux/types.h>
+#include <linux/string.h>
+#include "sha2-neon.h"
+
+typedef u8 u8x16 __attribute__((vector_size(16)));
+typedef u32 u32x4 __attribute__((vector_size(16)));
+typedef u64 u64x2 __attribute__((vector_size(16)));
+
+#define ROR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+#define S256_0(x)	(ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define S256_1(x)	(ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+#define S512_0(x)	(ROR64(x, 1) ^ ROR64(x, 8) ^ ((x) >> 7))
+#define S512_1(x)	(ROR64(x, 19) ^ ROR64(x, 61) ^ ((x) >> 6))
+
+static const u8x16 be32_mask = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+static const u8x16 be64_mask = {
+	7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+};
+
+static inline u32x4 load_u32x4(const u32 *p)
+{
+	u32x4 v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline u64x2 load_u64x2(const u64 *p)
+{
+	u64x2 v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * W[t + 2] and W[t + 3] depend on W[t] and W[t + 1] through sigma1, so
+ * each group of four is finished in two halves.
+ */
+void sha256_neon_expand(u32 *W, const u8 *data)
+{
+	const u32x4 zero = { 0, 0, 0, 0 };
+	const u32x4 hi_mask = { 4, 4, 0, 1 };
+	u8x16 b;
+	u32x4 v, x;
+	int t;
+
+	for (t = 0; t < 16; t += 4) {
+		memcpy(&b, data + 4 * t, sizeof(b));
+		b = __builtin_shuffle(b, be32_mask);
+		memcpy(W + t, &b, sizeof(b));
+	}
+
+	for (t = 16; t < 64; t += 4) {
+		x = load_u32x4(W + t - 15);
+		v = load_u32x4(W + t - 16) + S256_0(x) + load_u32x4(W + t - 7);
+
+		x = (u32x4){ W[t - 2], W[t - 1], 0, 0 };
+		v += S256_1(x);
+
+		x = __builtin_shuffle(v, zero, hi_mask);
+		v += S256_1(x);
+
+		memcpy(W + t, &v, sizeof(v));
+	}
+}
+
+void sha512_neon_expand(u64 *W, const u8 *data)
+{
+	u8x16 b;
+	u64x2 v, x;
+	int t;
+
+	for (t = 0; t < 16; t += 2) {
+		memcpy(&b, data + 8 * t, sizeof(b));
+		b = __builtin_shuffle(b, be64_mask);
+		memcpy(W + t, &b, sizeof(b));
+	}
+
+	for (t = 16; t < 80; t += 2) {
+		x = load_u64x2(W + t - 15);
+		v = load_u64x2(W + t - 16) + S512_0(x) + load_u64x2(W + t - 7);
+		x = load_u64x2(W + t - 2);
+		v += S512_1(x);
+		memcpy(W + t, &v, sizeof(v));
+	}
+}
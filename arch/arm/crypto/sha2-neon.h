@@ -0,0 +1,15 @@
+/*
+ * SHA-256 and SHA-512 message schedules for ARM NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __SHA2_NEON_H
+#define __SHA2_NEON_H
+
+void sha256_neon_expand(u32 *W, const u8 *data);
+void sha512_neon_expand(u64 *W, const u8 *data);
+
+#endif
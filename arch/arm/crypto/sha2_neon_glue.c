@@ -0,0 +1,497 @@
+/*
+ * Cryptographic API.
+ * Glue code for the SHA-224/256/384/512 algorithms using a NEON message
+ * schedule.
+ *
+ * This file is based on sha256_generic.c and sha512_generic.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/hardirq.h>
+#include <crypto/sha.h>
+#include <asm/byteorder.h>
+#include <asm/neon.h>
+
+#include "sha2-neon.h"
+
+static const u32 sha256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const u64 sha512_K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+#define e0_256(x)	(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1_256(x)	(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define s0_256(x)	(ror32(x, 7) ^ ror32(x, 18) ^ ((x) >> 3))
+#define s1_256(x)	(ror32(x, 17) ^ ror32(x, 19) ^ ((x) >> 10))
+
+#define e0_512(x)	(ror64(x, 28) ^ ror64(x, 34) ^ ror64(x, 39))
+#define e1_512(x)	(ror64(x, 14) ^ ror64(x, 18) ^ ror64(x, 41))
+#define s0_512(x)	(ror64(x, 1) ^ ror64(x, 8) ^ ((x) >> 7))
+#define s1_512(x)	(ror64(x, 19) ^ ror64(x, 61) ^ ((x) >> 6))
+
+static inline bool sha2_use_neon(void)
+{
+	return !in_interrupt();
+}
+
+static void sha256_expand(u32 *W, const u8 *data)
+{
+	int t;
+
+	for (t = 0; t < 16; t++)
+		W[t] = be32_to_cpu(((const __be32 *)data)[t]);
+	for (; t < 64; t++)
+		W[t] = s1_256(W[t - 2]) + W[t - 7] + s0_256(W[t - 15]) +
+		       W[t - 16];
+}
+
+static void sha512_expand(u64 *W, const u8 *data)
+{
+	int t;
+
+	for (t = 0; t < 16; t++)
+		W[t] = be64_to_cpu(((const __be64 *)data)[t]);
+	for (; t < 80; t++)
+		W[t] = s1_512(W[t - 2]) + W[t - 7] + s0_512(W[t - 15]) +
+		       W[t - 16];
+}
+
+static void sha256_transform(u32 *state, const u8 *data, unsigned int blocks)
+{
+	u32 W[64] __aligned(16);
+	bool neon = sha2_use_neon();
+	u32 a, b, c, d, e, f, g, h, t1, t2;
+	int t;
+
+	while (blocks--) {
+		if (neon) {
+			kernel_neon_begin();
+			sha256_neon_expand(W, data);
+			kernel_neon_end();
+		} else {
+			sha256_expand(W, data);
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (t = 0; t < 64; t++) {
+			t1 = h + e1_256(e) + Ch(e, f, g) + sha256_K[t] + W[t];
+			t2 = e0_256(a) + Maj(a, b, c);
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	memset(W, 0, sizeof(W));
+}
+
+static void sha512_transform(u64 *state, const u8 *data, unsigned int blocks)
+{
+	u64 W[80] __aligned(16);
+	bool neon = sha2_use_neon();
+	u64 a, b, c, d, e, f, g, h, t1, t2;
+	int t;
+
+	while (blocks--) {
+		if (neon) {
+			kernel_neon_begin();
+			sha512_neon_expand(W, data);
+			kernel_neon_end();
+		} else {
+			sha512_expand(W, data);
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (t = 0; t < 80; t++) {
+			t1 = h + e1_512(e) + Ch(e, f, g) + sha512_K[t] + W[t];
+			t2 = e0_512(a) + Maj(a, b, c);
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+		data += SHA512_BLOCK_SIZE;
+	}
+
+	memset(W, 0, sizeof(W));
+}
+
+static int sha224_neon_init(struct shash_desc *desc)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	sctx->state[0] = SHA224_H0;
+	sctx->state[1] = SHA224_H1;
+	sctx->state[2] = SHA224_H2;
+	sctx->state[3] = SHA224_H3;
+	sctx->state[4] = SHA224_H4;
+	sctx->state[5] = SHA224_H5;
+	sctx->state[6] = SHA224_H6;
+	sctx->state[7] = SHA224_H7;
+	sctx->count = 0;
+	return 0;
+}
+
+static int sha256_neon_init(struct shash_desc *desc)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	sctx->state[0] = SHA256_H0;
+	sctx->state[1] = SHA256_H1;
+	sctx->state[2] = SHA256_H2;
+	sctx->state[3] = SHA256_H3;
+	sctx->state[4] = SHA256_H4;
+	sctx->state[5] = SHA256_H5;
+	sctx->state[6] = SHA256_H6;
+	sctx->state[7] = SHA256_H7;
+	sctx->count = 0;
+	return 0;
+}
+
+static int sha256_neon_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int len)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+	unsigned int done = 0;
+
+	sctx->count += len;
+
+	if (partial + len < SHA256_BLOCK_SIZE) {
+		memcpy(sctx->buf + partial, data, len);
+		return 0;
+	}
+
+	if (partial) {
+		done = SHA256_BLOCK_SIZE - partial;
+		memcpy(sctx->buf + partial, data, done);
+		sha256_transform(sctx->state, sctx->buf, 1);
+	}
+
+	if (len - done >= SHA256_BLOCK_SIZE) {
+		unsigned int blocks = (len - done) / SHA256_BLOCK_SIZE;
+
+		sha256_transform(sctx->state, data + done, blocks);
+		done += blocks * SHA256_BLOCK_SIZE;
+	}
+
+	memcpy(sctx->buf, data + done, len - done);
+	return 0;
+}
+
+static int sha256_neon_final(struct shash_desc *desc, u8 *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	static const u8 padding[SHA256_BLOCK_SIZE] = { 0x80, };
+	__be32 *dst = (__be32 *)out;
+	__be64 bits;
+	unsigned int index, pad_len;
+	int i;
+
+	bits = cpu_to_be64(sctx->count << 3);
+
+	index = sctx->count % SHA256_BLOCK_SIZE;
+	pad_len = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE + 56) - index);
+	sha256_neon_update(desc, padding, pad_len);
+	sha256_neon_update(desc, (const u8 *)&bits, sizeof(bits));
+
+	for (i = 0; i < 8; i++)
+		dst[i] = cpu_to_be32(sctx->state[i]);
+
+	memset(sctx, 0, sizeof(*sctx));
+	return 0;
+}
+
+static int sha224_neon_final(struct shash_desc *desc, u8 *hash)
+{
+	u8 D[SHA256_DIGEST_SIZE];
+
+	sha256_neon_final(desc, D);
+
+	memcpy(hash, D, SHA224_DIGEST_SIZE);
+	memset(D, 0, SHA256_DIGEST_SIZE);
+	return 0;
+}
+
+static int sha256_neon_export(struct shash_desc *desc, void *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+	return 0;
+}
+
+static int sha256_neon_import(struct shash_desc *desc, const void *in)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+	return 0;
+}
+
+static int sha384_neon_init(struct shash_desc *desc)
+{
+	struct sha512_state *sctx = shash_desc_ctx(desc);
+
+	sctx->state[0] = SHA384_H0;
+	sctx->state[1] = SHA384_H1;
+	sctx->state[2] = SHA384_H2;
+	sctx->state[3] = SHA384_H3;
+	sctx->state[4] = SHA384_H4;
+	sctx->state[5] = SHA384_H5;
+	sctx->state[6] = SHA384_H6;
+	sctx->state[7] = SHA384_H7;
+	sctx->count[0] = sctx->count[1] = 0;
+	return 0;
+}
+
+static int sha512_neon_init(struct shash_desc *desc)
+{
+	struct sha512_state *sctx = shash_desc_ctx(desc);
+
+	sctx->state[0] = SHA512_H0;
+	sctx->state[1] = SHA512_H1;
+	sctx->state[2] = SHA512_H2;
+	sctx->state[3] = SHA512_H3;
+	sctx->state[4] = SHA512_H4;
+	sctx->state[5] = SHA512_H5;
+	sctx->state[6] = SHA512_H6;
+	sctx->state[7] = SHA512_H7;
+	sctx->count[0] = sctx->count[1] = 0;
+	return 0;
+}
+
+static int sha512_neon_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int len)
+{
+	struct sha512_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count[0] % SHA512_BLOCK_SIZE;
+	unsigned int done = 0;
+
+	sctx->count[0] += len;
+	if (sctx->count[0] < len)
+		sctx->count[1]++;
+
+	if (partial + len < SHA512_BLOCK_SIZE) {
+		memcpy(sctx->buf + partial, data, len);
+		return 0;
+	}
+
+	if (partial) {
+		done = SHA512_BLOCK_SIZE - partial;
+		memcpy(sctx->buf + partial, data, done);
+		sha512_transform(sctx->state, sctx->buf, 1);
+	}
+
+	if (len - done >= SHA512_BLOCK_SIZE) {
+		unsigned int blocks = (len - done) / SHA512_BLOCK_SIZE;
+
+		sha512_transform(sctx->state, data + done, blocks);
+		done += blocks * SHA512_BLOCK_SIZE;
+	}
+
+	memcpy(sctx->buf, data + done, len - done);
+	return 0;
+}
+
+static int sha512_neon_final(struct shash_desc *desc, u8 *hash)
+{
+	struct sha512_state *sctx = shash_desc_ctx(desc);
+	static const u8 padding[SHA512_BLOCK_SIZE] = { 0x80, };
+	__be64 *dst = (__be64 *)hash;
+	__be64 bits[2];
+	unsigned int index, pad_len;
+	int i;
+
+	bits[1] = cpu_to_be64(sctx->count[0] << 3);
+	bits[0] = cpu_to_be64(sctx->count[1] << 3 | sctx->count[0] >> 61);
+
+	index = sctx->count[0] % SHA512_BLOCK_SIZE;
+	pad_len = (index < 112) ? (112 - index) : ((SHA512_BLOCK_SIZE + 112) - index);
+	sha512_neon_update(desc, padding, pad_len);
+	sha512_neon_update(desc, (const u8 *)bits, sizeof(bits));
+
+	for (i = 0; i < 8; i++)
+		dst[i] = cpu_to_be64(sctx->state[i]);
+
+	memset(sctx, 0, sizeof(*sctx));
+	return 0;
+}
+
+static int sha384_neon_final(struct shash_desc *desc, u8 *hash)
+{
+	u8 D[SHA512_DIGEST_SIZE];
+
+	sha512_neon_final(desc, D);
+
+	memcpy(hash, D, SHA384_DIGEST_SIZE);
+	memset(D, 0, SHA512_DIGEST_SIZE);
+	return 0;
+}
+
+static struct shash_alg sha2_neon_algs[] = { {
+	.digestsize	=	SHA256_DIGEST_SIZE,
+	.init		=	sha256_neon_init,
+	.update		=	sha256_neon_update,
+	.final		=	sha256_neon_final,
+	.export		=	sha256_neon_export,
+	.import		=	sha256_neon_import,
+	.descsize	=	sizeof(struct sha256_state),
+	.statesize	=	sizeof(struct sha256_state),
+	.base		=	{
+		.cra_name	 =	"sha256",
+		.cra_driver_name =	"sha256-neon",
+		.cra_priority	 =	150,
+		.cra_flags	 =	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	 =	SHA256_BLOCK_SIZE,
+		.cra_module	 =	THIS_MODULE,
+	}
+}, {
+	.digestsize	=	SHA224_DIGEST_SIZE,
+	.init		=	sha224_neon_init,
+	.update		=	sha256_neon_update,
+	.final		=	sha224_neon_final,
+	.export		=	sha256_neon_export,
+	.import		=	sha256_neon_import,
+	.descsize	=	sizeof(struct sha256_state),
+	.statesize	=	sizeof(struct sha256_state),
+	.base		=	{
+		.cra_name	 =	"sha224",
+		.cra_driver_name =	"sha224-neon",
+		.cra_priority	 =	150,
+		.cra_flags	 =	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	 =	SHA224_BLOCK_SIZE,
+		.cra_module	 =	THIS_MODULE,
+	}
+}, {
+	.digestsize	=	SHA512_DIGEST_SIZE,
+	.init		=	sha512_neon_init,
+	.update		=	sha512_neon_update,
+	.final		=	sha512_neon_final,
+	.descsize	=	sizeof(struct sha512_state),
+	.base		=	{
+		.cra_name	 =	"sha512",
+		.cra_driver_name =	"sha512-neon",
+		.cra_priority	 =	150,
+		.cra_flags	 =	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	 =	SHA512_BLOCK_SIZE,
+		.cra_module	 =	THIS_MODULE,
+	}
+}, {
+	.digestsize	=	SHA384_DIGEST_SIZE,
+	.init		=	sha384_neon_init,
+	.update		=	sha512_neon_update,
+	.final		=	sha384_neon_final,
+	.descsize	=	sizeof(struct sha512_state),
+	.base		=	{
+		.cra_name	 =	"sha384",
+		.cra_driver_name =	"sha384-neon",
+		.cra_priority	 =	150,
+		.cra_flags	 =	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	 =	SHA384_BLOCK_SIZE,
+		.cra_module	 =	THIS_MODULE,
+	}
+} };
+
+static int __init sha2_neon_mod_init(void)
+{
+	int i, ret;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	for (i = 0; i < ARRAY_SIZE(sha2_neon_algs); i++) {
+		ret = crypto_register_shash(&sha2_neon_algs[i]);
+		if (ret)
+			goto err;
+	}
+	return 0;
+
+err:
+	while (--i >= 0)
+		crypto_unregister_shash(&sha2_neon_algs[i]);
+	return ret;
+}
+
+static void __exit sha2_neon_mod_fini(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha2_neon_algs); i++)
+		crypto_unregister_shash(&sha2_neon_algs[i]);
+}
+
+module_init(sha2_neon_mod_init);
+module_exit(sha2_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA-224/256/384/512 Secure Hash Algorithms, NEON schedule");
+
+MODULE_ALIAS("sha224");
+MODULE_ALIAS("sha256");
+MODULE_ALIAS("sha384");
+MODULE_ALIAS("sha512");
@@ -0,0 +1,31 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_NEON_H
+#define __ASM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Code built with -mfpu=neon must not call kernel_neon_begin() itself:
+ * the compiler is free to use NEON registers anywhere in such a unit,
+ * including before the call.  Keep the NEON code in its own file and
+ * bracket the calls into it from ordinary code.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+u64 kernel_neon_switch_ns(void);
+
+#ifdef CONFIG_NEON_MEMCPY
+extern unsigned int memcpy_neon_threshold;
+extern unsigned int copy_from_user_neon_threshold;
+#endif
+
+#endif
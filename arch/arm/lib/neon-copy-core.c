@@ -0,0 +1,100 @@
+/*
+ *  linux/arch/arm/lib/neon-copy-core.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This unit is built with -mfpu=neon and must only be entered between
+ * kernel_neon_begin() and kernel_neon_end().  It must not call memcpy()
+ * or memset() either, which is why loop distribution is switched off.
+ */
+
+#include <linux/types.h>
+#include <linux/cache.h>
+#include <asm/page.h>
+#include "neon-copy.h"
+
+typedef u8 u8x16 __attribute__((vector_size(16)));
+typedef u8 u8x16u __attribute__((vector_size(16), aligned(1), __may_alias__));
+
+#define PREFETCH_AHEAD	(4 * L1_CACHE_BYTES)
+
+void __memcpy_neon(void *dest, const void *src, size_t n)
+{
+	u8 *d = dest;
+	const u8 *s = src;
+
+	if (n >= 64) {
+		size_t head = -(unsigned long)d & 15;
+
+		n -= head;
+		while (head--)
+			*d++ = *s++;
+
+		for (; n >= 64; n -= 64, d += 64, s += 64) {
+			const u8x16u *sv = (const u8x16u *)s;
+			u8x16 *dv = (u8x16 *)d;
+			u8x16 a = sv[0], b = sv[1], c = sv[2], e = sv[3];
+
+			__builtin_prefetch(s + PREFETCH_AHEAD);
+			dv[0] = a;
+			dv[1] = b;
+			dv[2] = c;
+			dv[3] = e;
+		}
+	}
+
+	for (; n >= 16; n -= 16, d += 16, s += 16)
+		*(u8x16u *)d = *(const u8x16u *)s;
+
+	while (n--)
+		*d++ = *s++;
+}
+
+void __memset_neon(void *dest, int c, size_t n)
+{
+	const u8 b = c;
+	const u8x16 v = { b, b, b, b, b, b, b, b, b, b, b, b, b, b, b, b };
+	u8 *d = dest;
+
+	if (n >= 64) {
+		size_t head = -(unsigned long)d & 15;
+
+		n -= head;
+		while (head--)
+			*d++ = b;
+
+		for (; n >= 64; n -= 64, d += 64) {
+			u8x16 *dv = (u8x16 *)d;
+
+			dv[0] = v;
+			dv[1] = v;
+			dv[2] = v;
+			dv[3] = v;
+		}
+	}
+
+	for (; n >= 16; n -= 16, d += 16)
+		*(u8x16u *)d = v;
+
+	while (n--)
+		*d++ = b;
+}
+
+void __copy_page_neon(void *to, const void *from)
+{
+	const u8x16 *s = from;
+	u8x16 *d = to;
+	unsigned int i;
+
+	for (i = 0; i < PAGE_SIZE / 16; i += 4, s += 4, d += 4) {
+		u8x16 a = s[0], b = s[1], c = s[2], e = s[3];
+
+		__builtin_prefetch((const u8 *)s + PREFETCH_AHEAD);
+		d[0] = a;
+		d[1] = b;
+		d[2] = c;
+		d[3] = e;
+	}
+}
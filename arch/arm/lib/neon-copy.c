@@ -0,0 +1,326 @@
+/*
+ *  linux/arch/arm/lib/neon-copy.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * memcpy(), memset(), __memzero() and copy_page() branch here from their
+ * entry points once the length reaches the current threshold.  The
+ * thresholds start out disabled and are picked at boot by timing the
+ * integer and NEON routines against each other; each can be overridden
+ * with neon_copy.<name>= on the command line or through sysfs.
+ *
+ * The boot thread has no live VFP state, so the NEON timings are charged
+ * the measured cost of saving and reloading a user context on top.  Large
+ * __copy_from_user() calls only reach the NEON memcpy() by pinning each
+ * source page, so that path has its own threshold that also pays for
+ * mmap_sem and the pte lock per page.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/hardirq.h>
+#include <linux/sched.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/rwsem.h>
+#include <linux/spinlock.h>
+#include <asm/neon.h>
+#include "neon-copy.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "neon_copy."
+
+/*
+ * Below this the cost of saving the user VFP state outweighs anything
+ * the wider loads can win back.
+ */
+#define NEON_COPY_MIN		256
+#define NEON_COPY_MAX		(16 * 1024)
+#define NEON_COPY_BENCH_BYTES	(1024 * 1024)
+#define NEON_COPY_AUTO		UINT_MAX
+
+/*
+ * Preemption is off while NEON is held, so longer calls drop it between
+ * chunks of this size.
+ */
+#define NEON_COPY_CHUNK		4096
+
+/* Read from the assembly entry points: UINT_MAX and 0 mean integer only. */
+unsigned int memcpy_neon_threshold = UINT_MAX;
+unsigned int memset_neon_threshold = UINT_MAX;
+unsigned int copy_page_neon_enabled;
+unsigned int copy_from_user_neon_threshold = UINT_MAX;
+
+static unsigned int memcpy_threshold = NEON_COPY_AUTO;
+static unsigned int memset_threshold = NEON_COPY_AUTO;
+static unsigned int copy_page_mode = NEON_COPY_AUTO;
+static unsigned int copy_from_user_threshold = NEON_COPY_AUTO;
+static bool neon_copy_ready;
+
+static u64 neon_copy_switch_ns __initdata;
+static u64 neon_copy_pin_ns __initdata;
+
+void *memcpy_neon(void *dest, const void *src, size_t n)
+{
+	u8 *d = dest;
+	const u8 *s = src;
+
+	if (unlikely(in_interrupt()))
+		return __memcpy_arm(dest, src, n);
+
+	while (n) {
+		size_t len = min_t(size_t, n, NEON_COPY_CHUNK);
+
+		kernel_neon_begin();
+		__memcpy_neon(d, s, len);
+		kernel_neon_end();
+		d += len;
+		s += len;
+		n -= len;
+	}
+	return dest;
+}
+
+static void neon_set(void *dest, int c, size_t n)
+{
+	u8 *d = dest;
+
+	while (n) {
+		size_t len = min_t(size_t, n, NEON_COPY_CHUNK);
+
+		kernel_neon_begin();
+		__memset_neon(d, c, len);
+		kernel_neon_end();
+		d += len;
+		n -= len;
+	}
+}
+
+void *memset_neon(void *dest, int c, size_t n)
+{
+	if (unlikely(in_interrupt()))
+		return __memset_arm(dest, c, n);
+
+	neon_set(dest, c, n);
+	return dest;
+}
+
+void memzero_neon(void *dest, size_t n)
+{
+	if (unlikely(in_interrupt())) {
+		__memzero_arm(dest, n);
+		return;
+	}
+
+	neon_set(dest, 0, n);
+}
+
+void copy_page_neon(void *to, const void *from)
+{
+	if (unlikely(in_interrupt())) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+static unsigned int neon_copy_clamp(unsigned int threshold)
+{
+	if (!threshold || threshold == NEON_COPY_AUTO)
+		return UINT_MAX;
+	return max_t(unsigned int, threshold, NEON_COPY_MIN);
+}
+
+static void neon_copy_apply(void)
+{
+	memcpy_neon_threshold = neon_copy_clamp(memcpy_threshold);
+	memset_neon_threshold = neon_copy_clamp(memset_threshold);
+	copy_from_user_neon_threshold =
+		neon_copy_clamp(copy_from_user_threshold);
+	copy_page_neon_enabled = copy_page_mode &&
+				 copy_page_mode != NEON_COPY_AUTO;
+}
+
+static int neon_copy_param_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && neon_copy_ready)
+		neon_copy_apply();
+	return ret;
+}
+
+static struct kernel_param_ops neon_copy_param_ops = {
+	.set = neon_copy_param_set,
+	.get = param_get_uint,
+};
+
+module_param_cb(memcpy_threshold, &neon_copy_param_ops, &memcpy_threshold, 0644);
+MODULE_PARM_DESC(memcpy_threshold, "Smallest memcpy() length done with NEON, 0 for never");
+module_param_cb(memset_threshold, &neon_copy_param_ops, &memset_threshold, 0644);
+MODULE_PARM_DESC(memset_threshold, "Smallest memset() length done with NEON, 0 for never");
+module_param_cb(copy_page, &neon_copy_param_ops, &copy_page_mode, 0644);
+MODULE_PARM_DESC(copy_page, "Use NEON for copy_page()");
+module_param_cb(copy_from_user_threshold, &neon_copy_param_ops,
+		&copy_from_user_threshold, 0644);
+MODULE_PARM_DESC(copy_from_user_threshold, "Smallest __copy_from_user() length done with NEON, 0 for never");
+
+enum {
+	NEON_COPY_MEMCPY,
+	NEON_COPY_MEMSET,
+	NEON_COPY_PAGE,
+};
+
+/*
+ * @penalty is added per NEON call for costs the loop itself cannot see.
+ */
+static u64 __init neon_copy_time(int op, bool neon, void *dst,
+				 const void *src, size_t len, u64 penalty)
+{
+	unsigned int i, iters = NEON_COPY_BENCH_BYTES / len;
+	u64 start, end;
+
+	preempt_disable();
+	start = sched_clock();
+	for (i = 0; i < iters; i++) {
+		if (neon)
+			kernel_neon_begin();
+		switch (op) {
+		case NEON_COPY_MEMCPY:
+			if (neon)
+				__memcpy_neon(dst, src, len);
+			else
+				__memcpy_arm(dst, src, len);
+			break;
+		case NEON_COPY_MEMSET:
+			if (neon)
+				__memset_neon(dst, 0x5a, len);
+			else
+				__memset_arm(dst, 0x5a, len);
+			break;
+		case NEON_COPY_PAGE:
+			if (neon)
+				__copy_page_neon(dst, src);
+			else
+				__copy_page_arm(dst, src);
+			break;
+		}
+		if (neon)
+			kernel_neon_end();
+	}
+	end = sched_clock();
+	preempt_enable();
+
+	if (neon)
+		end += iters * penalty;
+	return end - start;
+}
+
+/*
+ * Uncontended cost of the locking __copy_from_user_memcpy() does for
+ * each page it copies from.
+ */
+static u64 __init neon_copy_pin_cost(void)
+{
+	static DECLARE_RWSEM(sem);
+	static DEFINE_SPINLOCK(lock);
+	unsigned int i, iters = 1024;
+	u64 start, end;
+
+	start = sched_clock();
+	for (i = 0; i < iters; i++) {
+		down_read(&sem);
+		spin_lock(&lock);
+		spin_unlock(&lock);
+		up_read(&sem);
+	}
+	end = sched_clock();
+
+	return div_u64(end - start, iters);
+}
+
+/*
+ * The threshold is the smallest length from which NEON keeps winning for
+ * every larger length measured, or 0 if it loses at NEON_COPY_MAX.
+ */
+static unsigned int __init neon_copy_pick(int op, const char *name,
+					  void *dst, const void *src,
+					  bool pinned)
+{
+	unsigned int threshold = 0;
+	size_t len;
+
+	for (len = NEON_COPY_MAX; len >= NEON_COPY_MIN; len >>= 1) {
+		u64 arm, neon, penalty = neon_copy_switch_ns;
+
+		if (pinned)
+			penalty += (len / PAGE_SIZE + 1) * neon_copy_pin_ns;
+
+		neon_copy_time(op, false, dst, src, len, 0);
+		arm = neon_copy_time(op, false, dst, src, len, 0);
+		neon = neon_copy_time(op, true, dst, src, len, penalty);
+		if (neon >= arm)
+			break;
+		threshold = len;
+	}
+
+	pr_info("neon_copy: %s threshold %u\n", name, threshold);
+	return threshold;
+}
+
+static int __init neon_copy_init(void)
+{
+	unsigned long buf;
+	void *dst, *src;
+
+	if (!cpu_has_neon())
+		return 0;
+
+	buf = __get_free_pages(GFP_KERNEL, get_order(2 * NEON_COPY_MAX));
+	if (!buf)
+		return -ENOMEM;
+	dst = (void *)buf;
+	src = (void *)buf + NEON_COPY_MAX;
+	__memset_arm(src, 0xa5, NEON_COPY_MAX);
+
+	neon_copy_switch_ns = kernel_neon_switch_ns();
+	neon_copy_pin_ns = neon_copy_pin_cost();
+	pr_info("neon_copy: %llu ns per VFP save/reload, %llu ns per pinned page\n",
+		neon_copy_switch_ns, neon_copy_pin_ns);
+
+	if (memcpy_threshold == NEON_COPY_AUTO)
+		memcpy_threshold = neon_copy_pick(NEON_COPY_MEMCPY, "memcpy",
+						  dst, src, false);
+	if (memset_threshold == NEON_COPY_AUTO)
+		memset_threshold = neon_copy_pick(NEON_COPY_MEMSET, "memset",
+						  dst, src, false);
+	if (copy_from_user_threshold == NEON_COPY_AUTO)
+		copy_from_user_threshold = neon_copy_pick(NEON_COPY_MEMCPY,
+					"copy_from_user", dst, src, true);
+	if (copy_page_mode == NEON_COPY_AUTO) {
+		u64 arm, neon;
+
+		neon_copy_time(NEON_COPY_PAGE, false, dst, src, PAGE_SIZE, 0);
+		arm = neon_copy_time(NEON_COPY_PAGE, false, dst, src,
+				     PAGE_SIZE, 0);
+		neon = neon_copy_time(NEON_COPY_PAGE, true, dst, src,
+				      PAGE_SIZE, neon_copy_switch_ns);
+		copy_page_mode = neon < arm;
+		pr_info("neon_copy: copy_page %llu ns arm, %llu ns neon\n",
+			arm, neon);
+	}
+
+	free_pages(buf, get_order(2 * NEON_COPY_MAX));
+
+	neon_copy_ready = true;
+	neon_copy_apply();
+	return 0;
+}
+late_initcall_sync(neon_copy_init);
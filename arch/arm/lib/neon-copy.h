@@ -0,0 +1,23 @@
+/*
+ *  linux/arch/arm/lib/neon-copy.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ARM_LIB_NEON_COPY_H
+#define __ARM_LIB_NEON_COPY_H
+
+#include <linux/types.h>
+
+void __memcpy_neon(void *dest, const void *src, size_t n);
+void __memset_neon(void *dest, int c, size_t n);
+void __copy_page_neon(void *to, const void *from);
+
+void *__memcpy_arm(void *dest, const void *src, size_t n);
+void *__memset_arm(void *dest, int c, size_t n);
+void __memzero_arm(void *dest, size_t n);
+void __copy_page_arm(void *to, const void *from);
+
+#endif
@@ -20,9 +20,11 @@
 #include <linux/highmem.h>
 #include <asm/current.h>
 #include <asm/page.h>
+#include <asm/neon.h>
 
 static int
-pin_page_for_write(const void __user *_addr, pte_t **ptep, spinlock_t **ptlp)
+pin_page_for_access(const void __user *_addr, int write, pte_t **ptep,
+		    spinlock_t **ptlp)
 {
 	unsigned long addr = (unsigned long)_addr;
 	pgd_t *pgd;
@@ -45,7 +47,7 @@ pin_page_for_write(const void __user *_addr, pte_t **ptep, spinlock_t **ptlp)
 
 	pte = pte_offset_map_lock(current->mm, pmd, addr, &ptl);
 	if (unlikely(!pte_present(*pte) || !pte_young(*pte) ||
-	    !pte_write(*pte) || !pte_dirty(*pte))) {
+	    (write && (!pte_write(*pte) || !pte_dirty(*pte))))) {
 		pte_unmap_unlock(pte, ptl);
 		return 0;
 	}
@@ -76,7 +78,7 @@ __copy_to_user_memcpy(void __user *to, const void *from, unsigned long n)
 		spinlock_t *ptl;
 		int tocopy;
 
-		while (!pin_page_for_write(to, &pte, &ptl)) {
+		while (!pin_page_for_access(to, 1, &pte, &ptl)) {
 			if (!atomic)
 				up_read(&current->mm->mmap_sem);
 			if (__put_user(0, (char __user *)to))
@@ -110,6 +112,64 @@ __copy_to_user(void __user *to, const void *from, unsigned long n)
 		return __copy_to_user_std(to, from, n);
 	return __copy_to_user_memcpy(to, from, n);
 }
+
+#ifdef CONFIG_NEON_MEMCPY
+static unsigned long noinline
+__copy_from_user_memcpy(void *to, const void __user *from, unsigned long n)
+{
+	int atomic;
+
+	if (unlikely(segment_eq(get_fs(), KERNEL_DS))) {
+		memcpy(to, (const void *)from, n);
+		return 0;
+	}
+
+	atomic = in_atomic();
+
+	if (!atomic)
+		down_read(&current->mm->mmap_sem);
+	while (n) {
+		pte_t *pte;
+		spinlock_t *ptl;
+		int tocopy;
+
+		while (!pin_page_for_access(from, 0, &pte, &ptl)) {
+			char temp;
+
+			if (!atomic)
+				up_read(&current->mm->mmap_sem);
+			/* let the fixup path do the zeroing on a real fault */
+			if (__get_user(temp, (char __user *)from))
+				return __copy_from_user_std(to, from, n);
+			if (!atomic)
+				down_read(&current->mm->mmap_sem);
+		}
+
+		tocopy = (~(unsigned long)from & ~PAGE_MASK) + 1;
+		if (tocopy > n)
+			tocopy = n;
+
+		memcpy(to, (const void *)from, tocopy);
+		to += tocopy;
+		from += tocopy;
+		n -= tocopy;
+
+		pte_unmap_unlock(pte, ptl);
+	}
+	if (!atomic)
+		up_read(&current->mm->mmap_sem);
+
+	return 0;
+}
+
+unsigned long
+__copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+	if (n >= copy_from_user_neon_threshold)
+		return __copy_from_user_memcpy(to, from, n);
+	return __copy_from_user_std(to, from, n);
+}
+#endif
 	
 static unsigned long noinline
 __clear_user_memset(void __user *addr, unsigned long n)
@@ -125,7 +185,7 @@ __clear_user_memset(void __user *addr, unsigned long n)
 		spinlock_t *ptl;
 		int tocopy;
 
-		while (!pin_page_for_write(addr, &pte, &ptl)) {
+		while (!pin_page_for_access(addr, 1, &pte, &ptl)) {
 			up_read(&current->mm->mmap_sem);
 			if (__put_user(0, (char __user *)addr))
 				goto out;
@@ -30,6 +30,7 @@
 #include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/platform_device.h>
+#include <linux/log2.h>
 #include <trace/events/power.h>
 #include <mach/socinfo.h>
 #include <mach/msm_bus.h>
@@ -74,11 +75,38 @@ struct cpufreq_work_struct {
 	int frequency;
 	unsigned int index;
 	int status;
+	unsigned int applied;
+	ktime_t queued_at;
+	ktime_t started_at;
+	ktime_t switch_start;
+	ktime_t switch_end;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_work_struct, cpufreq_work);
 static struct workqueue_struct *msm_cpufreq_wq;
 
+#define FREQ_LAT_BUCKETS	12
+
+enum {
+	FREQ_LAT_QUEUE,
+	FREQ_LAT_SWITCH,
+	FREQ_LAT_TOTAL,
+	FREQ_LAT_NR,
+};
+
+struct cpufreq_lat_stats {
+	unsigned long requests;
+	unsigned long queued;
+	unsigned long executed;
+	unsigned long dropped;
+	unsigned long failed;
+	u64 sum_us[FREQ_LAT_NR];
+	u64 max_us[FREQ_LAT_NR];
+	unsigned long hist[FREQ_LAT_NR][FREQ_LAT_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct cpufreq_lat_stats, cpufreq_lat);
+
 /* maxscroff */
 uint32_t maxscroff_freq = 1190400;
 uint32_t maxscroff = 1; 
@@ -180,6 +208,8 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
 
 	trace_cpu_frequency_switch_start(freqs.old, freqs.new, policy->cpu);
+	per_cpu(cpufreq_work, policy->cpu).applied = new_freq;
+	per_cpu(cpufreq_work, policy->cpu).switch_start = ktime_get();
 	if (is_clk) {
 		unsigned long rate = new_freq * 1000;
 #ifdef CONFIG_HTC_DEBUG_FOOTPRINT
@@ -202,6 +232,7 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 	} else {
 		ret = acpuclk_set_rate(policy->cpu, new_freq, SETRATE_CPUFREQ);
 	}
+	per_cpu(cpufreq_work, policy->cpu).switch_end = ktime_get();
 
 	if (!ret) {
 		trace_cpu_frequency_switch_end(policy->cpu);
@@ -224,11 +255,62 @@ static void set_cpu_work(struct work_struct *work)
 	struct cpufreq_work_struct *cpu_work =
 		container_of(work, struct cpufreq_work_struct, work);
 
+	cpu_work->started_at = ktime_get();
 	cpu_work->status = set_cpu_freq(cpu_work->policy, cpu_work->frequency,
 					cpu_work->index);
 	complete(&cpu_work->complete);
 }
 
+static unsigned int freq_lat_bucket(u64 us)
+{
+	if (us < 32)
+		return 0;
+
+	return min_t(unsigned int, ilog2(us) - 4, FREQ_LAT_BUCKETS - 1);
+}
+
+static void freq_lat_add(struct cpufreq_lat_stats *st, int stage,
+			 ktime_t from, ktime_t to)
+{
+	s64 us = ktime_us_delta(to, from);
+
+	if (us < 0)
+		us = 0;
+
+	st->sum_us[stage] += us;
+	if (us > st->max_us[stage])
+		st->max_us[stage] = us;
+	st->hist[stage][freq_lat_bucket(us)]++;
+}
+
+static void freq_lat_account(struct cpufreq_policy *policy,
+			     struct cpufreq_work_struct *cpu_work,
+			     unsigned int old_freq, ktime_t requested_at)
+{
+	struct cpufreq_lat_stats *st = &per_cpu(cpufreq_lat, policy->cpu);
+
+	st->executed++;
+	if (cpu_work->status) {
+		st->failed++;
+		return;
+	}
+
+	if (cpu_work->applied != cpu_work->frequency)
+		st->dropped++;
+
+	freq_lat_add(st, FREQ_LAT_QUEUE, cpu_work->queued_at,
+		     cpu_work->started_at);
+	freq_lat_add(st, FREQ_LAT_SWITCH, cpu_work->switch_start,
+		     cpu_work->switch_end);
+	freq_lat_add(st, FREQ_LAT_TOTAL, requested_at, cpu_work->switch_end);
+
+	trace_cpu_frequency_switch_latency(policy->cpu, old_freq,
+		cpu_work->frequency,
+		ktime_us_delta(cpu_work->started_at, cpu_work->queued_at),
+		ktime_us_delta(cpu_work->switch_end, cpu_work->switch_start),
+		ktime_us_delta(cpu_work->switch_end, requested_at));
+}
+
 static int msm_cpufreq_target(struct cpufreq_policy *policy,
 				unsigned int target_freq,
 				unsigned int relation)
@@ -236,14 +318,19 @@ static int msm_cpufreq_target(struct cpufreq_policy *policy,
 	int ret = -EFAULT;
 	int index;
 	struct cpufreq_frequency_table *table;
+	struct cpufreq_lat_stats *st = &per_cpu(cpufreq_lat, policy->cpu);
+	unsigned int old_freq = policy->cur;
+	ktime_t requested_at = ktime_get();
 
 	struct cpufreq_work_struct *cpu_work = NULL;
 
 	mutex_lock(&per_cpu(cpufreq_suspend, policy->cpu).suspend_mutex);
+	st->requests++;
 
 	if (per_cpu(cpufreq_suspend, policy->cpu).device_suspended) {
 		pr_debug("cpufreq: cpu%d scheduling frequency change "
 				"in suspend.\n", policy->cpu);
+		st->dropped++;
 		ret = -EFAULT;
 		goto done;
 	}
@@ -252,6 +339,7 @@ static int msm_cpufreq_target(struct cpufreq_policy *policy,
 	if (cpufreq_frequency_table_target(policy, table, target_freq, relation,
 			&index)) {
 		pr_err("cpufreq: invalid target_freq: %d\n", target_freq);
+		st->dropped++;
 		ret = -EINVAL;
 		goto done;
 	}
@@ -268,10 +356,13 @@ static int msm_cpufreq_target(struct cpufreq_policy *policy,
 
 	cancel_work_sync(&cpu_work->work);
 	INIT_COMPLETION(cpu_work->complete);
+	cpu_work->queued_at = ktime_get();
 	queue_work_on(policy->cpu, msm_cpufreq_wq, &cpu_work->work);
+	st->queued++;
 	wait_for_completion(&cpu_work->complete);
 
 	ret = cpu_work->status;
+	freq_lat_account(policy, cpu_work, old_freq, requested_at);
 
 done:
 	mutex_unlock(&per_cpu(cpufreq_suspend, policy->cpu).suspend_mutex);
@@ -754,6 +845,74 @@ const struct file_operations msm_cpufreq_fops = {
 	.llseek		= seq_lseek,
 	.release	= seq_release,
 };
+
+static const char * const freq_lat_stage_name[FREQ_LAT_NR] = {
+	[FREQ_LAT_QUEUE]	= "queue",
+	[FREQ_LAT_SWITCH]	= "switch",
+	[FREQ_LAT_TOTAL]	= "total",
+};
+
+static int msm_cpufreq_latency_show(struct seq_file *m, void *unused)
+{
+	struct cpufreq_lat_stats *st;
+	unsigned int cpu, stage, i;
+	u64 avg;
+
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(cpufreq_lat, cpu);
+		seq_printf(m, "cpu%u: requests %lu queued %lu executed %lu "
+			   "dropped %lu failed %lu\n", cpu, st->requests,
+			   st->queued, st->executed, st->dropped, st->failed);
+
+		seq_printf(m, "%8s %10s %10s", "us", "", "");
+		for (i = 0; i < FREQ_LAT_BUCKETS; i++)
+			seq_printf(m, " %8u%c", i ? 16 << i : 0,
+				   i == FREQ_LAT_BUCKETS - 1 ? '+' : ' ');
+		seq_printf(m, "\n");
+
+		for (stage = 0; stage < FREQ_LAT_NR; stage++) {
+			avg = st->sum_us[stage];
+			if (st->executed - st->failed)
+				do_div(avg, st->executed - st->failed);
+			seq_printf(m, "%8s avg:%6llu max:%6llu",
+				   freq_lat_stage_name[stage], avg,
+				   st->max_us[stage]);
+			for (i = 0; i < FREQ_LAT_BUCKETS; i++)
+				seq_printf(m, " %9lu", st->hist[stage][i]);
+			seq_printf(m, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int msm_cpufreq_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_cpufreq_latency_show, inode->i_private);
+}
+
+static ssize_t msm_cpufreq_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		mutex_lock(&per_cpu(cpufreq_suspend, cpu).suspend_mutex);
+		memset(&per_cpu(cpufreq_lat, cpu), 0,
+		       sizeof(struct cpufreq_lat_stats));
+		mutex_unlock(&per_cpu(cpufreq_suspend, cpu).suspend_mutex);
+	}
+
+	return count;
+}
+
+static const struct file_operations msm_cpufreq_latency_fops = {
+	.open		= msm_cpufreq_latency_open,
+	.read		= seq_read,
+	.write		= msm_cpufreq_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 #endif
 
 #ifdef CONFIG_MSM_CPU_VOLTAGE_CONTROL
@@ -819,6 +978,9 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 	if (!debugfs_create_file("msm_cpufreq", S_IRUGO, NULL, NULL,
 		&msm_cpufreq_fops))
 		return -ENOMEM;
+	if (!debugfs_create_file("msm_cpufreq_latency", S_IRUGO | S_IWUSR,
+		NULL, NULL, &msm_cpufreq_latency_fops))
+		return -ENOMEM;
 #endif
 
 	return 0;
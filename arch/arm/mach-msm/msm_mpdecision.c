@@ -123,6 +123,7 @@ static struct dentry *debugfs_base;
 static struct mpdecision msm_mpd;
 
 static struct hp_latency hp_latencies;
+static struct sched_nr_avg_window rq_avg_window;
 
 static unsigned long last_nr;
 static int num_present_hundreds;
@@ -157,7 +158,13 @@ static enum hrtimer_restart msm_mpd_rq_avg_poll_timer(struct hrtimer *timer)
 	msm_mpd.next_update = ktime_add_ns(curr_time,
 			(msm_mpd.rq_avg_poll_ms * NSEC_PER_MSEC));
 
-	sched_get_nr_running_avg(&nr, &nr_iowait);
+	if (sched_nr_avg_window_update(&rq_avg_window)) {
+		nr = (rq_avg_window.avg * 100) >> FSHIFT;
+		nr_iowait = (rq_avg_window.iowait_avg * 100) >> FSHIFT;
+	} else {
+		nr = last_nr;
+		nr_iowait = 0;
+	}
 
 	if ((nr_iowait >= msm_mpd.iowait_threshold_pct) && (nr < last_nr))
 		nr = last_nr;
@@ -675,11 +682,17 @@ static struct platform_driver msm_mpd_driver = {
 static int __init msm_mpdecision_init(void)
 {
 	int cpu;
+	int ret;
+
 	if (!msm_mpd_enabled) {
 		pr_info("Not enabled\n");
 		return 0;
 	}
 
+	ret = sched_nr_avg_window_init(&rq_avg_window);
+	if (ret)
+		return ret;
+
 	num_present_hundreds = 100 * num_present_cpus();
 
 	hrtimer_init(&msm_mpd.slack_timer, CLOCK_MONOTONIC,
@@ -695,6 +708,9 @@ static int __init msm_mpdecision_init(void)
 	mutex_init(&msm_mpd.lock);
 	init_waitqueue_head(&msm_mpd.wait_q);
 	init_waitqueue_head(&msm_mpd.wait_hpq);
-	return platform_driver_register(&msm_mpd_driver);
+	ret = platform_driver_register(&msm_mpd_driver);
+	if (ret)
+		sched_nr_avg_window_destroy(&rq_avg_window);
+	return ret;
 }
 late_initcall(msm_mpdecision_init);
@@ -18,6 +18,7 @@
 #include <linux/sched.h>
 #include <linux/smp.h>
 #include <linux/init.h>
+#include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/user.h>
 #include <linux/proc_fs.h>
@@ -440,6 +441,86 @@ int vfp_restore_user_hwstate(struct user_vfp __user *ufp,
 	return err ? -EFAULT : 0;
 }
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+/*
+ * Kernel mode NEON is only allowed outside of interrupt context and with
+ * preemption disabled, so the kernel never has to preserve its own NEON
+ * register contents.  The user state that is live in the unit is saved
+ * and will be reloaded lazily on the next VFP trap.
+ */
+static DEFINE_PER_CPU(unsigned int, kernel_neon_depth);
+
+void kernel_neon_begin(void)
+{
+	struct thread_info *thread = current_thread_info();
+	unsigned int cpu;
+	u32 fpexc;
+
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+
+	/*
+	 * A NEON user may call memcpy() with the unit already enabled; the
+	 * nested section leaves the saved state and FPEXC to the outer one.
+	 */
+	if (per_cpu(kernel_neon_depth, cpu)++)
+		return;
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	if (vfp_state_in_hw(cpu, thread))
+		vfp_save_state(&thread->vfpstate, fpexc);
+#ifndef CONFIG_SMP
+	else if (vfp_current_hw_state[cpu] != NULL)
+		vfp_save_state(vfp_current_hw_state[cpu], fpexc);
+#endif
+	vfp_current_hw_state[cpu] = NULL;
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	if (!--__get_cpu_var(kernel_neon_depth))
+		fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+/*
+ * What kernel_neon_begin() costs a thread whose VFP state is live: the
+ * save, plus the reload on its next VFP trap.  Measured on a scratch
+ * copy of the current hardware state, which is put back unchanged.
+ * Returns nanoseconds per save and reload.
+ */
+u64 __init kernel_neon_switch_ns(void)
+{
+	static union vfp_state state __initdata;
+	unsigned int i, iters = 256;
+	u64 start, end;
+	u32 fpexc;
+
+	preempt_disable();
+	fpexc = fmrx(FPEXC);
+	fmxr(FPEXC, fpexc | FPEXC_EN);
+	vfp_save_state(&state, fpexc | FPEXC_EN);
+
+	start = sched_clock();
+	for (i = 0; i < iters; i++) {
+		vfp_save_state(&state, fpexc | FPEXC_EN);
+		vfp_load_state(&state);
+	}
+	end = sched_clock();
+
+	fmxr(FPEXC, fpexc);
+	preempt_enable();
+
+	return div_u64(end - start, iters);
+}
+
+#endif
+
 static int vfp_hotplug(struct notifier_block *b, unsigned long action,
 	void *hcpu)
 {
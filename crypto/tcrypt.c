@@ -1330,6 +1330,25 @@ static int do_test(int m)
 				  speed_template_32_64);
 		break;
 
+	case 208:
+		test_cipher_speed("ecb-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb-aes-neonbs", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc-aes-neonbs", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr-aes-neonbs", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("xts-aes-neonbs", ENCRYPT, sec, NULL, 0,
+				speed_template_32_48_64);
+		test_cipher_speed("xts-aes-neonbs", DECRYPT, sec, NULL, 0,
+				speed_template_32_48_64);
+		break;
+
 	case 300:
 		
 
@@ -1405,6 +1424,14 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("sha256-neon", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 320:
+		test_hash_speed("sha512-neon", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
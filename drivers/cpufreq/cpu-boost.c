@@ -24,12 +24,15 @@
 #include <linux/slab.h>
 #include <linux/input.h>
 #include <linux/time.h>
+#include <linux/fb.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpu_boost.h>
 
 struct cpu_sync {
 	struct task_struct *thread;
 	wait_queue_head_t sync_wq;
 	struct delayed_work boost_rem;
-	struct delayed_work input_boost_rem;
 	int cpu;
 	spinlock_t lock;
 	bool pending;
@@ -42,6 +45,8 @@ static DEFINE_PER_CPU(struct cpu_sync, sync_info);
 static struct workqueue_struct *cpu_boost_wq;
 
 static struct work_struct input_boost_work;
+static struct delayed_work input_boost_rem;
+static DEFINE_MUTEX(input_boost_apply_lock);
 
 static unsigned int boost_ms;
 module_param(boost_ms, uint, 0644);
@@ -55,8 +60,67 @@ module_param(input_boost_freq, uint, 0644);
 static unsigned int input_boost_ms = 40;
 module_param(input_boost_ms, uint, 0644);
 
-static u64 last_input_time;
-#define MIN_INPUT_INTERVAL (150 * USEC_PER_MSEC)
+static unsigned int frame_boost_ms = 34;
+module_param(frame_boost_ms, uint, 0644);
+
+static unsigned int binder_boost_ms = 17;
+module_param(binder_boost_ms, uint, 0644);
+
+static unsigned int boost_session_max_ms = 5000;
+module_param(boost_session_max_ms, uint, 0644);
+
+static unsigned int boost_decay_ms = 20;
+module_param(boost_decay_ms, uint, 0644);
+
+static unsigned int boost_decay_pct = 20;
+module_param(boost_decay_pct, uint, 0644);
+
+static char binder_boost_comm[TASK_COMM_LEN] = "surfaceflinger";
+module_param_string(binder_boost_comm, binder_boost_comm,
+		    sizeof(binder_boost_comm), 0644);
+
+static const char * const boost_src_name[NR_CPU_BOOST_SRC] = {
+	[CPU_BOOST_SRC_INPUT]	= "input",
+	[CPU_BOOST_SRC_FRAME]	= "frame",
+	[CPU_BOOST_SRC_BINDER]	= "binder",
+};
+
+static const unsigned int boost_dur_bucket_ms[] = {
+	100, 250, 500, 1000, 2000, UINT_MAX,
+};
+#define NR_BOOST_DUR_BUCKETS ARRAY_SIZE(boost_dur_bucket_ms)
+
+struct boost_stats {
+	unsigned long kicks[NR_CPU_BOOST_SRC];
+	unsigned long hits[NR_CPU_BOOST_SRC];
+	unsigned long sessions;
+	unsigned long capped;
+	unsigned long decay_steps;
+	unsigned long dur_hist[NR_BOOST_DUR_BUCKETS];
+	u64 total_us;
+	u64 max_us;
+};
+
+/*
+ * A boost session is started by an input event and kept alive by any
+ * later event (input, frame commit or binder call into the compositor)
+ * for as long as the frames keep coming.  Once no event has refreshed
+ * the hold time the floor decays by boost_decay_pct every
+ * boost_decay_ms until it reaches the lowest frequency of the CPU.
+ */
+struct boost_session {
+	spinlock_t lock;
+	bool active;
+	bool blanked;
+	unsigned int level;
+	ktime_t start;
+	ktime_t hold_until;
+	struct boost_stats stats;
+};
+
+static struct boost_session bs = {
+	.lock = __SPIN_LOCK_UNLOCKED(bs.lock),
+};
 
 static int boost_adjust_notify(struct notifier_block *nb, unsigned long val, void *data)
 {
@@ -98,18 +162,7 @@ static void do_boost_rem(struct work_struct *work)
 
 	pr_debug("Removing boost for CPU%d\n", s->cpu);
 	s->boost_min = 0;
-	
-	cpufreq_update_policy(s->cpu);
-}
-
-static void do_input_boost_rem(struct work_struct *work)
-{
-	struct cpu_sync *s = container_of(work, struct cpu_sync,
-						input_boost_rem.work);
 
-	pr_debug("Removing input boost for CPU%d\n", s->cpu);
-	s->input_boost_min = 0;
-	
 	cpufreq_update_policy(s->cpu);
 }
 
@@ -159,7 +212,7 @@ static int boost_mig_sync_thread(void *data)
 		} else {
 			s->boost_min = src_policy.cur;
 		}
-		
+
 		cpufreq_update_policy(dest_cpu);
 		queue_delayed_work_on(s->cpu, cpu_boost_wq,
 			&s->boost_rem, msecs_to_jiffies(boost_ms));
@@ -191,47 +244,204 @@ static struct notifier_block boost_migration_nb = {
 	.notifier_call = boost_migration_notify,
 };
 
-static void do_input_boost(struct work_struct *work)
+static void boost_session_end_locked(ktime_t now)
 {
-	unsigned int i, ret;
+	u64 dur_us = ktime_us_delta(now, bs.start);
+	unsigned int dur_ms = div_u64(dur_us, USEC_PER_MSEC);
+	int i;
+
+	bs.active = false;
+	bs.level = 0;
+	bs.stats.total_us += dur_us;
+	if (dur_us > bs.stats.max_us)
+		bs.stats.max_us = dur_us;
+	for (i = 0; i < NR_BOOST_DUR_BUCKETS; i++) {
+		if (dur_ms < boost_dur_bucket_ms[i]) {
+			bs.stats.dur_hist[i]++;
+			break;
+		}
+	}
+}
+
+static void input_boost_apply(void)
+{
+	unsigned int i, level;
+	unsigned long flags;
 	struct cpu_sync *i_sync_info;
-	struct cpufreq_policy policy;
 
-	for_each_online_cpu(i) {
+	mutex_lock(&input_boost_apply_lock);
+	spin_lock_irqsave(&bs.lock, flags);
+	level = bs.level;
+	spin_unlock_irqrestore(&bs.lock, flags);
 
+	for_each_possible_cpu(i) {
 		i_sync_info = &per_cpu(sync_info, i);
-		ret = cpufreq_get_policy(&policy, i);
-		if (ret)
-			continue;
-		if (policy.cur >= input_boost_freq)
+		if (i_sync_info->input_boost_min == level)
 			continue;
+		i_sync_info->input_boost_min = level;
+		if (cpu_online(i))
+			cpufreq_update_policy(i);
+	}
+	mutex_unlock(&input_boost_apply_lock);
+}
+
+static void do_input_boost(struct work_struct *work)
+{
+	input_boost_apply();
+	queue_delayed_work(cpu_boost_wq, &input_boost_rem,
+			   msecs_to_jiffies(input_boost_ms));
+}
+
+static unsigned int input_boost_floor(void)
+{
+	struct cpufreq_policy policy;
+
+	if (cpufreq_get_policy(&policy, 0))
+		return 0;
+
+	return policy.cpuinfo.min_freq;
+}
+
+static void do_input_boost_rem(struct work_struct *work)
+{
+	unsigned int floor = input_boost_floor();
+	unsigned int step;
+	unsigned long flags, delay;
+	ktime_t now;
+
+	spin_lock_irqsave(&bs.lock, flags);
+	if (!bs.active) {
+		spin_unlock_irqrestore(&bs.lock, flags);
+		return;
+	}
 
-		cancel_delayed_work_sync(&i_sync_info->input_boost_rem);
-		i_sync_info->input_boost_min = input_boost_freq;
-		cpufreq_update_policy(i);
-		queue_delayed_work_on(i_sync_info->cpu, cpu_boost_wq,
-			&i_sync_info->input_boost_rem,
-			msecs_to_jiffies(input_boost_ms));
+	now = ktime_get();
+	if (bs.hold_until.tv64 > now.tv64) {
+		delay = usecs_to_jiffies(ktime_us_delta(bs.hold_until, now));
+		spin_unlock_irqrestore(&bs.lock, flags);
+		queue_delayed_work(cpu_boost_wq, &input_boost_rem,
+				   max(delay, 1UL));
+		return;
 	}
+
+	step = bs.level / 100 * boost_decay_pct;
+	if (!step || bs.level <= floor + step) {
+		pr_debug("Removing input boost\n");
+		boost_session_end_locked(now);
+		delay = 0;
+	} else {
+		bs.level -= step;
+		bs.stats.decay_steps++;
+		delay = msecs_to_jiffies(boost_decay_ms);
+	}
+	spin_unlock_irqrestore(&bs.lock, flags);
+
+	input_boost_apply();
+	if (delay)
+		queue_delayed_work(cpu_boost_wq, &input_boost_rem, delay);
 }
 
-static void cpuboost_input_event(struct input_handle *handle,
-		unsigned int type, unsigned int code, int value)
+static void cpu_boost_kick(enum cpu_boost_src src, unsigned int ms)
 {
-	u64 now;
+	unsigned long flags;
+	bool apply = false;
+	ktime_t now, until;
 
-	if (!input_boost_freq)
+	if (!input_boost_freq || !ms)
 		return;
 
-	now = ktime_to_us(ktime_get());
-	if (now - last_input_time < MIN_INPUT_INTERVAL)
+	now = ktime_get();
+	until = ktime_add_us(now, ms * USEC_PER_MSEC);
+
+	spin_lock_irqsave(&bs.lock, flags);
+	bs.stats.kicks[src]++;
+	if (bs.blanked)
+		goto out;
+
+	if (!bs.active) {
+		if (src != CPU_BOOST_SRC_INPUT)
+			goto out;
+		bs.active = true;
+		bs.start = now;
+		bs.hold_until = now;
+		bs.stats.sessions++;
+	} else if (boost_session_max_ms &&
+		   ktime_us_delta(now, bs.start) >=
+		   (s64)boost_session_max_ms * USEC_PER_MSEC) {
+		if (bs.hold_until.tv64 > now.tv64) {
+			bs.hold_until = now;
+			bs.stats.capped++;
+		}
+		goto out;
+	}
+
+	bs.stats.hits[src]++;
+	if (until.tv64 > bs.hold_until.tv64)
+		bs.hold_until = until;
+	if (bs.level != input_boost_freq) {
+		bs.level = input_boost_freq;
+		apply = true;
+	}
+out:
+	spin_unlock_irqrestore(&bs.lock, flags);
+
+	if (apply)
+		queue_work(cpu_boost_wq, &input_boost_work);
+}
+
+void cpu_boost_binder_transaction(struct task_struct *target)
+{
+	if (!target || !binder_boost_comm[0])
 		return;
 
-	if (work_pending(&input_boost_work))
+	if (strncmp(target->comm, binder_boost_comm, TASK_COMM_LEN))
 		return;
 
-	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	cpu_boost_kick(CPU_BOOST_SRC_BINDER, binder_boost_ms);
+}
+
+static int cpuboost_fb_notifier(struct notifier_block *nb,
+				unsigned long val, void *data)
+{
+	struct fb_event *evdata = data;
+	unsigned long flags;
+	bool apply = false;
+	int blank;
+
+	if (!evdata || !evdata->info || evdata->info->node != 0)
+		return NOTIFY_OK;
+
+	switch (val) {
+	case FB_EVENT_FRAME_COMMIT:
+		cpu_boost_kick(CPU_BOOST_SRC_FRAME, frame_boost_ms);
+		break;
+	case FB_EVENT_BLANK:
+		if (!evdata->data)
+			break;
+		blank = *(int *)evdata->data;
+		spin_lock_irqsave(&bs.lock, flags);
+		bs.blanked = (blank != FB_BLANK_UNBLANK);
+		if (bs.blanked && bs.active) {
+			boost_session_end_locked(ktime_get());
+			apply = true;
+		}
+		spin_unlock_irqrestore(&bs.lock, flags);
+		if (apply)
+			queue_work(cpu_boost_wq, &input_boost_work);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpuboost_fb_nb = {
+	.notifier_call = cpuboost_fb_notifier,
+};
+
+static void cpuboost_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	cpu_boost_kick(CPU_BOOST_SRC_INPUT, input_boost_ms);
 }
 
 static int cpuboost_input_connect(struct input_handler *handler,
@@ -272,7 +482,7 @@ static void cpuboost_input_disconnect(struct input_handle *handle)
 }
 
 static const struct input_device_id cpuboost_ids[] = {
-	
+
 	{
 		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
 			INPUT_DEVICE_ID_MATCH_ABSBIT,
@@ -281,7 +491,7 @@ static const struct input_device_id cpuboost_ids[] = {
 			BIT_MASK(ABS_MT_POSITION_X) |
 			BIT_MASK(ABS_MT_POSITION_Y) },
 	},
-	
+
 	{
 		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
 			INPUT_DEVICE_ID_MATCH_ABSBIT,
@@ -289,7 +499,7 @@ static const struct input_device_id cpuboost_ids[] = {
 		.absbit = { [BIT_WORD(ABS_X)] =
 			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
 	},
-	
+
 	{
 		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
 		.evbit = { BIT_MASK(EV_KEY) },
@@ -305,6 +515,89 @@ static struct input_handler cpuboost_input_handler = {
 	.id_table       = cpuboost_ids,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int cpuboost_stats_show(struct seq_file *m, void *unused)
+{
+	struct boost_stats snap;
+	unsigned long flags;
+	unsigned int level;
+	s64 age_us = -1;
+	int i;
+
+	spin_lock_irqsave(&bs.lock, flags);
+	snap = bs.stats;
+	level = bs.level;
+	if (bs.active)
+		age_us = ktime_us_delta(ktime_get(), bs.start);
+	spin_unlock_irqrestore(&bs.lock, flags);
+
+	seq_printf(m, "active: %d level: %u kHz", age_us >= 0, level);
+	if (age_us >= 0)
+		seq_printf(m, " age: %lld ms", div_s64(age_us, USEC_PER_MSEC));
+	seq_printf(m, "\n\n%-8s %12s %12s\n", "source", "kicks", "hits");
+	for (i = 0; i < NR_CPU_BOOST_SRC; i++)
+		seq_printf(m, "%-8s %12lu %12lu\n", boost_src_name[i],
+			   snap.kicks[i], snap.hits[i]);
+
+	seq_printf(m, "\nsessions: %lu\ncapped: %lu\ndecay_steps: %lu\n",
+		   snap.sessions, snap.capped, snap.decay_steps);
+	seq_printf(m, "total_ms: %llu\nmax_ms: %llu\n",
+		   div_u64(snap.total_us, USEC_PER_MSEC),
+		   div_u64(snap.max_us, USEC_PER_MSEC));
+
+	seq_printf(m, "\nduration histogram:\n");
+	for (i = 0; i < NR_BOOST_DUR_BUCKETS; i++) {
+		if (boost_dur_bucket_ms[i] == UINT_MAX)
+			seq_printf(m, "  >=%5u ms: %lu\n",
+				   boost_dur_bucket_ms[i - 1], snap.dur_hist[i]);
+		else
+			seq_printf(m, "  < %5u ms: %lu\n",
+				   boost_dur_bucket_ms[i], snap.dur_hist[i]);
+	}
+
+	return 0;
+}
+
+static int cpuboost_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpuboost_stats_show, NULL);
+}
+
+static ssize_t cpuboost_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bs.lock, flags);
+	memset(&bs.stats, 0, sizeof(bs.stats));
+	spin_unlock_irqrestore(&bs.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations cpuboost_stats_fops = {
+	.open		= cpuboost_stats_open,
+	.read		= seq_read,
+	.write		= cpuboost_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void cpuboost_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpu_boost", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir, NULL,
+			    &cpuboost_stats_fops);
+}
+#else
+static inline void cpuboost_debugfs_init(void) { }
+#endif
+
 static int cpu_boost_init(void)
 {
 	int cpu, ret;
@@ -317,6 +610,7 @@ static int cpu_boost_init(void)
 		return -EFAULT;
 
 	INIT_WORK(&input_boost_work, do_input_boost);
+	INIT_DELAYED_WORK(&input_boost_rem, do_input_boost_rem);
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
@@ -324,13 +618,15 @@ static int cpu_boost_init(void)
 		init_waitqueue_head(&s->sync_wq);
 		spin_lock_init(&s->lock);
 		INIT_DELAYED_WORK(&s->boost_rem, do_boost_rem);
-		INIT_DELAYED_WORK(&s->input_boost_rem, do_input_boost_rem);
 		s->thread = kthread_run(boost_mig_sync_thread, (void *)cpu,
 					"boost_sync/%d", cpu);
 	}
 	atomic_notifier_chain_register(&migration_notifier_head,
 					&boost_migration_nb);
 
+	fb_register_client(&cpuboost_fb_nb);
+	cpuboost_debugfs_init();
+
 	ret = input_register_handler(&cpuboost_input_handler);
 	return 0;
 }
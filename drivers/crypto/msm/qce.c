@@ -2071,6 +2071,15 @@ bad:
 }
 EXPORT_SYMBOL(qce_ablk_cipher_req);
 
+int qce_ablk_cipher_req_batch(void *handle, struct qce_req *c_req,
+		unsigned int n)
+{
+	if (n != 1)
+		return -EINVAL;
+	return qce_ablk_cipher_req(handle, c_req);
+}
+EXPORT_SYMBOL(qce_ablk_cipher_req_batch);
+
 int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 {
 	struct qce_device *pce_dev = (struct qce_device *) handle;
@@ -2295,6 +2304,8 @@ int qce_hw_support(void *handle, struct ce_hw_support *ce_support)
 	ce_support->aligned_only = false;
 	ce_support->is_shared = false;
 	ce_support->bam = false;
+	ce_support->max_batch = 1;
+	ce_support->max_batch_len = 0;
 	return 0;
 }
 EXPORT_SYMBOL(qce_hw_support);
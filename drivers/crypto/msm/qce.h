@@ -48,6 +48,8 @@
 
 #define QCE_MAX_OPER_DATA		0xFF00
 
+#define QCE_MAX_BATCH			8
+
 #define MAX_NONCE  16
 
 typedef void (*qce_comp_func_ptr_t)(void *areq,
@@ -105,6 +107,8 @@ struct ce_hw_support {
 	bool bam;
 	bool is_shared;
 	bool hw_key;
+	unsigned int max_batch;
+	unsigned int max_batch_len;
 };
 
 struct qce_sha_req {
@@ -150,6 +154,8 @@ void *qce_open(struct platform_device *pdev, int *rc);
 int qce_close(void *handle);
 int qce_aead_req(void *handle, struct qce_req *req);
 int qce_ablk_cipher_req(void *handle, struct qce_req *req);
+int qce_ablk_cipher_req_batch(void *handle, struct qce_req *req,
+		unsigned int n);
 int qce_hw_support(void *handle, struct ce_hw_support *support);
 int qce_process_sha_req(void *handle, struct qce_sha_req *s_req);
 int qce_enable_clk(void *handle);
@@ -54,6 +54,26 @@ struct bam_registration_info {
 };
 static LIST_HEAD(qce50_bam_list);
 
+/*
+ * Batched ablk_cipher requests each get a private copy of their command
+ * list and their own result dump, so the whole batch can sit in the BAM
+ * pipes at once.  32 command elements cover the largest AES list, XTS
+ * with a 256 bit key.
+ */
+#define QCE_BATCH_CMDLIST_SIZE	(32 * sizeof(struct sps_command_element))
+
+struct qce_batch_ent {
+	struct ablkcipher_request *areq;
+	qce_comp_func_ptr_t qce_cb;
+	int src_nents;
+	int dst_nents;
+	int dir;
+	enum qce_cipher_mode_enum mode;
+	unsigned char dec_iv[16];
+	uint32_t cmdlist;
+	struct ce_result_dump_format *result;
+};
+
 struct qce_device {
 	struct device *pdev;        
 	struct bam_registration_info *pbam;
@@ -90,6 +110,9 @@ struct qce_device {
 	enum qce_cipher_mode_enum mode;
 	struct qce_ce_cfg_reg_setting reg;
 	struct ce_sps_data ce_sps;
+
+	struct qce_batch_ent batch[QCE_MAX_BATCH];
+	unsigned int batch_cnt;
 };
 
 static uint32_t  _std_init_vector_sha1[] =   {
@@ -1639,105 +1662,158 @@ static int _sha_complete(struct qce_device *pce_dev)
 	return 0;
 };
 
-static int _ablk_cipher_complete(struct qce_device *pce_dev)
+static void _ablk_cipher_out_iv(struct qce_device *pce_dev,
+		struct ablkcipher_request *areq, enum qce_cipher_mode_enum mode,
+		int dir, unsigned char *dec_iv,
+		struct ce_result_dump_format *result, unsigned char *iv)
 {
-	struct ablkcipher_request *areq;
-	unsigned char iv[NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE];
-	uint32_t status;
-	int32_t result_status;
-
-	areq = (struct ablkcipher_request *) pce_dev->areq;
-
-	if (areq->src != areq->dst) {
-		qce_dma_unmap_sg(pce_dev->pdev, areq->dst,
-			pce_dev->dst_nents, DMA_FROM_DEVICE);
+	if (pce_dev->ce_sps.minor_version == 0) {
+		if (mode == QCE_MODE_CBC) {
+			if  (dir == QCE_DECRYPT)
+				memcpy(iv, (char *)dec_iv, AES_IV_LENGTH);
+			else
+				memcpy(iv, (unsigned char *)
+					(sg_virt(areq->src) +
+					areq->src->length - 16),
+					AES_IV_LENGTH);
+		}
+		if ((mode == QCE_MODE_CTR) ||
+			(mode == QCE_MODE_XTS)) {
+			uint32_t num_blk = 0;
+			uint32_t cntr_iv3 = 0;
+			unsigned long long cntr_iv64 = 0;
+			unsigned char *b = (unsigned char *)(&cntr_iv3);
+
+			memcpy(iv, areq->info, AES_IV_LENGTH);
+			if (mode != QCE_MODE_XTS)
+				num_blk = areq->nbytes/16;
+			else
+				num_blk = 1;
+			cntr_iv3 =  ((*(iv + 12) << 24) & 0xff000000) |
+				(((*(iv + 13)) << 16) & 0xff0000) |
+				(((*(iv + 14)) << 8) & 0xff00) |
+				(*(iv + 15) & 0xff);
+			cntr_iv64 =
+				(((unsigned long long)cntr_iv3 &
+				(unsigned long long)0xFFFFFFFFULL) +
+				(unsigned long long)num_blk) %
+				(unsigned long long)(0x100000000ULL);
+
+			cntr_iv3 = (u32)(cntr_iv64 & 0xFFFFFFFF);
+			*(iv + 15) = (char)(*b);
+			*(iv + 14) = (char)(*(b + 1));
+			*(iv + 13) = (char)(*(b + 2));
+			*(iv + 12) = (char)(*(b + 3));
+		}
+	} else {
+		memcpy(iv, (char *)(result->encr_cntr_iv), AES_IV_LENGTH);
 	}
-	qce_dma_unmap_sg(pce_dev->pdev, areq->src, pce_dev->src_nents,
-		(areq->src == areq->dst) ? DMA_BIDIRECTIONAL :
-						DMA_TO_DEVICE);
+}
 
-	
-	status = readl_relaxed(pce_dev->iobase + CRYPTO_STATUS_REG);
+static int32_t _ablk_cipher_status(struct qce_device *pce_dev)
+{
+	uint32_t status;
 
-	if (_qce_unlock_other_pipes(pce_dev))
-		return -EINVAL;
+	status = readl_relaxed(pce_dev->iobase + CRYPTO_STATUS_REG);
 
 	if (status & ((1 << CRYPTO_SW_ERR) | (1 << CRYPTO_AXI_ERR)
 			| (1 <<  CRYPTO_HSD_ERR))) {
 		pr_err("ablk_cipher operation error. Status %x\n",
 				status);
-		result_status = -ENXIO;
+		return -ENXIO;
 	} else if (pce_dev->ce_sps.consumer_status |
 				pce_dev->ce_sps.producer_status)  {
 		pr_err("ablk_cipher sps operation error. sps status %x %x\n",
 				pce_dev->ce_sps.consumer_status,
 				pce_dev->ce_sps.producer_status);
-		result_status = -ENXIO;
+		return -ENXIO;
 	} else if ((status & (1 << CRYPTO_OPERATION_DONE)) == 0) {
 		pr_err("ablk_cipher operation not done? Status %x, sps status %x %x\n",
 			status,
 			pce_dev->ce_sps.consumer_status,
 			pce_dev->ce_sps.producer_status);
-		result_status = -ENXIO;
+		return -ENXIO;
+	}
+	return 0;
+}
 
-	} else {
-		result_status = 0;
+static int _ablk_cipher_complete(struct qce_device *pce_dev)
+{
+	struct ablkcipher_request *areq;
+	unsigned char iv[NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE];
+	int32_t result_status;
+
+	areq = (struct ablkcipher_request *) pce_dev->areq;
+
+	if (areq->src != areq->dst) {
+		qce_dma_unmap_sg(pce_dev->pdev, areq->dst,
+			pce_dev->dst_nents, DMA_FROM_DEVICE);
 	}
+	qce_dma_unmap_sg(pce_dev->pdev, areq->src, pce_dev->src_nents,
+		(areq->src == areq->dst) ? DMA_BIDIRECTIONAL :
+						DMA_TO_DEVICE);
+
+	result_status = _ablk_cipher_status(pce_dev);
+
+	if (_qce_unlock_other_pipes(pce_dev))
+		return -EINVAL;
 
 	if (pce_dev->mode == QCE_MODE_ECB) {
 		pce_dev->qce_cb(areq, NULL, NULL,
 					pce_dev->ce_sps.consumer_status |
 					result_status);
 	} else {
-		if (pce_dev->ce_sps.minor_version == 0) {
-			if (pce_dev->mode == QCE_MODE_CBC) {
-				if  (pce_dev->dir == QCE_DECRYPT)
-					memcpy(iv, (char *)pce_dev->dec_iv,
-								sizeof(iv));
-				else
-					memcpy(iv, (unsigned char *)
-						(sg_virt(areq->src) +
-						areq->src->length - 16),
-						sizeof(iv));
-			}
-			if ((pce_dev->mode == QCE_MODE_CTR) ||
-				(pce_dev->mode == QCE_MODE_XTS)) {
-				uint32_t num_blk = 0;
-				uint32_t cntr_iv3 = 0;
-				unsigned long long cntr_iv64 = 0;
-				unsigned char *b = (unsigned char *)(&cntr_iv3);
-
-				memcpy(iv, areq->info, sizeof(iv));
-				if (pce_dev->mode != QCE_MODE_XTS)
-					num_blk = areq->nbytes/16;
-				else
-					num_blk = 1;
-				cntr_iv3 =  ((*(iv + 12) << 24) & 0xff000000) |
-					(((*(iv + 13)) << 16) & 0xff0000) |
-					(((*(iv + 14)) << 8) & 0xff00) |
-					(*(iv + 15) & 0xff);
-				cntr_iv64 =
-					(((unsigned long long)cntr_iv3 &
-					(unsigned long long)0xFFFFFFFFULL) +
-					(unsigned long long)num_blk) %
-					(unsigned long long)(0x100000000ULL);
-
-				cntr_iv3 = (u32)(cntr_iv64 & 0xFFFFFFFF);
-				*(iv + 15) = (char)(*b);
-				*(iv + 14) = (char)(*(b + 1));
-				*(iv + 13) = (char)(*(b + 2));
-				*(iv + 12) = (char)(*(b + 3));
-			}
-		} else {
-			memcpy(iv,
-				(char *)(pce_dev->ce_sps.result->encr_cntr_iv),
-				sizeof(iv));
-		}
+		_ablk_cipher_out_iv(pce_dev, areq, pce_dev->mode, pce_dev->dir,
+				pce_dev->dec_iv, pce_dev->ce_sps.result, iv);
 		pce_dev->qce_cb(areq, NULL, iv, result_status);
 	}
 	return 0;
 };
 
+static void _qce_batch_unmap(struct qce_device *pce_dev,
+				struct qce_batch_ent *ent)
+{
+	struct ablkcipher_request *areq = ent->areq;
+
+	if (areq->src != areq->dst && ent->dst_nents)
+		qce_dma_unmap_sg(pce_dev->pdev, areq->dst, ent->dst_nents,
+				DMA_FROM_DEVICE);
+	if (ent->src_nents)
+		qce_dma_unmap_sg(pce_dev->pdev, areq->src, ent->src_nents,
+				(areq->src == areq->dst) ?
+				DMA_BIDIRECTIONAL : DMA_TO_DEVICE);
+}
+
+static int _ablk_cipher_batch_complete(struct qce_device *pce_dev)
+{
+	unsigned char iv[NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE];
+	struct qce_batch_ent *ent;
+	int32_t result_status;
+	unsigned int i, n = pce_dev->batch_cnt;
+
+	for (i = 0; i < n; i++)
+		_qce_batch_unmap(pce_dev, &pce_dev->batch[i]);
+
+	/* the status register only holds the last operation of the batch */
+	result_status = _ablk_cipher_status(pce_dev);
+	pce_dev->batch_cnt = 0;
+
+	if (_qce_unlock_other_pipes(pce_dev))
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		ent = &pce_dev->batch[i];
+		if (ent->mode == QCE_MODE_ECB) {
+			ent->qce_cb(ent->areq, NULL, NULL, result_status);
+		} else {
+			_ablk_cipher_out_iv(pce_dev, ent->areq, ent->mode,
+					ent->dir, ent->dec_iv, ent->result, iv);
+			ent->qce_cb(ent->areq, NULL, iv, result_status);
+		}
+	}
+	return 0;
+}
+
 #ifdef QCE_DEBUG
 static void _qce_dump_descr_fifos(struct qce_device *pce_dev)
 {
@@ -2287,6 +2363,24 @@ static void _ablk_cipher_sps_producer_callback(struct sps_event_notify *notify)
 	}
 };
 
+static void _ablk_cipher_batch_sps_producer_callback(
+				struct sps_event_notify *notify)
+{
+	struct qce_device *pce_dev = (struct qce_device *)
+		((struct sps_event_notify *)notify)->user;
+
+	pce_dev->ce_sps.notify = *notify;
+	pr_debug("sps ev_id=%d, addr=0x%x, size=0x%x, flags=0x%x\n",
+			notify->event_id,
+			notify->data.transfer.iovec.addr,
+			notify->data.transfer.iovec.size,
+			notify->data.transfer.iovec.flags);
+
+	/* only the last result dump of the batch raises an interrupt */
+	pce_dev->ce_sps.producer_state = QCE_PIPE_STATE_IDLE;
+	_ablk_cipher_batch_complete(pce_dev);
+};
+
 static void qce_add_cmd_element(struct qce_device *pdev,
 			struct sps_command_element **cmd_ptr, u32 addr,
 			u32 data, struct sps_command_element **populate)
@@ -3173,6 +3267,22 @@ static int qce_setup_ce_sps_data(struct qce_device *pce_dev)
 	pce_dev->ce_sps.ignore_buffer = (uint32_t)vaddr;
 	vaddr += pce_dev->ce_sps.ce_burst_size * 2;
 
+	if (pce_dev->support_cmd_dscr) {
+		int i;
+
+		for (i = 0; i < QCE_MAX_BATCH; i++) {
+			vaddr = (unsigned char *) ALIGN(((unsigned int)vaddr),
+					pce_dev->ce_sps.ce_burst_size);
+			pce_dev->batch[i].cmdlist = (uint32_t)vaddr;
+			vaddr += QCE_BATCH_CMDLIST_SIZE;
+			vaddr = (unsigned char *) ALIGN(((unsigned int)vaddr),
+					pce_dev->ce_sps.ce_burst_size);
+			pce_dev->batch[i].result =
+				(struct ce_result_dump_format *)vaddr;
+			vaddr += CRYPTO_RESULT_DUMP_SIZE;
+		}
+	}
+
 	if ((vaddr - pce_dev->coh_vmem) > pce_dev->memsize)
 		panic("qce50: Not enough coherent memory. Allocate %x , need %x",
 			 pce_dev->memsize, vaddr - pce_dev->coh_vmem);
@@ -3818,6 +3928,124 @@ bad:
 }
 EXPORT_SYMBOL(qce_ablk_cipher_req);
 
+/*
+ * Submit n AES ablk_cipher requests as one BAM transfer: each request
+ * contributes its command list and data to the consumer pipe and its
+ * output and result dump to the producer pipe.  The engine runs them
+ * back to back and interrupts once, after the last result dump; the
+ * callbacks are then made in submission order.
+ */
+int qce_ablk_cipher_req_batch(void *handle, struct qce_req *c_req,
+		unsigned int n)
+{
+	struct qce_device *pce_dev = (struct qce_device *) handle;
+	struct qce_cmdlist_info *cmdlistinfo = NULL;
+	struct qce_cmdlist_info batch_cmd;
+	struct qce_batch_ent *ent;
+	struct ablkcipher_request *areq;
+	unsigned int i, mapped = 0;
+	int rc = 0;
+
+	if (n == 1)
+		return qce_ablk_cipher_req(handle, c_req);
+	if (!pce_dev->support_cmd_dscr || n == 0 || n > QCE_MAX_BATCH)
+		return -EINVAL;
+
+	_qce_sps_iovec_count_init(pce_dev);
+	for (i = 0; i < n; i++, c_req++) {
+		areq = (struct ablkcipher_request *) c_req->areq;
+		ent = &pce_dev->batch[i];
+
+		if (c_req->alg != CIPHER_ALG_AES ||
+				c_req->op != QCE_REQ_ABLK_CIPHER ||
+				areq->nbytes > SPS_MAX_PKT_SIZE) {
+			rc = -EINVAL;
+			goto bad;
+		}
+
+		ent->areq = areq;
+		ent->qce_cb = c_req->qce_cb;
+		ent->dir = c_req->dir;
+		ent->mode = c_req->mode;
+		ent->src_nents = count_sg(areq->src, areq->nbytes);
+		qce_dma_map_sg(pce_dev->pdev, areq->src, ent->src_nents,
+			(areq->src == areq->dst) ? DMA_BIDIRECTIONAL :
+							DMA_TO_DEVICE);
+		if (areq->src != areq->dst) {
+			ent->dst_nents = count_sg(areq->dst, areq->nbytes);
+			qce_dma_map_sg(pce_dev->pdev, areq->dst,
+				ent->dst_nents, DMA_FROM_DEVICE);
+		} else {
+			ent->dst_nents = ent->src_nents;
+		}
+		mapped++;
+
+		if ((pce_dev->ce_sps.minor_version == 0) &&
+				(c_req->dir == QCE_DECRYPT) &&
+				(c_req->mode == QCE_MODE_CBC))
+			memcpy(ent->dec_iv, (unsigned char *)
+				sg_virt(areq->src) + areq->src->length - 16,
+				NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE);
+
+		_ce_get_cipher_cmdlistinfo(pce_dev, c_req, &cmdlistinfo);
+		if (cmdlistinfo->size > QCE_BATCH_CMDLIST_SIZE) {
+			rc = -EINVAL;
+			goto bad;
+		}
+		rc = _ce_setup_cipher(pce_dev, c_req, areq->nbytes, 0,
+							cmdlistinfo);
+		if (rc < 0)
+			goto bad;
+		memcpy((void *)ent->cmdlist, (void *)cmdlistinfo->cmdlist,
+							cmdlistinfo->size);
+		batch_cmd.cmdlist = ent->cmdlist;
+		batch_cmd.size = cmdlistinfo->size;
+
+		_qce_sps_add_cmd(pce_dev, i ? 0 : SPS_IOVEC_FLAG_LOCK,
+				&batch_cmd, &pce_dev->ce_sps.in_transfer);
+		rc = _qce_sps_add_sg_data(pce_dev, areq->src, areq->nbytes,
+					&pce_dev->ce_sps.in_transfer);
+		if (rc)
+			goto bad;
+		_qce_set_flag(&pce_dev->ce_sps.in_transfer,
+				SPS_IOVEC_FLAG_EOT|SPS_IOVEC_FLAG_NWD);
+
+		rc = _qce_sps_add_sg_data(pce_dev, areq->dst, areq->nbytes,
+					&pce_dev->ce_sps.out_transfer);
+		if (rc)
+			goto bad;
+		rc = _qce_sps_add_data(GET_PHYS_ADDR((uint32_t)ent->result),
+					CRYPTO_RESULT_DUMP_SIZE,
+					&pce_dev->ce_sps.out_transfer);
+		if (rc)
+			goto bad;
+	}
+	_qce_set_flag(&pce_dev->ce_sps.out_transfer, SPS_IOVEC_FLAG_INT);
+	pce_dev->batch_cnt = n;
+
+	pce_dev->ce_sps.producer.event.callback =
+				_ablk_cipher_batch_sps_producer_callback;
+	pce_dev->ce_sps.producer.event.options = SPS_O_DESC_DONE;
+	rc = sps_register_event(pce_dev->ce_sps.producer.pipe,
+					&pce_dev->ce_sps.producer.event);
+	if (rc) {
+		pr_err("Producer callback registration failed rc = %d\n", rc);
+		goto bad;
+	}
+	pce_dev->ce_sps.producer_state = QCE_PIPE_STATE_COMP;
+
+	rc = _qce_sps_transfer(pce_dev);
+	if (rc)
+		goto bad;
+	return 0;
+bad:
+	pce_dev->batch_cnt = 0;
+	for (i = 0; i < mapped; i++)
+		_qce_batch_unmap(pce_dev, &pce_dev->batch[i]);
+	return rc;
+}
+EXPORT_SYMBOL(qce_ablk_cipher_req_batch);
+
 int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 {
 	struct qce_device *pce_dev = (struct qce_device *) handle;
@@ -4113,7 +4341,7 @@ void *qce_open(struct platform_device *pdev, int *rc)
 		goto err_pce_dev;
 	}
 
-	pce_dev->memsize = 9 * PAGE_SIZE;
+	pce_dev->memsize = 11 * PAGE_SIZE;
 	pce_dev->coh_vmem = dma_alloc_coherent(pce_dev->pdev,
 			pce_dev->memsize, &pce_dev->coh_pmem, GFP_KERNEL);
 	if (pce_dev->coh_vmem == NULL) {
@@ -4206,6 +4434,8 @@ int qce_hw_support(void *handle, struct ce_hw_support *ce_support)
 		ce_support->aligned_only = false;
 	else
 		ce_support->aligned_only = true;
+	ce_support->max_batch = pce_dev->support_cmd_dscr ? QCE_MAX_BATCH : 1;
+	ce_support->max_batch_len = SPS_MAX_PKT_SIZE;
 	return 0;
 }
 EXPORT_SYMBOL(qce_hw_support);
@@ -0,0 +1,539 @@
+/* Qualcomm Crypto Engine software model.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "QCE_MODEL: %s: " fmt, __func__
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/platform_device.h>
+#include <linux/spinlock.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <crypto/hash.h>
+#include <crypto/sha.h>
+
+#include "qce.h"
+
+/*
+ * Implements the qce.h interface on top of the software crypto API so the
+ * qcrypto queueing and routing logic can be exercised without a crypto
+ * engine.  Requests are executed one submission at a time on an ordered
+ * workqueue and held until the modelled engine service time, setup_ns plus
+ * ns_per_kb for each KiB of payload, has elapsed.  A batch of ablk_cipher
+ * requests pays setup_ns once.
+ */
+
+static unsigned int setup_ns = 40000;
+module_param(setup_ns, uint, 0644);
+MODULE_PARM_DESC(setup_ns, "Modelled per request engine setup cost in ns");
+
+static unsigned int ns_per_kb = 12000;
+module_param(ns_per_kb, uint, 0644);
+MODULE_PARM_DESC(ns_per_kb, "Modelled engine cost per KiB of data in ns");
+
+#define QCE_MODEL_MODES		(QCE_MODE_XTS + 1)
+#define QCE_MODEL_HASHES	2
+
+enum qce_model_op {
+	QCE_MODEL_OP_CIPHER,
+	QCE_MODEL_OP_HASH,
+};
+
+struct qce_model_device {
+	struct platform_device *pdev;
+	struct workqueue_struct *wq;
+	struct work_struct work;
+	spinlock_t lock;
+	bool busy;
+
+	struct crypto_blkcipher *cipher[CIPHER_ALG_LAST][QCE_MODEL_MODES];
+	struct crypto_shash *hash[QCE_MODEL_HASHES];
+	struct shash_desc *desc;
+
+	enum qce_model_op op;
+	struct qce_req creq[QCE_MAX_BATCH];
+	unsigned int ncreq;
+	struct qce_sha_req sreq;
+	unsigned int len;
+	ktime_t start;
+
+	unsigned char iv[QCE_MAX_BATCH][MAX_IV_LENGTH];
+	unsigned char digest[SHA256_DIGESTSIZE];
+	uint32_t auth_data[4];
+};
+
+static const char *const qce_model_cipher_name[CIPHER_ALG_LAST]
+						[QCE_MODEL_MODES] = {
+	[CIPHER_ALG_DES] = {
+		[QCE_MODE_CBC] = "cbc(des)",
+		[QCE_MODE_ECB] = "ecb(des)",
+	},
+	[CIPHER_ALG_3DES] = {
+		[QCE_MODE_CBC] = "cbc(des3_ede)",
+		[QCE_MODE_ECB] = "ecb(des3_ede)",
+	},
+	[CIPHER_ALG_AES] = {
+		[QCE_MODE_CBC] = "cbc(aes)",
+		[QCE_MODE_ECB] = "ecb(aes)",
+		[QCE_MODE_CTR] = "ctr(aes)",
+		[QCE_MODE_XTS] = "xts(aes)",
+	},
+};
+
+/* the state layout of the generic drivers is what import/export rely on */
+static const char *const qce_model_hash_name[QCE_MODEL_HASHES] = {
+	"sha1-generic",
+	"sha256-generic",
+};
+
+static u64 qce_model_cost(unsigned int len)
+{
+	return setup_ns + div_u64((u64)len * ns_per_kb, 1024);
+}
+
+static int qce_model_do_cipher(struct qce_model_device *pdev, unsigned int i)
+{
+	struct qce_req *creq = &pdev->creq[i];
+	struct ablkcipher_request *areq = creq->areq;
+	struct crypto_blkcipher *tfm = pdev->cipher[creq->alg][creq->mode];
+	struct blkcipher_desc desc;
+	int ret;
+
+	ret = crypto_blkcipher_setkey(tfm, creq->enckey, creq->encklen);
+	if (ret)
+		return ret;
+
+	desc.tfm = tfm;
+	desc.info = pdev->iv[i];
+	desc.flags = 0;
+
+	if (creq->dir == QCE_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, areq->dst, areq->src,
+						creq->cryptlen);
+	return crypto_blkcipher_decrypt_iv(&desc, areq->dst, areq->src,
+						creq->cryptlen);
+}
+
+static int qce_model_count_sg(struct scatterlist *sg, int nbytes)
+{
+	int i;
+
+	for (i = 0; nbytes > 0 && sg; i++, sg = scatterwalk_sg_next(sg))
+		nbytes -= sg->length;
+	return i;
+}
+
+static int qce_model_hmac_pad(struct shash_desc *desc,
+			struct qce_sha_req *sreq, u8 pad)
+{
+	u8 block[SHA_HMAC_KEY_SIZE];
+	int i;
+
+	for (i = 0; i < SHA_HMAC_KEY_SIZE; i++)
+		block[i] = (i < sreq->authklen ? sreq->authkey[i] : 0) ^ pad;
+	return crypto_shash_update(desc, block, SHA_HMAC_KEY_SIZE);
+}
+
+static int qce_model_import(struct qce_model_device *pdev, u64 count)
+{
+	struct qce_sha_req *sreq = &pdev->sreq;
+	union {
+		struct sha1_state sha1;
+		struct sha256_state sha256;
+	} st;
+	u32 *state;
+	int i, words;
+
+	memset(&st, 0, sizeof(st));
+	if (pdev->desc->tfm == pdev->hash[0]) {
+		st.sha1.count = count;
+		state = st.sha1.state;
+		words = SHA1_DIGEST_SIZE / sizeof(u32);
+	} else {
+		st.sha256.count = count;
+		state = st.sha256.state;
+		words = SHA256_DIGEST_SIZE / sizeof(u32);
+	}
+	for (i = 0; i < words; i++)
+		state[i] = be32_to_cpu(((__be32 *)sreq->digest)[i]);
+
+	return crypto_shash_import(pdev->desc, &st);
+}
+
+static int qce_model_export(struct qce_model_device *pdev)
+{
+	union {
+		struct sha1_state sha1;
+		struct sha256_state sha256;
+	} st;
+	u32 *state;
+	int i, words, ret;
+
+	ret = crypto_shash_export(pdev->desc, &st);
+	if (ret)
+		return ret;
+
+	if (pdev->desc->tfm == pdev->hash[0]) {
+		state = st.sha1.state;
+		words = SHA1_DIGEST_SIZE / sizeof(u32);
+	} else {
+		state = st.sha256.state;
+		words = SHA256_DIGEST_SIZE / sizeof(u32);
+	}
+	for (i = 0; i < words; i++)
+		((__be32 *)pdev->digest)[i] = cpu_to_be32(state[i]);
+	return 0;
+}
+
+static int qce_model_do_hash(struct qce_model_device *pdev)
+{
+	struct qce_sha_req *sreq = &pdev->sreq;
+	struct shash_desc *desc = pdev->desc;
+	struct sg_mapping_iter miter;
+	bool hmac = (sreq->alg == QCE_HASH_SHA1_HMAC) ||
+			(sreq->alg == QCE_HASH_SHA256_HMAC);
+	unsigned int left = sreq->size;
+	unsigned int ds;
+	u64 count;
+	int ret;
+
+	desc->tfm = pdev->hash[(sreq->alg == QCE_HASH_SHA1) ||
+				(sreq->alg == QCE_HASH_SHA1_HMAC) ? 0 : 1];
+	desc->flags = 0;
+	ds = crypto_shash_digestsize(desc->tfm);
+
+	if (sreq->first_blk) {
+		count = 0;
+		ret = crypto_shash_init(desc);
+		if (!ret && hmac) {
+			ret = qce_model_hmac_pad(desc, sreq, 0x36);
+			count = SHA_HMAC_KEY_SIZE;
+		}
+	} else {
+		count = sreq->auth_data[0] | (u64)sreq->auth_data[1] << 32;
+		ret = qce_model_import(pdev, count);
+	}
+	if (ret)
+		return ret;
+
+	sg_miter_start(&miter, sreq->src,
+			qce_model_count_sg(sreq->src, sreq->size),
+			SG_MITER_ATOMIC | SG_MITER_FROM_SG);
+	while (left && sg_miter_next(&miter)) {
+		unsigned int n = min_t(unsigned int, miter.length, left);
+
+		ret = crypto_shash_update(desc, miter.addr, n);
+		if (ret)
+			break;
+		left -= n;
+	}
+	sg_miter_stop(&miter);
+	if (ret)
+		return ret;
+
+	count += sreq->size;
+	pdev->auth_data[0] = (uint32_t)count;
+	pdev->auth_data[1] = (uint32_t)(count >> 32);
+	pdev->auth_data[2] = 0;
+	pdev->auth_data[3] = 0;
+
+	if (!sreq->last_blk)
+		return qce_model_export(pdev);
+
+	ret = crypto_shash_final(desc, pdev->digest);
+	if (ret || !hmac)
+		return ret;
+
+	ret = crypto_shash_init(desc);
+	if (!ret)
+		ret = qce_model_hmac_pad(desc, sreq, 0x5c);
+	if (!ret)
+		ret = crypto_shash_finup(desc, pdev->digest, ds, pdev->digest);
+	return ret;
+}
+
+static void qce_model_work(struct work_struct *work)
+{
+	struct qce_model_device *pdev = container_of(work,
+					struct qce_model_device, work);
+	enum qce_model_op op = pdev->op;
+	struct qce_req creq[QCE_MAX_BATCH];
+	unsigned char iv[QCE_MAX_BATCH][MAX_IV_LENGTH];
+	struct qce_sha_req sreq;
+	int res[QCE_MAX_BATCH];
+	unsigned long flags;
+	unsigned int i, n = 0;
+	u64 cost, elapsed;
+	int ret = 0;
+
+	if (op == QCE_MODEL_OP_CIPHER) {
+		n = pdev->ncreq;
+		for (i = 0; i < n; i++)
+			res[i] = qce_model_do_cipher(pdev, i) ? -ENXIO : 0;
+	} else {
+		ret = qce_model_do_hash(pdev);
+		if (ret)
+			ret = -ENXIO;
+	}
+
+	cost = qce_model_cost(pdev->len);
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), pdev->start));
+	if (cost > elapsed) {
+		unsigned long us = div_u64(cost - elapsed, NSEC_PER_USEC);
+
+		if (us)
+			usleep_range(us, us + 1);
+	}
+
+	/* the callbacks may submit again, which overwrites the device state */
+	memcpy(creq, pdev->creq, n * sizeof(creq[0]));
+	memcpy(iv, pdev->iv, n * sizeof(iv[0]));
+	sreq = pdev->sreq;
+
+	spin_lock_irqsave(&pdev->lock, flags);
+	pdev->busy = false;
+	spin_unlock_irqrestore(&pdev->lock, flags);
+
+	if (op == QCE_MODEL_OP_CIPHER)
+		for (i = 0; i < n; i++)
+			creq[i].qce_cb(creq[i].areq, NULL,
+				creq[i].mode == QCE_MODE_ECB ? NULL : iv[i],
+				res[i]);
+	else
+		sreq.qce_cb(sreq.areq, pdev->digest,
+			(unsigned char *)pdev->auth_data, ret);
+}
+
+static bool qce_model_claim(struct qce_model_device *pdev)
+{
+	unsigned long flags;
+	bool busy;
+
+	spin_lock_irqsave(&pdev->lock, flags);
+	busy = pdev->busy;
+	pdev->busy = true;
+	spin_unlock_irqrestore(&pdev->lock, flags);
+
+	return !busy;
+}
+
+static void qce_model_start(struct qce_model_device *pdev,
+			enum qce_model_op op, unsigned int len)
+{
+	pdev->op = op;
+	pdev->len = len;
+	pdev->start = ktime_get();
+	queue_work(pdev->wq, &pdev->work);
+}
+
+int qce_aead_req(void *handle, struct qce_req *q_req)
+{
+	return -EOPNOTSUPP;
+}
+EXPORT_SYMBOL(qce_aead_req);
+
+int qce_ablk_cipher_req_batch(void *handle, struct qce_req *c_req,
+		unsigned int n)
+{
+	struct qce_model_device *pdev = (struct qce_model_device *)handle;
+	unsigned int i, len = 0;
+
+	if (n == 0 || n > QCE_MAX_BATCH)
+		return -EINVAL;
+	for (i = 0; i < n; i++) {
+		if (c_req[i].use_pmem)
+			return -EOPNOTSUPP;
+		if (c_req[i].alg >= CIPHER_ALG_LAST ||
+				c_req[i].mode >= QCE_MODEL_MODES ||
+				!pdev->cipher[c_req[i].alg][c_req[i].mode])
+			return -EOPNOTSUPP;
+		if (c_req[i].encklen == 0 || c_req[i].ivsize > MAX_IV_LENGTH)
+			return -EINVAL;
+		len += c_req[i].cryptlen;
+	}
+
+	if (!qce_model_claim(pdev))
+		return -EBUSY;
+
+	pdev->ncreq = n;
+	for (i = 0; i < n; i++) {
+		pdev->creq[i] = c_req[i];
+		if (c_req[i].ivsize)
+			memcpy(pdev->iv[i], c_req[i].iv, c_req[i].ivsize);
+	}
+	qce_model_start(pdev, QCE_MODEL_OP_CIPHER, len);
+	return 0;
+}
+EXPORT_SYMBOL(qce_ablk_cipher_req_batch);
+
+int qce_ablk_cipher_req(void *handle, struct qce_req *c_req)
+{
+	return qce_ablk_cipher_req_batch(handle, c_req, 1);
+}
+EXPORT_SYMBOL(qce_ablk_cipher_req);
+
+int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
+{
+	struct qce_model_device *pdev = (struct qce_model_device *)handle;
+
+	if (sreq->alg >= QCE_HASH_AES_CMAC)
+		return -EOPNOTSUPP;
+	if ((sreq->alg == QCE_HASH_SHA1_HMAC ||
+			sreq->alg == QCE_HASH_SHA256_HMAC) &&
+			sreq->authklen > SHA_HMAC_KEY_SIZE)
+		return -EINVAL;
+
+	if (!qce_model_claim(pdev))
+		return -EBUSY;
+
+	pdev->sreq = *sreq;
+	qce_model_start(pdev, QCE_MODEL_OP_HASH, sreq->size);
+	return 0;
+}
+EXPORT_SYMBOL(qce_process_sha_req);
+
+int qce_enable_clk(void *handle)
+{
+	return 0;
+}
+EXPORT_SYMBOL(qce_enable_clk);
+
+int qce_disable_clk(void *handle)
+{
+	return 0;
+}
+EXPORT_SYMBOL(qce_disable_clk);
+
+static void qce_model_free(struct qce_model_device *pdev)
+{
+	int i, j;
+
+	if (pdev->wq)
+		destroy_workqueue(pdev->wq);
+	for (i = 0; i < CIPHER_ALG_LAST; i++)
+		for (j = 0; j < QCE_MODEL_MODES; j++)
+			if (pdev->cipher[i][j])
+				crypto_free_blkcipher(pdev->cipher[i][j]);
+	for (i = 0; i < QCE_MODEL_HASHES; i++)
+		if (pdev->hash[i])
+			crypto_free_shash(pdev->hash[i]);
+	kfree(pdev->desc);
+	kfree(pdev);
+}
+
+void *qce_open(struct platform_device *pdev, int *rc)
+{
+	struct qce_model_device *qce_dev;
+	unsigned int descsize = 0;
+	int i, j;
+
+	qce_dev = kzalloc(sizeof(*qce_dev), GFP_KERNEL);
+	if (!qce_dev) {
+		*rc = -ENOMEM;
+		return NULL;
+	}
+	qce_dev->pdev = pdev;
+	spin_lock_init(&qce_dev->lock);
+	INIT_WORK(&qce_dev->work, qce_model_work);
+
+	qce_dev->wq = alloc_ordered_workqueue("qce_model", 0);
+	if (!qce_dev->wq) {
+		*rc = -ENOMEM;
+		goto err;
+	}
+
+	for (i = 0; i < CIPHER_ALG_LAST; i++) {
+		for (j = 0; j < QCE_MODEL_MODES; j++) {
+			struct crypto_blkcipher *tfm;
+
+			if (!qce_model_cipher_name[i][j])
+				continue;
+			tfm = crypto_alloc_blkcipher(qce_model_cipher_name[i][j],
+						0, CRYPTO_ALG_ASYNC);
+			if (IS_ERR(tfm)) {
+				pr_info("%s not modelled\n",
+					qce_model_cipher_name[i][j]);
+				continue;
+			}
+			qce_dev->cipher[i][j] = tfm;
+		}
+	}
+
+	for (i = 0; i < QCE_MODEL_HASHES; i++) {
+		struct crypto_shash *tfm;
+
+		tfm = crypto_alloc_shash(qce_model_hash_name[i], 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("can't allocate %s\n", qce_model_hash_name[i]);
+			*rc = PTR_ERR(tfm);
+			goto err;
+		}
+		qce_dev->hash[i] = tfm;
+		descsize = max(descsize, crypto_shash_descsize(tfm));
+	}
+
+	qce_dev->desc = kmalloc(sizeof(struct shash_desc) + descsize,
+				GFP_KERNEL);
+	if (!qce_dev->desc) {
+		*rc = -ENOMEM;
+		goto err;
+	}
+
+	dev_info(&pdev->dev, "software engine model, setup %u ns, %u ns/KiB\n",
+			setup_ns, ns_per_kb);
+	*rc = 0;
+	return qce_dev;
+err:
+	qce_model_free(qce_dev);
+	return NULL;
+}
+EXPORT_SYMBOL(qce_open);
+
+int qce_close(void *handle)
+{
+	struct qce_model_device *pdev = (struct qce_model_device *)handle;
+
+	if (handle == NULL)
+		return -ENODEV;
+
+	flush_workqueue(pdev->wq);
+	qce_model_free(pdev);
+	return 0;
+}
+EXPORT_SYMBOL(qce_close);
+
+int qce_hw_support(void *handle, struct ce_hw_support *ce_support)
+{
+	struct qce_model_device *pdev = (struct qce_model_device *)handle;
+
+	if (ce_support == NULL)
+		return -EINVAL;
+
+	memset(ce_support, 0, sizeof(*ce_support));
+	ce_support->aes_key_192 = true;
+	ce_support->aes_xts = pdev->cipher[CIPHER_ALG_AES][QCE_MODE_XTS] != NULL;
+	ce_support->bam = true;
+	ce_support->max_batch = QCE_MAX_BATCH;
+	ce_support->max_batch_len = QCE_MAX_OPER_DATA;
+	return 0;
+}
+EXPORT_SYMBOL(qce_hw_support);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Crypto Engine software model");
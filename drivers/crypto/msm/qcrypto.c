@@ -24,6 +24,8 @@
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <crypto/ctr.h>
 #include <crypto/des.h>
@@ -81,6 +83,49 @@ static struct crypto_stat _qcrypto_stat;
 static struct dentry *_debug_dent;
 static char _debug_read_buf[DEBUG_MAX_RW_BUF];
 
+#define QCRYPTO_ROUTE_BUCKETS	13
+
+enum qcrypto_path {
+	QCRYPTO_PATH_HW,
+	QCRYPTO_PATH_SW,
+	QCRYPTO_PATH_MAX
+};
+
+struct qcrypto_path_stat {
+	u64 reqs;
+	u64 bytes;
+	u64 ns;
+	u32 ewma_ns;
+};
+
+struct qcrypto_route_stat {
+	struct qcrypto_path_stat path[QCRYPTO_PATH_MAX][QCRYPTO_ROUTE_BUCKETS];
+	u32 decisions[QCRYPTO_ROUTE_BUCKETS];
+	u32 to_hw;
+	u32 to_sw;
+	u32 probes;
+};
+static struct qcrypto_route_stat _qcrypto_route_stat;
+static DEFINE_SPINLOCK(_qcrypto_route_lock);
+
+static int route = 1;
+module_param(route, int, 0644);
+MODULE_PARM_DESC(route, "Request routing: 0 engine only, 1 adaptive, 2 software only");
+
+static unsigned int route_probe = 64;
+module_param(route_probe, uint, 0644);
+MODULE_PARM_DESC(route_probe, "Send every Nth request to the slower path to keep its latency current");
+
+static unsigned int batch = QCE_MAX_BATCH;
+module_param(batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Most queued AES requests handed to the engine in one submission");
+
+struct qcrypto_req_slot {
+	struct crypto_async_request *req;
+	unsigned int len;
+	int res;
+};
+
 struct crypto_priv {
 	
 	struct msm_ce_hw_support platform_support;
@@ -103,7 +148,6 @@ struct crypto_priv {
 
 	
 	struct crypto_async_request *req;
-	int res;
 
 	
 	struct crypto_queue queue;
@@ -114,6 +158,12 @@ struct crypto_priv {
 	struct work_struct unlock_ce_ws;
 
 	struct tasklet_struct done_tasklet;
+
+	/* requests of the submission in flight, in queue order */
+	struct qcrypto_req_slot slot[QCE_MAX_BATCH];
+	unsigned int nr_slots;
+	unsigned int nr_done;
+	ktime_t req_start;
 };
 
 
@@ -217,6 +267,10 @@ struct qcrypto_cipher_ctx {
 
 	struct crypto_priv *cp;
 	unsigned int flags;
+
+	struct crypto_blkcipher *fallback;
+	bool fallback_key;
+	unsigned int hw_pending;
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -275,6 +329,8 @@ struct qcrypto_sha_ctx {
 	struct scatterlist tmp_sg;
 	struct crypto_priv *cp;
 	unsigned int flags;
+	struct crypto_shash *fallback;
+	unsigned int hw_pending;
 };
 
 struct qcrypto_sha_req_ctx {
@@ -440,6 +496,167 @@ size_t qcrypto_sg_copy_to_buffer(struct scatterlist *sgl, unsigned int nents,
 
 	return offset;
 }
+/*
+ * Requests for which both the engine and a software implementation exist
+ * are routed by comparing the recent latency of each path for requests of
+ * the same size class.  The engine estimate is scaled by the number of
+ * submissions already queued for it, so a backlog spills small requests
+ * over to the CPU.  A request only goes to the CPU when nothing of its
+ * transform is queued to or running on the engine: the CPU completes it
+ * at once, and must not overtake earlier requests of the same transform.
+ */
+static unsigned int *_qcrypto_hw_pending(struct crypto_tfm *tfm)
+{
+	if (crypto_tfm_alg_type(tfm) == CRYPTO_ALG_TYPE_AHASH)
+		return &((struct qcrypto_sha_ctx *)
+				crypto_tfm_ctx(tfm))->hw_pending;
+	return &((struct qcrypto_cipher_ctx *)crypto_tfm_ctx(tfm))->hw_pending;
+}
+
+static unsigned int _qcrypto_max_batch(struct crypto_priv *cp)
+{
+	if (cp->ce_support.aligned_only)
+		return 1;
+	return max(1U, min(batch, cp->ce_support.max_batch));
+}
+
+static int _qcrypto_route_bucket(unsigned int nbytes)
+{
+	int b = nbytes > 16 ? fls(nbytes - 1) - 4 : 0;
+
+	return min(b, QCRYPTO_ROUTE_BUCKETS - 1);
+}
+
+static void _qcrypto_route_account(enum qcrypto_path path,
+				unsigned int nbytes, ktime_t start)
+{
+	struct qcrypto_path_stat *pstat;
+	unsigned long flags;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u32 sample = min_t(u64, ns, UINT_MAX);
+
+	spin_lock_irqsave(&_qcrypto_route_lock, flags);
+	pstat = &_qcrypto_route_stat.path[path][_qcrypto_route_bucket(nbytes)];
+	pstat->reqs++;
+	pstat->bytes += nbytes;
+	pstat->ns += ns;
+	if (pstat->ewma_ns)
+		pstat->ewma_ns = pstat->ewma_ns - (pstat->ewma_ns >> 3) +
+							(sample >> 3);
+	else
+		pstat->ewma_ns = sample;
+	spin_unlock_irqrestore(&_qcrypto_route_lock, flags);
+}
+
+static bool _qcrypto_route_sw(struct crypto_priv *cp, struct crypto_tfm *tfm,
+				unsigned int nbytes)
+{
+	struct qcrypto_route_stat *rstat = &_qcrypto_route_stat;
+	int b = _qcrypto_route_bucket(nbytes);
+	unsigned long flags;
+	unsigned int depth;
+	u64 hw, sw;
+	bool use_sw;
+
+	if (route == 0)
+		return false;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	if (*_qcrypto_hw_pending(tfm)) {
+		spin_unlock_irqrestore(&cp->lock, flags);
+		return false;
+	}
+	depth = cp->queue.qlen / _qcrypto_max_batch(cp) + (cp->req != NULL);
+	spin_unlock_irqrestore(&cp->lock, flags);
+
+	if (route == 2)
+		return true;
+
+	spin_lock_irqsave(&_qcrypto_route_lock, flags);
+	hw = rstat->path[QCRYPTO_PATH_HW][b].ewma_ns;
+	sw = rstat->path[QCRYPTO_PATH_SW][b].ewma_ns;
+	if (!hw || !sw) {
+		use_sw = hw != 0;
+	} else {
+		use_sw = sw < hw * (depth + 1);
+		if (route_probe && ++rstat->decisions[b] % route_probe == 0) {
+			use_sw = !use_sw;
+			rstat->probes++;
+		}
+	}
+	if (use_sw)
+		rstat->to_sw++;
+	else
+		rstat->to_hw++;
+	spin_unlock_irqrestore(&_qcrypto_route_lock, flags);
+
+	return use_sw;
+}
+
+static bool _qcrypto_ablk_cipher_can_fallback(struct ablkcipher_request *req)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+
+	return ctx->fallback && ctx->fallback_key && !ctx->flags;
+}
+
+static int _qcrypto_ablk_cipher_sw(struct ablkcipher_request *req)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct qcrypto_cipher_req_ctx *rctx = ablkcipher_request_ctx(req);
+	struct crypto_stat *pstat = &_qcrypto_stat;
+	struct blkcipher_desc desc;
+	ktime_t start = ktime_get();
+	int ret;
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (rctx->dir == QCE_ENCRYPT)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+						req->nbytes);
+	if (ret) {
+		pstat->ablk_cipher_op_fail++;
+	} else {
+		pstat->ablk_cipher_op_success++;
+		_qcrypto_route_account(QCRYPTO_PATH_SW, req->nbytes, start);
+	}
+	return ret;
+}
+
+static struct shash_desc *_qcrypto_sha_fallback_desc(struct ahash_request *req)
+{
+	struct qcrypto_sha_req_ctx *rctx = ahash_request_ctx(req);
+
+	return (struct shash_desc *)PTR_ALIGN((u8 *)(rctx + 1),
+						CRYPTO_MINALIGN);
+}
+
+static int _qcrypto_ahash_sw(struct ahash_request *req)
+{
+	struct qcrypto_sha_ctx *sha_ctx = crypto_tfm_ctx(req->base.tfm);
+	struct shash_desc *desc = _qcrypto_sha_fallback_desc(req);
+	struct crypto_stat *pstat = &_qcrypto_stat;
+	ktime_t start = ktime_get();
+	int ret;
+
+	desc->tfm = sha_ctx->fallback;
+	desc->flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	ret = shash_ahash_digest(req, desc);
+	if (ret) {
+		pstat->sha_op_fail++;
+	} else {
+		pstat->sha_op_success++;
+		_qcrypto_route_account(QCRYPTO_PATH_SW, req->nbytes, start);
+	}
+	return ret;
+}
+
 static struct qcrypto_alg *_qcrypto_sha_alg_alloc(struct crypto_priv *cp,
 		struct ahash_alg *template)
 {
@@ -506,7 +723,21 @@ static int _qcrypto_ahash_cra_init(struct crypto_tfm *tfm)
 	struct qcrypto_alg *q_alg = container_of(alg, struct qcrypto_alg,
 								sha_alg);
 
-	crypto_ahash_set_reqsize(ahash, sizeof(struct qcrypto_sha_req_ctx));
+	sha_ctx->fallback = NULL;
+	if (strncmp(crypto_tfm_alg_name(tfm), "hmac(", 5)) {
+		sha_ctx->fallback = crypto_alloc_shash(crypto_tfm_alg_name(tfm),
+					0, CRYPTO_ALG_NEED_FALLBACK);
+		if (IS_ERR(sha_ctx->fallback))
+			sha_ctx->fallback = NULL;
+	}
+	if (sha_ctx->fallback)
+		crypto_ahash_set_reqsize(ahash,
+				sizeof(struct qcrypto_sha_req_ctx) +
+				CRYPTO_MINALIGN + sizeof(struct shash_desc) +
+				crypto_shash_descsize(sha_ctx->fallback));
+	else
+		crypto_ahash_set_reqsize(ahash,
+				sizeof(struct qcrypto_sha_req_ctx));
 	
 	sha_ctx->cp = q_alg->cp;
 	sha_ctx->sg = NULL;
@@ -515,6 +746,8 @@ static int _qcrypto_ahash_cra_init(struct crypto_tfm *tfm)
 	sha_ctx->tmp_tbuf = kzalloc(SHA_MAX_BLOCK_SIZE +
 					SHA_MAX_DIGEST_SIZE, GFP_KERNEL);
 	if (sha_ctx->tmp_tbuf == NULL) {
+		if (sha_ctx->fallback)
+			crypto_free_shash(sha_ctx->fallback);
 		pr_err("qcrypto Can't Allocate mem: sha_ctx->tmp_tbuf, error %ld\n",
 			PTR_ERR(sha_ctx->tmp_tbuf));
 		return -ENOMEM;
@@ -524,6 +757,8 @@ static int _qcrypto_ahash_cra_init(struct crypto_tfm *tfm)
 	if (sha_ctx->trailing_buf == NULL) {
 		kfree(sha_ctx->tmp_tbuf);
 		sha_ctx->tmp_tbuf = NULL;
+		if (sha_ctx->fallback)
+			crypto_free_shash(sha_ctx->fallback);
 		pr_err("qcrypto Can't Allocate mem: sha_ctx->trailing_buf, error %ld\n",
 			PTR_ERR(sha_ctx->trailing_buf));
 		return -ENOMEM;
@@ -552,6 +787,10 @@ static void _qcrypto_ahash_cra_exit(struct crypto_tfm *tfm)
 		ahash_request_free(sha_ctx->ahash_req);
 		sha_ctx->ahash_req = NULL;
 	}
+	if (sha_ctx->fallback) {
+		crypto_free_shash(sha_ctx->fallback);
+		sha_ctx->fallback = NULL;
+	}
 	if (sha_ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(sha_ctx->cp, false);
 };
@@ -588,7 +827,18 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
+
+	ctx->fallback = NULL;
+	ctx->fallback_key = false;
+	if (strstr(crypto_tfm_alg_name(tfm), "(aes)")) {
+		ctx->fallback = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm),
+				0, CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+		if (IS_ERR(ctx->fallback))
+			ctx->fallback = NULL;
+	}
 	return _qcrypto_cipher_cra_init(tfm);
 };
 
@@ -602,6 +852,10 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback) {
+		crypto_free_blkcipher(ctx->fallback);
+		ctx->fallback = NULL;
+	}
 	if (ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(ctx->cp, false);
 };
@@ -717,6 +971,53 @@ static int _disp_stats(int id)
 	return len;
 }
 
+static int _disp_route_stats(int id)
+{
+	struct qcrypto_route_stat rstat;
+	unsigned long flags;
+	int len, b, p;
+
+	spin_lock_irqsave(&_qcrypto_route_lock, flags);
+	rstat = _qcrypto_route_stat;
+	spin_unlock_irqrestore(&_qcrypto_route_lock, flags);
+
+	len = scnprintf(_debug_read_buf, DEBUG_MAX_RW_BUF - 1,
+			"\nQualcomm crypto accelerator %d Routing (mode %d):\n",
+				id + 1, route);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Routed to engine             : %u\n", rstat.to_hw);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Routed to software           : %u\n", rstat.to_sw);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Probes of the slower path    : %u\n", rstat.probes);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   %7s %10s %8s %7s %10s %8s %7s\n", "size",
+			"hw reqs", "hw us", "hw MB/s",
+			"sw reqs", "sw us", "sw MB/s");
+
+	for (b = 0; b < QCRYPTO_ROUTE_BUCKETS; b++) {
+		len += scnprintf(_debug_read_buf + len,
+				DEBUG_MAX_RW_BUF - len - 1, "   %6u%c",
+				16 << b,
+				b == QCRYPTO_ROUTE_BUCKETS - 1 ? '+' : ' ');
+		for (p = 0; p < QCRYPTO_PATH_MAX; p++) {
+			struct qcrypto_path_stat *pstat = &rstat.path[p][b];
+			u64 mbps = 0;
+
+			if (pstat->ns)
+				mbps = div64_u64(pstat->bytes * 1000,
+							pstat->ns);
+			len += scnprintf(_debug_read_buf + len,
+					DEBUG_MAX_RW_BUF - len - 1,
+					" %10llu %8u %7llu", pstat->reqs,
+					pstat->ewma_ns / 1000, mbps);
+		}
+		len += scnprintf(_debug_read_buf + len,
+				DEBUG_MAX_RW_BUF - len - 1, "\n");
+	}
+	return len;
+}
+
 static int _qcrypto_remove(struct platform_device *pdev)
 {
 	struct crypto_priv *cp;
@@ -767,6 +1068,14 @@ static int _qcrypto_check_aes_keylen(struct crypto_ablkcipher *cipher,
 	return 0;
 }
 
+static void _qcrypto_fallback_setkey(struct qcrypto_cipher_ctx *ctx,
+		const u8 *key, unsigned int len)
+{
+	if (ctx->fallback)
+		ctx->fallback_key = !crypto_blkcipher_setkey(ctx->fallback,
+								key, len);
+}
+
 static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		unsigned int len)
 {
@@ -784,6 +1093,7 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		if (!(ctx->flags & QCRYPTO_CTX_USE_PIPE_KEY))  {
 			if (key != NULL) {
 				memcpy(ctx->enc_key, key, len);
+				_qcrypto_fallback_setkey(ctx, key, len);
 			} else {
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
@@ -809,6 +1119,7 @@ static int _qcrypto_setkey_aes_xts(struct crypto_ablkcipher *cipher,
 		if (!(ctx->flags & QCRYPTO_CTX_USE_PIPE_KEY))  {
 			if (key != NULL) {
 				memcpy(ctx->enc_key, key, len);
+				_qcrypto_fallback_setkey(ctx, key, len);
 			} else {
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
@@ -883,20 +1194,52 @@ static int _qcrypto_setkey_3des(struct crypto_ablkcipher *cipher, const u8 *key,
 	return 0;
 };
 
+/*
+ * Called from the qce completion callbacks, once for each request of the
+ * submission and in submission order.
+ */
+static void _qcrypto_req_finish(struct crypto_priv *cp, int res)
+{
+	struct qcrypto_req_slot *slot = &cp->slot[cp->nr_done];
+	unsigned long flags;
+
+	slot->res = res;
+	if (!res && slot->len)
+		_qcrypto_route_account(QCRYPTO_PATH_HW, slot->len,
+						cp->req_start);
+	if (++cp->nr_done < cp->nr_slots)
+		return;
+
+	if (cp->platform_support.ce_shared) {
+		/* each request took a CE lock count, the work drops the last */
+		spin_lock_irqsave(&cp->lock, flags);
+		cp->ce_lock_count -= cp->nr_slots - 1;
+		spin_unlock_irqrestore(&cp->lock, flags);
+		schedule_work(&cp->unlock_ce_ws);
+	}
+	tasklet_schedule(&cp->done_tasklet);
+}
+
 static void req_done(unsigned long data)
 {
-	struct crypto_async_request *areq;
+	struct qcrypto_req_slot slot[QCE_MAX_BATCH];
 	struct crypto_priv *cp = (struct crypto_priv *)data;
 	unsigned long flags;
+	unsigned int i, n;
 
 	spin_lock_irqsave(&cp->lock, flags);
-	areq = cp->req;
+	n = cp->nr_slots;
+	memcpy(slot, cp->slot, n * sizeof(slot[0]));
+	for (i = 0; i < n; i++)
+		(*_qcrypto_hw_pending(slot[i].req->tfm))--;
 	cp->req = NULL;
+	cp->nr_slots = 0;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
-	if (areq)
-		areq->complete(areq, cp->res);
+	/* keep the engine busy while the completion callbacks run */
 	_start_qcrypto_process(cp);
+	for (i = 0; i < n; i++)
+		slot[i].req->complete(slot[i].req, slot[i].res);
 };
 
 static void _update_sha1_ctx(struct ahash_request  *req)
@@ -980,10 +1323,9 @@ static void _qce_ahash_complete(void *cookie, unsigned char *digest,
 	sha_ctx->first_blk = 0;
 
 	if (ret) {
-		cp->res = -ENXIO;
+		ret = -ENXIO;
 		pstat->sha_op_fail++;
 	} else {
-		cp->res = 0;
 		pstat->sha_op_success++;
 	}
 	if (cp->ce_support.aligned_only)  {
@@ -991,9 +1333,7 @@ static void _qce_ahash_complete(void *cookie, unsigned char *digest,
 		kfree(rctx->data);
 	}
 
-	if (cp->platform_support.ce_shared)
-		schedule_work(&cp->unlock_ce_ws);
-	tasklet_schedule(&cp->done_tasklet);
+	_qcrypto_req_finish(cp, ret);
 };
 
 static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
@@ -1015,10 +1355,9 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 		memcpy(ctx->iv, iv, crypto_ablkcipher_ivsize(ablk));
 
 	if (ret) {
-		cp->res = -ENXIO;
+		ret = -ENXIO;
 		pstat->ablk_cipher_op_fail++;
 	} else {
-		cp->res = 0;
 		pstat->ablk_cipher_op_success++;
 	}
 
@@ -1040,9 +1379,7 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 		kfree(rctx->data);
 	}
 
-	if (cp->platform_support.ce_shared)
-		schedule_work(&cp->unlock_ce_ws);
-	tasklet_schedule(&cp->done_tasklet);
+	_qcrypto_req_finish(cp, ret);
 };
 
 
@@ -1154,11 +1491,7 @@ static void _qce_aead_complete(void *cookie, unsigned char *icv,
 	else
 		pstat->aead_op_success++;
 
-	cp->res = ret;
-
-	if (cp->platform_support.ce_shared)
-		schedule_work(&cp->unlock_ce_ws);
-	tasklet_schedule(&cp->done_tasklet);
+	_qcrypto_req_finish(cp, ret);
 }
 
 static int aead_ccm_set_msg_len(u8 *block, unsigned int msglen, int csize)
@@ -1235,11 +1568,10 @@ static int qcrypto_aead_ccm_format_adata(struct qce_req *qreq, uint32_t alen,
 	return 0;
 }
 
-static int _qcrypto_process_ablkcipher(struct crypto_priv *cp,
-				struct crypto_async_request *async_req)
+static int _qcrypto_prep_ablkcipher(struct crypto_priv *cp,
+				struct crypto_async_request *async_req,
+				struct qce_req *qreq)
 {
-	struct qce_req qreq;
-	int ret;
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *cipher_ctx;
 	struct ablkcipher_request *req;
@@ -1275,27 +1607,50 @@ static int _qcrypto_process_ablkcipher(struct crypto_priv *cp,
 		req->src = &rctx->dsg;
 		req->dst = &rctx->dsg;
 	}
-	qreq.op = QCE_REQ_ABLK_CIPHER;
-	qreq.qce_cb = _qce_ablk_cipher_complete;
-	qreq.areq = req;
-	qreq.alg = rctx->alg;
-	qreq.dir = rctx->dir;
-	qreq.mode = rctx->mode;
-	qreq.enckey = cipher_ctx->enc_key;
-	qreq.encklen = cipher_ctx->enc_key_len;
-	qreq.iv = req->info;
-	qreq.ivsize = crypto_ablkcipher_ivsize(tfm);
-	qreq.cryptlen = req->nbytes;
-	qreq.use_pmem = 0;
-	qreq.flags = cipher_ctx->flags;
+	qreq->op = QCE_REQ_ABLK_CIPHER;
+	qreq->qce_cb = _qce_ablk_cipher_complete;
+	qreq->areq = req;
+	qreq->alg = rctx->alg;
+	qreq->dir = rctx->dir;
+	qreq->mode = rctx->mode;
+	qreq->enckey = cipher_ctx->enc_key;
+	qreq->encklen = cipher_ctx->enc_key_len;
+	qreq->iv = req->info;
+	qreq->ivsize = crypto_ablkcipher_ivsize(tfm);
+	qreq->cryptlen = req->nbytes;
+	qreq->use_pmem = 0;
+	qreq->flags = cipher_ctx->flags;
 
 	if ((cipher_ctx->enc_key_len == 0) &&
 			(cp->platform_support.hw_key_support == 0))
-		ret = -EINVAL;
-	else
-		ret =  qce_ablk_cipher_req(cp->qce, &qreq);
+		return -EINVAL;
+	return 0;
+}
 
-	return ret;
+static int _qcrypto_process_ablkcipher(struct crypto_priv *cp,
+				struct crypto_async_request *async_req)
+{
+	struct qce_req qreq;
+	int ret;
+
+	ret = _qcrypto_prep_ablkcipher(cp, async_req, &qreq);
+	if (ret)
+		return ret;
+	return qce_ablk_cipher_req(cp->qce, &qreq);
+}
+
+static int _qcrypto_process_ablkcipher_batch(struct crypto_priv *cp)
+{
+	struct qce_req qreq[QCE_MAX_BATCH];
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < cp->nr_slots; i++) {
+		ret = _qcrypto_prep_ablkcipher(cp, cp->slot[i].req, &qreq[i]);
+		if (ret)
+			return ret;
+	}
+	return qce_ablk_cipher_req_batch(cp->qce, qreq, cp->nr_slots);
 }
 
 static int _qcrypto_process_ahash(struct crypto_priv *cp,
@@ -1534,11 +1889,34 @@ static int _qcrypto_process_aead(struct crypto_priv *cp,
 	return ret;
 }
 
+/*
+ * Queued AES ablkcipher requests that follow one another are handed to
+ * the engine together when it takes batches, which spreads the setup and
+ * completion cost of a submission over all of them.
+ */
+static bool _qcrypto_batchable(struct crypto_priv *cp,
+				struct crypto_async_request *async_req)
+{
+	struct ablkcipher_request *req;
+	struct qcrypto_cipher_ctx *ctx;
+	struct qcrypto_cipher_req_ctx *rctx;
+
+	if (crypto_tfm_alg_type(async_req->tfm) != CRYPTO_ALG_TYPE_ABLKCIPHER)
+		return false;
+	req = ablkcipher_request_cast(async_req);
+	ctx = crypto_tfm_ctx(async_req->tfm);
+	rctx = ablkcipher_request_ctx(req);
+
+	return rctx->alg == CIPHER_ALG_AES && !ctx->flags &&
+		ctx->enc_key_len && req->nbytes <= cp->ce_support.max_batch_len;
+}
+
 static int _start_qcrypto_process(struct crypto_priv *cp)
 {
-	struct crypto_async_request *async_req = NULL;
-	struct crypto_async_request *backlog = NULL;
+	struct crypto_async_request *async_req;
+	struct crypto_async_request *backlog[QCE_MAX_BATCH];
 	unsigned long flags;
+	unsigned int i, n, max;
 	u32 type;
 	int ret = 0;
 	struct crypto_stat *pstat;
@@ -1546,47 +1924,95 @@ static int _start_qcrypto_process(struct crypto_priv *cp)
 	pstat = &_qcrypto_stat;
 
 again:
+	n = 0;
+	max = _qcrypto_max_batch(cp);
 	spin_lock_irqsave(&cp->lock, flags);
 	if (cp->req == NULL) {
-		backlog = crypto_get_backlog(&cp->queue);
+		backlog[0] = crypto_get_backlog(&cp->queue);
 		async_req = crypto_dequeue_request(&cp->queue);
 		cp->req = async_req;
+		if (async_req) {
+			cp->slot[n++].req = async_req;
+			while (n < max && _qcrypto_batchable(cp, async_req) &&
+					cp->queue.qlen &&
+					_qcrypto_batchable(cp, list_first_entry(
+						&cp->queue.list,
+						struct crypto_async_request,
+						list))) {
+				backlog[n] = crypto_get_backlog(&cp->queue);
+				cp->slot[n++].req =
+					crypto_dequeue_request(&cp->queue);
+			}
+		}
+		cp->nr_slots = n;
+		cp->nr_done = 0;
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
-	if (!async_req)
+	if (!n)
 		return ret;
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
+	for (i = 0; i < n; i++)
+		if (backlog[i])
+			backlog[i]->complete(backlog[i], -EINPROGRESS);
+	async_req = cp->slot[0].req;
 	type = crypto_tfm_alg_type(async_req->tfm);
 
-	switch (type) {
-	case CRYPTO_ALG_TYPE_ABLKCIPHER:
-		ret = _qcrypto_process_ablkcipher(cp, async_req);
-		break;
-	case CRYPTO_ALG_TYPE_AHASH:
-		ret = _qcrypto_process_ahash(cp, async_req);
-		break;
-	case CRYPTO_ALG_TYPE_AEAD:
-		ret = _qcrypto_process_aead(cp, async_req);
-		break;
-	default:
-		ret = -EINVAL;
-	};
+	cp->req_start = ktime_get();
+	for (i = 0; i < n; i++) {
+		struct crypto_async_request *r = cp->slot[i].req;
+
+		switch (type) {
+		case CRYPTO_ALG_TYPE_ABLKCIPHER:
+			cp->slot[i].len = ablkcipher_request_cast(r)->nbytes;
+			break;
+		case CRYPTO_ALG_TYPE_AHASH:
+			cp->slot[i].len = ahash_request_cast(r)->nbytes;
+			break;
+		default:
+			cp->slot[i].len = 0;
+		};
+	}
+
+	if (n > 1) {
+		ret = _qcrypto_process_ablkcipher_batch(cp);
+	} else {
+		switch (type) {
+		case CRYPTO_ALG_TYPE_ABLKCIPHER:
+			ret = _qcrypto_process_ablkcipher(cp, async_req);
+			break;
+		case CRYPTO_ALG_TYPE_AHASH:
+			ret = _qcrypto_process_ahash(cp, async_req);
+			break;
+		case CRYPTO_ALG_TYPE_AEAD:
+			ret = _qcrypto_process_aead(cp, async_req);
+			break;
+		default:
+			ret = -EINVAL;
+		};
+	}
 
 	if (ret) {
+		struct crypto_async_request *failed[QCE_MAX_BATCH];
+
 		spin_lock_irqsave(&cp->lock, flags);
+		for (i = 0; i < n; i++) {
+			failed[i] = cp->slot[i].req;
+			(*_qcrypto_hw_pending(failed[i]->tfm))--;
+		}
 		cp->req = NULL;
+		cp->nr_slots = 0;
 		spin_unlock_irqrestore(&cp->lock, flags);
 
-		if (type == CRYPTO_ALG_TYPE_ABLKCIPHER)
-			pstat->ablk_cipher_op_fail++;
-		else
-			if (type == CRYPTO_ALG_TYPE_AHASH)
-				pstat->sha_op_fail++;
+		for (i = 0; i < n; i++) {
+			if (type == CRYPTO_ALG_TYPE_ABLKCIPHER)
+				pstat->ablk_cipher_op_fail++;
 			else
-				pstat->aead_op_fail++;
+				if (type == CRYPTO_ALG_TYPE_AHASH)
+					pstat->sha_op_fail++;
+				else
+					pstat->aead_op_fail++;
 
-		async_req->complete(async_req, ret);
+			failed[i]->complete(failed[i], ret);
+		}
 		goto again;
 	};
 	return ret;
@@ -1598,6 +2024,14 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 	int ret;
 	unsigned long flags;
 
+	if (crypto_tfm_alg_type(req->tfm) == CRYPTO_ALG_TYPE_ABLKCIPHER) {
+		struct ablkcipher_request *areq = ablkcipher_request_cast(req);
+
+		if (_qcrypto_ablk_cipher_can_fallback(areq) &&
+				_qcrypto_route_sw(cp, req->tfm, areq->nbytes))
+			return _qcrypto_ablk_cipher_sw(areq);
+	}
+
 	if (cp->platform_support.ce_shared) {
 		ret = qcrypto_lock_ce(cp);
 		if (ret)
@@ -1606,6 +2040,8 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 
 	spin_lock_irqsave(&cp->lock, flags);
 	ret = crypto_enqueue_request(&cp->queue, req);
+	if (ret != -EBUSY || (req->flags & CRYPTO_TFM_REQ_MAY_BACKLOG))
+		(*_qcrypto_hw_pending(req->tfm))++;
 	spin_unlock_irqrestore(&cp->lock, flags);
 	_start_qcrypto_process(cp);
 
@@ -2744,6 +3180,10 @@ static int _sha_digest(struct ahash_request *req)
 	struct crypto_priv *cp = sha_ctx->cp;
 	int ret = 0;
 
+	if (sha_ctx->fallback && !sha_ctx->flags &&
+			_qcrypto_route_sw(cp, req->base.tfm, req->nbytes))
+		return _qcrypto_ahash_sw(req);
+
 	if (cp->ce_support.aligned_only) {
 		if (_copy_source(req))
 			return -ENOMEM;
@@ -3869,6 +4309,35 @@ static const struct file_operations _debug_stats_ops = {
 	.write =        _debug_stats_write,
 };
 
+static ssize_t _debug_route_read(struct file *file, char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	int qcrypto = *((int *) file->private_data);
+	int len;
+
+	len = _disp_route_stats(qcrypto);
+
+	return simple_read_from_buffer((void __user *) buf, len,
+			ppos, (void *) _debug_read_buf, len);
+}
+
+static ssize_t _debug_route_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&_qcrypto_route_lock, flags);
+	memset(&_qcrypto_route_stat, 0, sizeof(struct qcrypto_route_stat));
+	spin_unlock_irqrestore(&_qcrypto_route_lock, flags);
+	return count;
+};
+
+static const struct file_operations _debug_route_ops = {
+	.open =         _debug_stats_open,
+	.read =         _debug_route_read,
+	.write =        _debug_route_write,
+};
+
 static int _qcrypto_debug_init(void)
 {
 	int rc;
@@ -3892,6 +4361,16 @@ static int _qcrypto_debug_init(void)
 		rc = PTR_ERR(dent);
 		goto err;
 	}
+
+	snprintf(name, DEBUG_MAX_FNAME-1, "route-%d", 1);
+	dent = debugfs_create_file(name, 0644, _debug_dent,
+				&_debug_qcrypto, &_debug_route_ops);
+	if (dent == NULL) {
+		pr_err("qcrypto debugfs_create_file fail, error %ld\n",
+				PTR_ERR(dent));
+		rc = PTR_ERR(dent);
+		goto err;
+	}
 	return 0;
 err:
 	debugfs_remove_recursive(_debug_dent);
@@ -68,11 +68,12 @@ MODULE_ALIAS("mmc:block");
 			(req->cmd_flags & REQ_META)) && \
 			(rq_data_dir(req) == WRITE))
 #define PACKED_CMD_VER		0x01
+#define PACKED_CMD_RD		0x01
 #define PACKED_CMD_WR		0x02
 #define PACKED_TRIGGER_MAX_ELEMENTS	5000
 #define MMC_BLK_UPDATE_STOP_REASON(stats, reason)			\
 	do {								\
-		if (stats->enabled)					\
+		if (stats && stats->enabled)				\
 			stats->pack_stop_reason[reason]++;		\
 	} while (0)
 
@@ -117,6 +118,7 @@ struct mmc_blk_data {
 	struct device_attribute num_wr_reqs_to_start_packing;
 	struct device_attribute bkops_check_threshold;
 	struct device_attribute no_pack_for_random;
+	struct device_attribute queue_stats;
 	int	area_type;
 };
 
@@ -436,6 +438,53 @@ exit:
 	return ret;
 }
 
+static const char * const mmc_queue_stage_names[MMC_QUEUE_STAGE_NR] = {
+	[MMC_QUEUE_STAGE_PREP]	= "prep",
+	[MMC_QUEUE_STAGE_WAIT]	= "wait",
+	[MMC_QUEUE_STAGE_XFER]	= "xfer",
+};
+
+static ssize_t
+queue_stats_show(struct device *dev, struct device_attribute *attr,
+		 char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_queue_stats *st = &md->queue.stats;
+	int i, ret = 0;
+
+	for (i = 0; i < MMC_QUEUE_STAGE_NR; i++) {
+		struct mmc_queue_stage_stats *ss = &st->stage[i];
+
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"%s: count %lu total_us %llu avg_us %llu max_us %llu\n",
+				mmc_queue_stage_names[i], ss->count,
+				ss->total_us,
+				ss->count ? div64_u64(ss->total_us, ss->count) : 0,
+				ss->max_us);
+	}
+	ret += snprintf(buf + ret, PAGE_SIZE - ret,
+			"packed_wr: cmds %lu reqs %lu\n"
+			"packed_rd: cmds %lu reqs %lu hdr_err %lu\n",
+			st->packed_wr_cmds, st->packed_wr_reqs,
+			st->packed_rd_cmds, st->packed_rd_reqs,
+			st->packed_rd_hdr_err);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+queue_stats_store(struct device *dev, struct device_attribute *attr,
+		  const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+
+	memset(&md->queue.stats, 0, sizeof(md->queue.stats));
+
+	mmc_blk_put(md);
+	return count;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -1834,13 +1883,20 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			!card->ext_csd.packed_event_en)
 		goto no_packed;
 
-	if (!mq->wr_packing_enabled)
-		goto no_packed;
-
 	if ((rq_data_dir(cur) == WRITE) &&
-			(card->host->caps2 & MMC_CAP2_PACKED_WR))
+			(card->host->caps2 & MMC_CAP2_PACKED_WR) &&
+			mq->wr_packing_enabled)
 		max_packed_rw = card->ext_csd.max_packed_writes;
 
+	/*
+	 * The packed read header is written synchronously right before the
+	 * data phase, so only pack reads when the bus is idle.
+	 */
+	if ((rq_data_dir(cur) == READ) &&
+			(card->host->caps2 & MMC_CAP2_PACKED_RD) &&
+			!mq->mqrq_prev->req)
+		max_packed_rw = card->ext_csd.max_packed_reads;
+
 	if (max_packed_rw == 0)
 		goto no_packed;
 
@@ -1870,7 +1926,10 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		phys_segments++;
 	}
 
-	spin_lock(&stats->lock);
+	if (rq_data_dir(cur) == READ)
+		stats = NULL;
+	else
+		spin_lock(&stats->lock);
 
 	while (reqs < max_packed_rw - 1) {
 		spin_lock_irq(q->queue_lock);
@@ -1917,8 +1976,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 
 		req_sectors += blk_rq_sectors(next);
 		if (req_sectors > max_blk_count) {
-			if (stats->enabled)
-				stats->pack_stop_reason[EXCEEDS_SECTORS]++;
+			MMC_BLK_UPDATE_STOP_REASON(stats, EXCEEDS_SECTORS);
 			put_back = 1;
 			break;
 		}
@@ -1930,7 +1988,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			break;
 		}
 
-		if (mq->no_pack_for_random) {
+		if (mq->no_pack_for_random && rq_data_dir(cur) == WRITE) {
 			if ((blk_rq_pos(cur) + blk_rq_sectors(cur)) !=
 			    blk_rq_pos(next)) {
 				MMC_BLK_UPDATE_STOP_REASON(stats, RANDOM);
@@ -1956,15 +2014,16 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		spin_unlock_irq(q->queue_lock);
 	}
 
-	if (stats->enabled) {
-		if (reqs + 1 <= card->ext_csd.max_packed_writes)
-			stats->packing_events[reqs + 1]++;
-		if (reqs + 1 == max_packed_rw)
-			MMC_BLK_UPDATE_STOP_REASON(stats, THRESHOLD);
+	if (stats) {
+		if (stats->enabled) {
+			if (reqs + 1 <= card->ext_csd.max_packed_writes)
+				stats->packing_events[reqs + 1]++;
+			if (reqs + 1 == max_packed_rw)
+				MMC_BLK_UPDATE_STOP_REASON(stats, THRESHOLD);
+		}
+		spin_unlock(&stats->lock);
 	}
 
-	spin_unlock(&stats->lock);
-
 	if (reqs > 0) {
 		list_add(&req->queuelist, &mq->mqrq_cur->packed_list);
 		mq->mqrq_cur->packed_num = ++reqs;
@@ -2066,6 +2125,163 @@ static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+static void mmc_blk_packed_hdr_rrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	u32 *packed_cmd_hdr = mqrq->packed_cmd_hdr;
+	u8 i = 1;
+
+	mqrq->packed_cmd = MMC_PACKED_READ;
+	mqrq->packed_blocks = 0;
+	mqrq->packed_fail_idx = MMC_PACKED_N_IDX;
+
+	memset(packed_cmd_hdr, 0, sizeof(mqrq->packed_cmd_hdr));
+	packed_cmd_hdr[0] = (mqrq->packed_num << 16) |
+		(PACKED_CMD_RD << 8) | PACKED_CMD_VER;
+
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		packed_cmd_hdr[(i * 2)] = blk_rq_sectors(prq);
+		packed_cmd_hdr[((i * 2)) + 1] =
+			mmc_card_blockaddr(card) ?
+			blk_rq_pos(prq) : blk_rq_pos(prq) << 9;
+		mqrq->packed_blocks += blk_rq_sectors(prq);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = mqrq->packed_blocks;
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_READ_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks;
+	brq->data.flags |= MMC_DATA_READ;
+	brq->data.fault_injected = false;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.cmd_flags = req->cmd_flags;
+
+	if (mq->err_check_fn)
+		mqrq->mmc_active.err_check = mq->err_check_fn;
+	else
+		mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+
+	if (mq->packed_test_fn)
+		mq->packed_test_fn(mq->queue, mqrq);
+
+	mqrq->mmc_active.reinsert_req = mmc_blk_reinsert_req;
+	mqrq->mmc_active.update_interrupted_req =
+		mmc_blk_update_interrupted_req;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * A packed read is a CMD23/CMD25 write of the one sector header that
+ * lists the requests, followed by the CMD23/CMD18 data phase.  The core
+ * only tracks one data request per host, so the header goes out here,
+ * synchronously, while the bus is idle.
+ */
+static int mmc_blk_packed_send_rd_hdr(struct mmc_queue_req *mqrq,
+				      struct mmc_card *card)
+{
+	struct mmc_request mrq = {NULL};
+	struct mmc_command sbc = {0};
+	struct mmc_command cmd = {0};
+	struct mmc_data data = {0};
+	struct scatterlist sg;
+	u32 status;
+	int err;
+
+	sbc.opcode = MMC_SET_BLOCK_COUNT;
+	sbc.arg = MMC_CMD23_ARG_PACKED | 1;
+	sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	cmd.arg = blk_rq_pos(mqrq->req);
+	if (!mmc_card_blockaddr(card))
+		cmd.arg <<= 9;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	data.blksz = 512;
+	data.blocks = 1;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = &sg;
+	data.sg_len = 1;
+	sg_init_one(&sg, mqrq->packed_cmd_hdr, sizeof(mqrq->packed_cmd_hdr));
+	mmc_set_data_timeout(&data, card);
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+
+	mmc_wait_for_req(card->host, &mrq);
+
+	err = sbc.error ? sbc.error : cmd.error ? cmd.error : data.error;
+	if (err) {
+		pr_err("%s: packed read header failed: sbc %d cmd %d data %d\n",
+		       mmc_hostname(card->host), sbc.error, cmd.error,
+		       data.error);
+		return err;
+	}
+
+	err = get_card_status(card, &status, 5);
+	if (err)
+		return err;
+
+	if (status & (R1_ERROR | R1_CC_ERROR | R1_CARD_ECC_FAILED |
+		      R1_ADDRESS_ERROR | R1_OUT_OF_RANGE)) {
+		pr_err("%s: packed read header rejected, status %#x\n",
+		       mmc_hostname(card->host), status);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int mmc_blk_packed_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       struct mmc_queue *mq)
+{
+	int err;
+
+	if (rq_data_dir(mqrq->req) == WRITE) {
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+		return 0;
+	}
+
+	mmc_blk_packed_hdr_rrq_prep(mqrq, card, mq);
+	err = mmc_blk_packed_send_rd_hdr(mqrq, card);
+	if (err)
+		mq->stats.packed_rd_hdr_err++;
+
+	return err;
+}
+
 static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 			   struct mmc_blk_request *brq, struct request *req,
 			   int ret)
@@ -2160,6 +2376,55 @@ static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
 	mmc_blk_clear_packed(mq_rq);
 }
 
+/*
+ * Called after every mmc_start_req() of mqrq.  Only account it if the
+ * core actually put it on the bus.  The prep and wait stages and packed
+ * counts are taken only the first time: a request that is re-prepared
+ * or retried after an error is not counted again, but its transfer
+ * clock restarts.
+ */
+static void mmc_blk_stats_issued(struct mmc_queue *mq,
+				 struct mmc_queue_req *mqrq)
+{
+	ktime_t now;
+
+	if (mq->card->host->areq != &mqrq->mmc_active)
+		return;
+
+	now = ktime_get();
+	mqrq->issued = now;
+	if (!ktime_to_ns(mqrq->prep_start))
+		return;
+
+	mmc_queue_stage_add(mq, MMC_QUEUE_STAGE_PREP, mqrq->prep_start,
+			    mqrq->prep_done);
+	mmc_queue_stage_add(mq, MMC_QUEUE_STAGE_WAIT, mqrq->prep_done, now);
+	mqrq->prep_start = ktime_set(0, 0);
+
+	if (mqrq->packed_cmd == MMC_PACKED_WRITE) {
+		mq->stats.packed_wr_cmds++;
+		mq->stats.packed_wr_reqs += mqrq->packed_num;
+	} else if (mqrq->packed_cmd == MMC_PACKED_READ) {
+		mq->stats.packed_rd_cmds++;
+		mq->stats.packed_rd_reqs += mqrq->packed_num;
+	}
+}
+
+/*
+ * Account the transfer of mqrq since its last issue.  Retries reissue
+ * through mmc_blk_stats_issued() and so restart the clock.
+ */
+static void mmc_blk_stats_done(struct mmc_queue *mq,
+			       struct mmc_queue_req *mqrq)
+{
+	if (!ktime_to_ns(mqrq->issued))
+		return;
+
+	mmc_queue_stage_add(mq, MMC_QUEUE_STAGE_XFER, mqrq->issued,
+			    ktime_get());
+	mqrq->issued = ktime_set(0, 0);
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -2178,6 +2443,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		return 0;
 
 	if (rqc) {
+		mq->mqrq_cur->prep_start = ktime_get();
 		if ((card->ext_csd.bkops_en) && (rq_data_dir(rqc) == WRITE))
 			card->bkops_info.sectors_changed += blk_rq_sectors(rqc);
 		reqs = mmc_blk_prep_packed_list(mq, rqc);
@@ -2185,15 +2451,20 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 
 	do {
 		if (rqc) {
-			if (reqs >= packed_num)
-				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
-						card, mq);
-			else
+			if (reqs >= packed_num &&
+			    mmc_blk_packed_prep(mq->mqrq_cur, card, mq)) {
+				mmc_blk_revert_packed_req(mq, mq->mqrq_cur);
+				reqs = 0;
+			}
+			if (reqs < packed_num)
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			mq->mqrq_cur->prep_done = ktime_get();
 			areq = &mq->mqrq_cur->mmc_active;
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (rqc)
+			mmc_blk_stats_issued(mq, mq->mqrq_cur);
 		if (!areq) {
 			if (status == MMC_BLK_NEW_REQUEST)
 				mq->flags |= MMC_QUEUE_NEW_REQUEST;
@@ -2204,6 +2475,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		brq = &mq_rq->brq;
 		req = mq_rq->req;
 		type = rq_data_dir(req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
+		mmc_blk_stats_done(mq, mq_rq);
 		mmc_queue_bounce_post(mq_rq);
 
 		switch (status) {
@@ -2304,12 +2576,15 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 						disable_multi, mq);
 				mmc_start_req(card->host,
 						&mq_rq->mmc_active, NULL);
+				mmc_blk_stats_issued(mq, mq_rq);
 			} else {
 				if (!mq_rq->packed_retries)
 					goto cmd_abort;
-				mmc_blk_packed_hdr_wrq_prep(mq_rq, card, mq);
+				if (mmc_blk_packed_prep(mq_rq, card, mq))
+					goto cmd_abort;
 				mmc_start_req(card->host,
 						&mq_rq->mmc_active, NULL);
+				mmc_blk_stats_issued(mq, mq_rq);
 			}
 		}
 	} while (ret);
@@ -2345,6 +2620,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			mmc_start_req(card->host,
 					&mq->mqrq_cur->mmc_active,
 					NULL);
+			mmc_blk_stats_issued(mq, mq->mqrq_cur);
 		}
 	}
 
@@ -2369,6 +2645,7 @@ static int sd_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		return 0;
 
 	if (rqc) {
+		mq->mqrq_cur->prep_start = ktime_get();
 		if ((card->ext_csd.bkops_en) && (rq_data_dir(rqc) == WRITE))
 			card->bkops_info.sectors_changed += blk_rq_sectors(rqc);
 		reqs = mmc_blk_prep_packed_list(mq, rqc);
@@ -2376,15 +2653,20 @@ static int sd_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 
 	do {
 		if (rqc) {
-			if (reqs >= packed_num)
-				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
-						card, mq);
-			else
+			if (reqs >= packed_num &&
+			    mmc_blk_packed_prep(mq->mqrq_cur, card, mq)) {
+				mmc_blk_revert_packed_req(mq, mq->mqrq_cur);
+				reqs = 0;
+			}
+			if (reqs < packed_num)
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			mq->mqrq_cur->prep_done = ktime_get();
 			areq = &mq->mqrq_cur->mmc_active;
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (rqc)
+			mmc_blk_stats_issued(mq, mq->mqrq_cur);
 		if (!areq) {
 			if (status == MMC_BLK_NEW_REQUEST)
 				mq->flags |= MMC_QUEUE_NEW_REQUEST;
@@ -2395,6 +2677,7 @@ static int sd_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		brq = &mq_rq->brq;
 		req = mq_rq->req;
 		type = rq_data_dir(req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
+		mmc_blk_stats_done(mq, mq_rq);
 		mmc_queue_bounce_post(mq_rq);
 
 		switch (status) {
@@ -2487,12 +2770,15 @@ static int sd_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 						disable_multi, mq);
 				mmc_start_req(card->host,
 						&mq_rq->mmc_active, NULL);
+				mmc_blk_stats_issued(mq, mq_rq);
 			} else {
 				if (!mq_rq->packed_retries)
 					goto cmd_abort;
-				mmc_blk_packed_hdr_wrq_prep(mq_rq, card, mq);
+				if (mmc_blk_packed_prep(mq_rq, card, mq))
+					goto cmd_abort;
 				mmc_start_req(card->host,
 						&mq_rq->mmc_active, NULL);
+				mmc_blk_stats_issued(mq, mq_rq);
 			}
 		}
 recovery:
@@ -2509,6 +2795,7 @@ recovery:
 			if (!err) {
 				mmc_blk_rw_rq_prep(mq_rq, card, 0, mq);
 				mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+				mmc_blk_stats_issued(mq, mq_rq);
 			} else {
 				printk(KERN_INFO "%s: reinit failed : %d, remove card\n",
 					mmc_hostname(card->host), err);
@@ -2556,6 +2843,7 @@ recovery:
 			mmc_start_req(card->host,
 					&mq->mqrq_cur->mmc_active,
 					NULL);
+			mmc_blk_stats_issued(mq, mq->mqrq_cur);
 		}
 	}
 
@@ -2916,6 +3204,7 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		card = md->queue.card;
 		device_remove_file(disk_to_dev(md->disk),
 				   &md->num_wr_reqs_to_start_packing);
+		device_remove_file(disk_to_dev(md->disk), &md->queue_stats);
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
@@ -3016,8 +3305,19 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto no_pack_for_random_fails;
 
+	md->queue_stats.show = queue_stats_show;
+	md->queue_stats.store = queue_stats_store;
+	sysfs_attr_init(&md->queue_stats.attr);
+	md->queue_stats.attr.name = "queue_stats";
+	md->queue_stats.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk), &md->queue_stats);
+	if (ret)
+		goto queue_stats_fails;
+
 	return ret;
 
+queue_stats_fails:
+	device_remove_file(disk_to_dev(md->disk), &md->no_pack_for_random);
 no_pack_for_random_fails:
 	device_remove_file(disk_to_dev(md->disk),
 			   &md->bkops_check_threshold);
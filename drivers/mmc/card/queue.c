@@ -593,3 +593,18 @@ void mmc_queue_bounce_post(struct mmc_queue_req *mqrq)
 	sg_copy_from_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
 		mqrq->bounce_buf, mqrq->sg[0].length);
 }
+
+void mmc_queue_stage_add(struct mmc_queue *mq, enum mmc_queue_stage stage,
+			 ktime_t start, ktime_t end)
+{
+	struct mmc_queue_stage_stats *st = &mq->stats.stage[stage];
+	s64 us = ktime_us_delta(end, start);
+
+	if (us < 0)
+		return;
+
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+}
@@ -15,6 +15,7 @@ struct mmc_blk_request {
 enum mmc_packed_cmd {
 	MMC_PACKED_NONE = 0,
 	MMC_PACKED_WRITE,
+	MMC_PACKED_READ,
 };
 
 struct mmc_queue_req {
@@ -32,6 +33,31 @@ struct mmc_queue_req {
 	int		packed_retries;
 	int		packed_fail_idx;
 	u8		packed_num;
+	ktime_t		prep_start;
+	ktime_t		prep_done;
+	ktime_t		issued;
+};
+
+enum mmc_queue_stage {
+	MMC_QUEUE_STAGE_PREP,
+	MMC_QUEUE_STAGE_WAIT,
+	MMC_QUEUE_STAGE_XFER,
+	MMC_QUEUE_STAGE_NR,
+};
+
+struct mmc_queue_stage_stats {
+	unsigned long		count;
+	u64			total_us;
+	u64			max_us;
+};
+
+struct mmc_queue_stats {
+	struct mmc_queue_stage_stats	stage[MMC_QUEUE_STAGE_NR];
+	unsigned long		packed_rd_cmds;
+	unsigned long		packed_rd_reqs;
+	unsigned long		packed_rd_hdr_err;
+	unsigned long		packed_wr_cmds;
+	unsigned long		packed_wr_reqs;
 };
 
 struct mmc_queue {
@@ -53,6 +79,7 @@ struct mmc_queue {
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
 	bool			no_pack_for_random;
+	struct mmc_queue_stats	stats;
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
 };
@@ -67,6 +94,8 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 				     struct mmc_queue_req *);
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
 extern void mmc_queue_bounce_post(struct mmc_queue_req *);
+extern void mmc_queue_stage_add(struct mmc_queue *, enum mmc_queue_stage,
+				ktime_t, ktime_t);
 
 extern void print_mmc_packing_stats(struct mmc_card *card);
 extern int mmc_reinit_card(struct mmc_host *host);
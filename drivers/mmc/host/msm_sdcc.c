@@ -5142,6 +5142,8 @@ static struct mmc_platform_data *msmsdcc_populate_pdata(struct device *dev)
 		pdata->nonremovable = true;
 	if (of_get_property(np, "qcom,disable-cmd23", NULL))
 		pdata->disable_cmd23 = true;
+	if (of_get_property(np, "qcom,packed-read", NULL))
+		pdata->uhs_caps2 |= MMC_CAP2_PACKED_RD;
 	of_property_read_u32(np, "qcom,dat1-mpm-int",
 					&pdata->mpm_sdiowakeup_int);
 
@@ -1493,6 +1493,9 @@ static struct sdhci_msm_pltfm_data *sdhci_msm_populate_pdata(struct device *dev)
 		pdata->caps2 |= MMC_CAP2_PACKED_WR_CONTROL;
 	}
 
+	if (of_get_property(np, "htc,packed_rd_support", NULL))
+		pdata->caps2 |= MMC_CAP2_PACKED_RD;
+
 	if (of_get_property(np, "htc,pon_support", NULL))
 		pdata->caps2 |= MMC_CAP2_POWEROFF_NOTIFY;
 
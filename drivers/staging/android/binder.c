@@ -35,6 +35,7 @@
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
 #include <linux/security.h>
+#include <linux/cpu_boost.h>
 
 #include "binder.h"
 
@@ -1497,7 +1498,9 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	e->to_proc = target_proc->pid;
 
-	
+	if (!reply)
+		cpu_boost_binder_transaction(target_proc->tsk);
+
 	t = kzalloc(sizeof(*t), GFP_KERNEL);
 	if (t == NULL) {
 		return_error = BR_FAILED_REPLY;
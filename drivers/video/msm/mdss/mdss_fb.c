@@ -1378,6 +1378,15 @@ static void mdss_fb_pan_idle(struct msm_fb_data_type *mfd)
 	}
 }
 
+static void mdss_fb_notify_frame_commit(struct fb_info *info)
+{
+	struct fb_event event;
+
+	event.info = info;
+	event.data = NULL;
+	fb_notifier_call_chain(FB_EVENT_FRAME_COMMIT, &event);
+}
+
 static int mdss_fb_pan_display_ex(struct fb_info *info,
 		struct mdp_display_commit *disp_commit)
 {
@@ -1420,6 +1429,7 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 	mfd->is_committing = 1;
 	schedule_work(&mfd->commit_work);
 	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
+	mdss_fb_notify_frame_commit(info);
 	if (wait_for_finish)
 		mdss_fb_pan_idle(mfd);
 	return ret;
@@ -260,8 +260,9 @@ err_out:
 			block_group, bitmap_blk);
 	return 0;
 }
-struct buffer_head *
-ext4_read_block_bitmap_nowait(struct super_block *sb, ext4_group_t block_group)
+static struct buffer_head *
+__ext4_read_block_bitmap_nowait(struct super_block *sb,
+				ext4_group_t block_group, int *submitted)
 {
 	struct ext4_group_desc *desc;
 	struct buffer_head *bh;
@@ -307,9 +308,32 @@ ext4_read_block_bitmap_nowait(struct super_block *sb, ext4_group_t block_group)
 	bh->b_end_io = ext4_end_bitmap_read;
 	get_bh(bh);
 	submit_bh(READ, bh);
+	if (submitted)
+		*submitted = 1;
 	return bh;
 }
 
+struct buffer_head *
+ext4_read_block_bitmap_nowait(struct super_block *sb, ext4_group_t block_group)
+{
+	return __ext4_read_block_bitmap_nowait(sb, block_group, NULL);
+}
+
+/*
+ * Starts reading the block bitmap of @block_group if it is not in memory
+ * yet.  Returns 1 if this call submitted the read.
+ */
+int ext4_prefetch_block_bitmap(struct super_block *sb,
+			       ext4_group_t block_group)
+{
+	struct buffer_head *bh;
+	int submitted = 0;
+
+	bh = __ext4_read_block_bitmap_nowait(sb, block_group, &submitted);
+	brelse(bh);
+	return submitted;
+}
+
 int ext4_wait_block_bitmap(struct super_block *sb, ext4_group_t block_group,
 			   struct buffer_head *bh)
 {
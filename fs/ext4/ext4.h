@@ -701,6 +701,7 @@ struct ext4_inode_info {
 
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+	tid_t i_attr_sync_tid;
 };
 
 #define	EXT4_VALID_FS			0x0001	
@@ -735,6 +736,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 
+#define EXT4_MOUNT_FAST_FSYNC		0x2000000 
 #define EXT4_MOUNT_MBLK_IO_SUBMIT	0x4000000 
 #define EXT4_MOUNT_DELALLOC		0x8000000 
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 
@@ -875,6 +877,12 @@ struct ext4_super_block {
 #define EXT4_MF_MNTDIR_SAMPLED	0x0001
 #define EXT4_MF_FS_ABORTED	0x0002	
 
+enum {
+	EXT4_FSYNC_FAST,		/* nothing left to commit */
+	EXT4_FSYNC_COMMIT,		/* had to wait for a journal commit */
+	EXT4_FSYNC_NR,
+};
+
 struct ext4_sb_info {
 	unsigned long s_desc_size;	
 	unsigned long s_inodes_per_block;
@@ -965,9 +973,9 @@ struct ext4_sb_info {
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
 	unsigned int s_max_writeback_mb_bump;
+	unsigned int s_mb_prefetch;
 	
-	unsigned long s_mb_last_group;
-	unsigned long s_mb_last_start;
+	struct ext4_mb_cpu __percpu *s_mb_cpu;
 
 	
 	atomic_t s_bal_reqs;	
@@ -986,6 +994,12 @@ struct ext4_sb_info {
 	atomic_t s_lock_busy;
 
 	
+	spinlock_t s_fsync_lock;
+	unsigned long s_fsync_count[EXT4_FSYNC_NR];
+	u64 s_fsync_ns[EXT4_FSYNC_NR];
+	u64 s_fsync_max_ns[EXT4_FSYNC_NR];
+
+	
 	struct ext4_locality_group __percpu *s_locality_groups;
 
 	
@@ -1457,6 +1471,8 @@ extern int ext4_should_retry_alloc(struct super_block *sb, int *retries);
 
 extern struct buffer_head *ext4_read_block_bitmap_nowait(struct super_block *sb,
 						ext4_group_t block_group);
+extern int ext4_prefetch_block_bitmap(struct super_block *sb,
+				      ext4_group_t block_group);
 extern int ext4_wait_block_bitmap(struct super_block *sb,
 				  ext4_group_t block_group,
 				  struct buffer_head *bh);
@@ -1488,6 +1504,7 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 extern int ext4_flush_completed_IO(struct inode *);
+extern const struct file_operations ext4_seq_fsync_stats_fops;
 
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -1826,6 +1843,17 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 	}
 }
 
+static inline int ext4_trylock_group(struct super_block *sb,
+				     ext4_group_t group)
+{
+	if (spin_trylock(ext4_group_lock_ptr(sb, group))) {
+		atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, -1, 0);
+		return 1;
+	}
+	atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, 1, EXT4_MAX_CONTENTION);
+	return 0;
+}
+
 static inline void ext4_unlock_group(struct super_block *sb,
 					ext4_group_t group)
 {
@@ -250,6 +250,17 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 	}
 }
 
+/*
+ * Mode, ownership, link count and xattr changes, which fdatasync may
+ * skip but a fast_fsync fsync must still commit.
+ */
+static inline void ext4_update_inode_attr_trans(handle_t *handle,
+						struct inode *inode)
+{
+	if (ext4_handle_valid(handle))
+		EXT4_I(inode)->i_attr_sync_tid = handle->h_transaction->t_tid;
+}
+
 int ext4_force_commit(struct super_block *sb);
 
 #define EXT4_INODE_JOURNAL_DATA_MODE	0x01 
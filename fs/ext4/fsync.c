@@ -24,10 +24,13 @@
 
 #include <linux/time.h>
 #include <linux/fs.h>
+#include <linux/module.h>
 #include <linux/sched.h>
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -165,6 +168,29 @@ static int ext4_sync_parent(struct inode *inode)
 	return ret;
 }
 
+static bool ext4_fsync_committed(journal_t *journal, tid_t tid)
+{
+	bool ret;
+
+	read_lock(&journal->j_state_lock);
+	ret = tid_geq(journal->j_commit_sequence, tid);
+	read_unlock(&journal->j_state_lock);
+	return ret;
+}
+
+static void ext4_fsync_account(struct super_block *sb, int kind, ktime_t start)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&sbi->s_fsync_lock);
+	sbi->s_fsync_count[kind]++;
+	sbi->s_fsync_ns[kind] += ns;
+	if (ns > sbi->s_fsync_max_ns[kind])
+		sbi->s_fsync_max_ns[kind] = ns;
+	spin_unlock(&sbi->s_fsync_lock);
+}
+
 static int __sync_inode(struct inode *inode, int datasync)
 {
 	int err;
@@ -191,6 +217,8 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	int ret;
 	tid_t commit_tid;
 	bool needs_barrier = false;
+	ktime_t fsync_start = ktime_get();
+	int kind;
 
 	J_ASSERT(ext4_journal_current_handle() == NULL);
 
@@ -220,7 +248,26 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		goto out;
 	}
 
-	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+	/*
+	 * With fast_fsync, an fsync of a regular file whose blocks, size,
+	 * mode, ownership, link count, flags and xattrs are already
+	 * committed only flushes the data, like fdatasync.  Timestamp
+	 * updates still in the running transaction go out with the next
+	 * regular commit.  Directory entries are not tracked by either
+	 * tid, so directories always take the full commit.
+	 */
+	if (datasync) {
+		commit_tid = ei->i_datasync_tid;
+	} else if (test_opt(inode->i_sb, FAST_FSYNC) &&
+		   S_ISREG(inode->i_mode)) {
+		commit_tid = ei->i_datasync_tid;
+		if (tid_gt(ei->i_attr_sync_tid, commit_tid))
+			commit_tid = ei->i_attr_sync_tid;
+	} else {
+		commit_tid = ei->i_sync_tid;
+	}
+	kind = ext4_fsync_committed(journal, commit_tid) ?
+		EXT4_FSYNC_FAST : EXT4_FSYNC_COMMIT;
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
@@ -228,8 +275,46 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	ret = jbd2_log_wait_commit(journal, commit_tid);
 	if (needs_barrier)
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
+	ext4_fsync_account(inode->i_sb, kind, fsync_start);
  out:
 	mutex_unlock(&inode->i_mutex);
 	trace_ext4_sync_file_exit(inode, ret);
 	return ret;
 }
+
+static int ext4_fsync_stats_show(struct seq_file *seq, void *v)
+{
+	static const char *names[EXT4_FSYNC_NR] = { "fast", "commit" };
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned long count[EXT4_FSYNC_NR];
+	u64 ns[EXT4_FSYNC_NR], max_ns[EXT4_FSYNC_NR];
+	int i;
+
+	spin_lock(&sbi->s_fsync_lock);
+	memcpy(count, sbi->s_fsync_count, sizeof(count));
+	memcpy(ns, sbi->s_fsync_ns, sizeof(ns));
+	memcpy(max_ns, sbi->s_fsync_max_ns, sizeof(max_ns));
+	spin_unlock(&sbi->s_fsync_lock);
+
+	seq_printf(seq, "fast_fsync: %s\n",
+		   test_opt(sb, FAST_FSYNC) ? "on" : "off");
+	for (i = 0; i < EXT4_FSYNC_NR; i++)
+		seq_printf(seq, "%s: %lu avg_ns %llu max_ns %llu\n", names[i],
+			   count[i], count[i] ? div64_u64(ns[i], count[i]) : 0,
+			   max_ns[i]);
+	return 0;
+}
+
+static int ext4_fsync_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_fsync_stats_show, PDE(inode)->data);
+}
+
+const struct file_operations ext4_seq_fsync_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_fsync_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
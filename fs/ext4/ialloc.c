@@ -731,6 +731,7 @@ got:
 	if (ext4_handle_valid(handle)) {
 		ei->i_sync_tid = handle->h_transaction->t_tid;
 		ei->i_datasync_tid = handle->h_transaction->t_tid;
+		ei->i_attr_sync_tid = handle->h_transaction->t_tid;
 	}
 
 	err = ext4_mark_inode_dirty(handle, inode);
@@ -2838,6 +2838,7 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		ei->i_attr_sync_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
@@ -2975,10 +2976,22 @@ static int ext4_do_update_inode(handle_t *handle,
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	struct buffer_head *bh = iloc->bh;
 	int err = 0, rc, block;
+	int need_datasync = 0;
+	__le16 old_attr[6];
+	__le32 old_acl, old_flags;
 
 	if (ext4_test_inode_state(inode, EXT4_STATE_NEW))
 		memset(raw_inode, 0, EXT4_SB(inode->i_sb)->s_inode_size);
 
+	old_attr[0] = raw_inode->i_mode;
+	old_attr[1] = raw_inode->i_links_count;
+	old_attr[2] = raw_inode->i_uid_low;
+	old_attr[3] = raw_inode->i_gid_low;
+	old_attr[4] = raw_inode->i_uid_high;
+	old_attr[5] = raw_inode->i_gid_high;
+	old_acl = raw_inode->i_file_acl_lo;
+	old_flags = raw_inode->i_flags;
+
 	ext4_get_inode_flags(ei);
 	raw_inode->i_mode = cpu_to_le16(inode->i_mode);
 	if (!(test_opt(inode->i_sb, NO_UID32))) {
@@ -3017,7 +3030,10 @@ static int ext4_do_update_inode(handle_t *handle,
 		raw_inode->i_file_acl_high =
 			cpu_to_le16(ei->i_file_acl >> 32);
 	raw_inode->i_file_acl_lo = cpu_to_le32(ei->i_file_acl);
-	ext4_isize_set(raw_inode, ei->i_disksize);
+	if (ei->i_disksize != ext4_isize(raw_inode)) {
+		ext4_isize_set(raw_inode, ei->i_disksize);
+		need_datasync = 1;
+	}
 	if (ei->i_disksize > 0x7fffffffULL) {
 		struct super_block *sb = inode->i_sb;
 		if (!EXT4_HAS_RO_COMPAT_FEATURE(sb,
@@ -3065,7 +3081,16 @@ static int ext4_do_update_inode(handle_t *handle,
 		err = rc;
 	ext4_clear_inode_state(inode, EXT4_STATE_NEW);
 
-	ext4_update_inode_fsync_trans(handle, inode, 0);
+	ext4_update_inode_fsync_trans(handle, inode, need_datasync);
+	if (old_attr[0] != raw_inode->i_mode ||
+	    old_attr[1] != raw_inode->i_links_count ||
+	    old_attr[2] != raw_inode->i_uid_low ||
+	    old_attr[3] != raw_inode->i_gid_low ||
+	    old_attr[4] != raw_inode->i_uid_high ||
+	    old_attr[5] != raw_inode->i_gid_high ||
+	    old_acl != raw_inode->i_file_acl_lo ||
+	    old_flags != raw_inode->i_flags)
+		ext4_update_inode_attr_trans(handle, inode);
 out_brelse:
 	brelse(bh);
 	ext4_std_error(inode->i_sb, err);
@@ -1063,10 +1063,11 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_cpu *mc = get_cpu_ptr(sbi->s_mb_cpu);
+
+		mc->mc_last_group = ac->ac_f_ex.fe_group;
+		mc->mc_last_start = ac->ac_f_ex.fe_start;
+		put_cpu_ptr(sbi->s_mb_cpu);
 	}
 }
 
@@ -1399,10 +1400,68 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Start reading the block bitmaps of the nr groups following group that
+ * still need their buddy built, so that the scan does not stall on each
+ * of them in turn.  Returns the group after the prefetched window.
+ */
+static ext4_group_t ext4_mb_prefetch(struct super_block *sb,
+				     ext4_group_t group, ext4_group_t ngroups,
+				     unsigned int nr, unsigned int *prefetched)
+{
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	while (nr-- > 0) {
+		struct ext4_group_info *grp = ext4_get_group_info(sb, group);
+		struct ext4_group_desc *gdp;
+
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (gdp && EXT4_MB_GRP_NEED_INIT(grp) &&
+		    !(gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) &&
+		    ext4_free_group_clusters(sb, gdp) > 0)
+			*prefetched += ext4_prefetch_block_bitmap(sb, group);
+		if (++group >= ngroups)
+			group = 0;
+	}
+	blk_finish_plug(&plug);
+	return group;
+}
+
+static void ext4_mb_note_alloc(struct ext4_allocation_context *ac,
+			       ktime_t start, unsigned int lock_skips,
+			       unsigned int prefetched)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned int us = div_u64(ns, NSEC_PER_USEC);
+	struct ext4_mb_cpu *mc;
+	int bucket = 0;
+
+	/* buckets are <16us, <64us, <256us, ... , >=64ms */
+	if (us >= 16)
+		bucket = min((ilog2(us) - 4) / 2 + 1, MB_LAT_BUCKETS - 1);
+
+	mc = get_cpu_ptr(sbi->s_mb_cpu);
+	mc->mc_allocs++;
+	mc->mc_groups_scanned += ac->ac_groups_scanned;
+	if (ac->ac_status == AC_STATUS_FOUND && ac->ac_groups_scanned)
+		mc->mc_cr_hits[ac->ac_criteria]++;
+	mc->mc_lock_skips += lock_skips;
+	mc->mc_prefetched += prefetched;
+	mc->mc_alloc_ns += ns;
+	if (ns > mc->mc_alloc_max_ns)
+		mc->mc_alloc_max_ns = ns;
+	mc->mc_lat_hist[bucket]++;
+	put_cpu_ptr(sbi->s_mb_cpu);
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
-	ext4_group_t ngroups, group, i;
+	ext4_group_t ngroups, group, i, prefetch_grp;
+	unsigned int lock_skips = 0, prefetched = 0;
+	ktime_t start = ktime_get();
 	int cr;
 	int err = 0;
 	struct ext4_sb_info *sbi;
@@ -1435,11 +1494,15 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 
 	
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_cpu *mc = get_cpu_ptr(sbi->s_mb_cpu);
+
+		ac->ac_g_ex.fe_group = mc->mc_last_group;
+		ac->ac_g_ex.fe_start = mc->mc_last_start;
+		put_cpu_ptr(sbi->s_mb_cpu);
+		if (ac->ac_g_ex.fe_group >= ngroups) {
+			ac->ac_g_ex.fe_group = 0;
+			ac->ac_g_ex.fe_start = 0;
+		}
 	}
 
 	
@@ -1448,11 +1511,16 @@ repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
 		ac->ac_criteria = cr;
 		group = ac->ac_g_ex.fe_group;
+		prefetch_grp = group;
 
 		for (i = 0; i < ngroups; group++, i++) {
 			if (group == ngroups)
 				group = 0;
 
+			if (sbi->s_mb_prefetch && group == prefetch_grp)
+				prefetch_grp = ext4_mb_prefetch(sb, group, ngroups,
+						sbi->s_mb_prefetch, &prefetched);
+
 			
 			if (!ext4_mb_good_group(ac, group, cr))
 				continue;
@@ -1461,7 +1529,18 @@ repeat:
 			if (err)
 				goto out;
 
-			ext4_lock_group(sb, group);
+			/*
+			 * Until the last pass, move on rather than queue up
+			 * behind another writer scanning the same group.
+			 */
+			if (cr < 3) {
+				if (!ext4_trylock_group(sb, group)) {
+					ext4_mb_unload_buddy(&e4b);
+					lock_skips++;
+					continue;
+				}
+			} else
+				ext4_lock_group(sb, group);
 
 			if (!ext4_mb_good_group(ac, group, cr)) {
 				ext4_unlock_group(sb, group);
@@ -1502,6 +1581,7 @@ repeat:
 		}
 	}
 out:
+	ext4_mb_note_alloc(ac, start, lock_skips, prefetched);
 	return err;
 }
 
@@ -1604,6 +1684,63 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_alloc_stats_show(struct seq_file *seq, void *v)
+{
+	static const char *lat_names[MB_LAT_BUCKETS] = {
+		"<16us", "<64us", "<256us", "<1ms",
+		"<4ms", "<16ms", "<64ms", ">=64ms",
+	};
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_mb_cpu sum;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct ext4_mb_cpu *mc = per_cpu_ptr(sbi->s_mb_cpu, cpu);
+
+		sum.mc_allocs += mc->mc_allocs;
+		sum.mc_groups_scanned += mc->mc_groups_scanned;
+		for (i = 0; i < 4; i++)
+			sum.mc_cr_hits[i] += mc->mc_cr_hits[i];
+		sum.mc_lock_skips += mc->mc_lock_skips;
+		sum.mc_prefetched += mc->mc_prefetched;
+		sum.mc_alloc_ns += mc->mc_alloc_ns;
+		sum.mc_alloc_max_ns = max(sum.mc_alloc_max_ns,
+					  mc->mc_alloc_max_ns);
+		for (i = 0; i < MB_LAT_BUCKETS; i++)
+			sum.mc_lat_hist[i] += mc->mc_lat_hist[i];
+	}
+
+	seq_printf(seq, "allocs: %lu\n", sum.mc_allocs);
+	seq_printf(seq, "groups_scanned: %lu\n", sum.mc_groups_scanned);
+	seq_printf(seq, "cr_hits: %lu %lu %lu %lu\n", sum.mc_cr_hits[0],
+		   sum.mc_cr_hits[1], sum.mc_cr_hits[2], sum.mc_cr_hits[3]);
+	seq_printf(seq, "lock_skips: %lu\n", sum.mc_lock_skips);
+	seq_printf(seq, "bitmaps_prefetched: %lu\n", sum.mc_prefetched);
+	seq_printf(seq, "avg_ns: %llu\n", sum.mc_allocs ?
+		   div64_u64(sum.mc_alloc_ns, sum.mc_allocs) : 0);
+	seq_printf(seq, "max_ns: %llu\n", sum.mc_alloc_max_ns);
+	seq_printf(seq, "latency:");
+	for (i = 0; i < MB_LAT_BUCKETS; i++)
+		seq_printf(seq, " %s=%lu", lat_names[i], sum.mc_lat_hist[i]);
+	seq_printf(seq, "\n");
+	return 0;
+}
+
+static int ext4_mb_seq_alloc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_alloc_stats_show, PDE(inode)->data);
+}
+
+static const struct file_operations ext4_mb_seq_alloc_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_alloc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -1854,10 +1991,25 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 			sbi->s_mb_group_prealloc, sbi->s_stripe);
 	}
 
+	sbi->s_mb_prefetch = min_t(unsigned int, MB_DEFAULT_PREFETCH,
+				   sbi->s_groups_count);
+
+	sbi->s_mb_cpu = alloc_percpu(struct ext4_mb_cpu);
+	if (sbi->s_mb_cpu == NULL) {
+		ret = -ENOMEM;
+		goto out_free_groupinfo_slab;
+	}
+	for_each_possible_cpu(i) {
+		struct ext4_mb_cpu *mc = per_cpu_ptr(sbi->s_mb_cpu, i);
+
+		mc->mc_last_group = div_u64((u64)ext4_get_groups_count(sb) * i,
+					    nr_cpu_ids);
+	}
+
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
 		ret = -ENOMEM;
-		goto out_free_groupinfo_slab;
+		goto out_free_mb_cpu;
 	}
 	for_each_possible_cpu(i) {
 		struct ext4_locality_group *lg;
@@ -1873,15 +2025,21 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	if (ret != 0)
 		goto out_free_locality_groups;
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_alloc_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_alloc_stats_fops, sb);
+	}
 
 	return 0;
 
 out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
+out_free_mb_cpu:
+	free_percpu(sbi->s_mb_cpu);
+	sbi->s_mb_cpu = NULL;
 out_free_groupinfo_slab:
 	ext4_groupinfo_destroy_slabs();
 out:
@@ -1965,8 +2123,11 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		remove_proc_entry("mb_groups", sbi->s_proc);
+		remove_proc_entry("mb_alloc_stats", sbi->s_proc);
+	}
+	free_percpu(sbi->s_mb_cpu);
 
 	return 0;
 }
@@ -58,6 +58,10 @@ extern u8 mb_enable_debug;
 
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+#define MB_DEFAULT_PREFETCH		4
+
+#define MB_LAT_BUCKETS			8
+
 
 struct ext4_free_data {
 	
@@ -120,6 +124,25 @@ struct ext4_locality_group {
 	spinlock_t		lg_prealloc_lock;
 };
 
+/*
+ * Per-cpu allocator state: the stream allocation goal, so that concurrent
+ * writers on different cpus start scanning from different groups, and the
+ * counters behind /proc/fs/ext4/<dev>/mb_alloc_stats.
+ */
+struct ext4_mb_cpu {
+	ext4_group_t		mc_last_group;
+	ext4_grpblk_t		mc_last_start;
+
+	unsigned long		mc_allocs;
+	unsigned long		mc_groups_scanned;
+	unsigned long		mc_cr_hits[4];
+	unsigned long		mc_lock_skips;
+	unsigned long		mc_prefetched;
+	u64			mc_alloc_ns;
+	u64			mc_alloc_max_ns;
+	unsigned long		mc_lat_hist[MB_LAT_BUCKETS];
+};
+
 struct ext4_allocation_context {
 	struct inode *ac_inode;
 	struct super_block *ac_sb;
@@ -809,6 +809,7 @@ static void ext4_put_super(struct super_block *sb)
 
 	if (sbi->s_proc) {
 		remove_proc_entry("options", sbi->s_proc);
+		remove_proc_entry("fsync_stats", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 	kobject_del(&sbi->s_kobj);
@@ -876,6 +877,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->cur_aio_dio = NULL;
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_attr_sync_tid = 0;
 	atomic_set(&ei->i_ioend_count, 0);
 	atomic_set(&ei->i_aiodio_unwritten, 0);
 
@@ -1107,6 +1109,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_fast_fsync, Opt_nofast_fsync,
 };
 
 static const match_table_t tokens = {
@@ -1180,6 +1183,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
+	{Opt_fast_fsync, "fast_fsync"},
+	{Opt_nofast_fsync, "nofast_fsync"},
 	{Opt_removed, "check=none"},	
 	{Opt_removed, "nocheck"},	
 	{Opt_removed, "reservation"},	
@@ -1317,6 +1322,8 @@ static const struct mount_opts {
 	{Opt_noauto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_SET},
 	{Opt_auto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_CLEAR},
 	{Opt_noinit_itable, EXT4_MOUNT_INIT_INODE_TABLE, MOPT_CLEAR},
+	{Opt_fast_fsync, EXT4_MOUNT_FAST_FSYNC, MOPT_SET},
+	{Opt_nofast_fsync, EXT4_MOUNT_FAST_FSYNC, MOPT_CLEAR},
 	{Opt_commit, 0, MOPT_GTE0},
 	{Opt_max_batch_time, 0, MOPT_GTE0},
 	{Opt_min_batch_time, 0, MOPT_GTE0},
@@ -2208,6 +2215,19 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t mb_prefetch_store(struct ext4_attr *a,
+				 struct ext4_sb_info *sbi,
+				 const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (parse_strtoul(buf, 0xffffffff, &t))
+		return -EINVAL;
+
+	sbi->s_mb_prefetch = min_t(unsigned long, t, sbi->s_groups_count);
+	return count;
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2258,6 +2278,8 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_ATTR_OFFSET(mb_prefetch, 0644, sbi_ui_show,
+		 mb_prefetch_store, s_mb_prefetch);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2272,6 +2294,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_prefetch),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3116,9 +3139,13 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	if (ext4_proc_root)
 		sbi->s_proc = proc_mkdir(sb->s_id, ext4_proc_root);
 
-	if (sbi->s_proc)
+	spin_lock_init(&sbi->s_fsync_lock);
+	if (sbi->s_proc) {
 		proc_create_data("options", S_IRUGO, sbi->s_proc,
 				 &ext4_seq_options_fops, sb);
+		proc_create_data("fsync_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_seq_fsync_stats_fops, sb);
+	}
 
 	bgl_lock_init(sbi->s_blockgroup_lock);
 
@@ -3419,6 +3446,7 @@ failed_mount2:
 failed_mount:
 	if (sbi->s_proc) {
 		remove_proc_entry("options", sbi->s_proc);
+		remove_proc_entry("fsync_stats", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 #ifdef CONFIG_QUOTA
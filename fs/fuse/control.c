@@ -10,6 +10,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 
 #define FUSE_CTL_SUPER_MAGIC 0x65735543
 
@@ -172,6 +173,81 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static ssize_t fuse_conn_queues_read(struct file *file, char __user *buf,
+				     size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	struct fuse_queue **queues;
+	size_t size, off = 0;
+	ssize_t ret;
+	unsigned i, n;
+	char *tmp;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	size = 64 + nr_cpu_ids * 80;
+	tmp = kmalloc(size, GFP_KERNEL);
+	if (!tmp) {
+		fuse_conn_put(fc);
+		return -ENOMEM;
+	}
+
+	spin_lock(&fc->lock);
+	queues = fc->queues;
+	n = fc->nr_queues;
+	spin_unlock(&fc->lock);
+
+	off += scnprintf(tmp + off, size - off,
+			 "queue queued dispatched stolen pending max_pending\n");
+	for (i = 0; i < n; i++) {
+		struct fuse_queue *q = queues[i];
+
+		spin_lock(&q->lock);
+		off += scnprintf(tmp + off, size - off,
+				 "%u %lu %lu %lu %u %u\n", i,
+				 q->queued, q->dispatched, q->stolen,
+				 q->nr_pending, q->max_pending);
+		spin_unlock(&q->lock);
+	}
+	fuse_conn_put(fc);
+
+	ret = simple_read_from_buffer(buf, len, ppos, tmp, off);
+	kfree(tmp);
+	return ret;
+}
+
+static ssize_t fuse_conn_queues_write(struct file *file, const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+	struct fuse_queue **queues;
+	unsigned i, n;
+
+	if (!fc)
+		return count;
+
+	spin_lock(&fc->lock);
+	queues = fc->queues;
+	n = fc->nr_queues;
+	spin_unlock(&fc->lock);
+
+	for (i = 0; i < n; i++) {
+		struct fuse_queue *q = queues[i];
+
+		spin_lock(&q->lock);
+		q->queued = 0;
+		q->dispatched = 0;
+		q->stolen = 0;
+		q->max_pending = q->nr_pending;
+		spin_unlock(&q->lock);
+	}
+	fuse_conn_put(fc);
+
+	return count;
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -198,6 +274,13 @@ static const struct file_operations fuse_conn_congestion_threshold_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_conn_queues_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_queues_read,
+	.write = fuse_conn_queues_write,
+	.llseek = no_llseek,
+};
+
 static struct dentry *fuse_ctl_add_dentry(struct dentry *parent,
 					  struct fuse_conn *fc,
 					  const char *name,
@@ -258,7 +341,9 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "queues", S_IFREG | 0600, 1,
+				 NULL, &fuse_conn_queues_ops))
 		goto err;
 
 	return 0;
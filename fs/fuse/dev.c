@@ -204,26 +204,232 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 
 static u64 fuse_get_unique(struct fuse_conn *fc)
 {
-	fc->reqctr++;
-	
-	if (fc->reqctr == 0)
-		fc->reqctr = 1;
+	u64 unique;
+
+	do {
+		unique = atomic64_inc_return(&fc->reqctr);
+	} while (!unique);
+
+	return unique;
+}
+
+int fuse_queues_init(struct fuse_conn *fc, bool perfd)
+{
+	struct fuse_queue **queues;
+	int i;
+
+	queues = kcalloc(nr_cpu_ids, sizeof(*queues), GFP_KERNEL);
+	if (!queues)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_cpu_ids; i++) {
+		struct fuse_queue *q = kzalloc(sizeof(*q), GFP_KERNEL);
+
+		if (!q)
+			goto err;
+		spin_lock_init(&q->lock);
+		INIT_LIST_HEAD(&q->pending);
+		INIT_LIST_HEAD(&q->io);
+		init_waitqueue_head(&q->waitq);
+		queues[i] = q;
+	}
+
+	spin_lock(&fc->lock);
+	for (i = 0; i < nr_cpu_ids; i++)
+		queues[i]->connected = fc->connected;
+	fc->queues = queues;
+	if (perfd) {
+		fc->perfd_queues = 1;
+	} else {
+		smp_wmb();
+		fc->nr_queues = nr_cpu_ids;
+		fc->percpu_queues = 1;
+	}
+	spin_unlock(&fc->lock);
+
+	return 0;
+
+ err:
+	while (i--)
+		kfree(queues[i]);
+	kfree(queues);
+	return -ENOMEM;
+}
+
+void fuse_queues_free(struct fuse_conn *fc)
+{
+	int i;
+
+	if (!fc->queues)
+		return;
+	for (i = 0; i < nr_cpu_ids; i++)
+		kfree(fc->queues[i]);
+	kfree(fc->queues);
+}
+
+/*
+ * Requests go to the queue of the submitting cpu; with a queue per
+ * device file the cpus are spread over the files that have read so far.
+ */
+static struct fuse_queue *fuse_submit_queue(struct fuse_conn *fc)
+{
+	unsigned n = ACCESS_ONCE(fc->nr_queues);
+
+	if (!n)
+		return NULL;
+	smp_rmb();
+	return fc->queues[raw_smp_processor_id() % n];
+}
+
+static struct fuse_queue *fuse_reader_queue(struct fuse_conn *fc,
+					    struct file *file)
+{
+	unsigned i, n = ACCESS_ONCE(fc->nr_queues);
+
+	if (!n)
+		return NULL;
+	smp_rmb();
+	if (fc->percpu_queues)
+		return fc->queues[raw_smp_processor_id()];
+	for (i = 0; i < n; i++) {
+		if (fc->queues[i]->owner == file)
+			return fc->queues[i];
+	}
+	return NULL;
+}
+
+/* Called with fc->lock held, gives a device file its own queue */
+static struct fuse_queue *fuse_attach_queue(struct fuse_conn *fc,
+					    struct file *file)
+{
+	int i;
+
+	for (i = 0; i < nr_cpu_ids; i++) {
+		struct fuse_queue *q = fc->queues[i];
+
+		if (q->owner)
+			continue;
+		q->owner = file;
+		if (i >= fc->nr_queues) {
+			smp_wmb();
+			fc->nr_queues = i + 1;
+		}
+		return q;
+	}
+	return NULL;
+}
 
-	return fc->reqctr;
+/* Called with fc->lock held once fc->connected has been cleared */
+void fuse_queues_disconnect(struct fuse_conn *fc)
+{
+	int i;
+
+	for (i = 0; fc->queues && i < nr_cpu_ids; i++) {
+		spin_lock(&fc->queues[i]->lock);
+		fc->queues[i]->connected = 0;
+		spin_unlock(&fc->queues[i]->lock);
+	}
 }
 
-static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
+static void fuse_detach_queue(struct fuse_conn *fc, struct file *file)
 {
+	int i;
+
+	for (i = 0; i < fc->nr_queues; i++) {
+		if (fc->queues[i]->owner == file)
+			fc->queues[i]->owner = NULL;
+	}
+}
+
+static void dequeue_request_locked(struct fuse_conn *fc, struct fuse_queue *q,
+				   struct fuse_req *req)
+{
+	list_del_init(&req->list);
+	q->nr_pending--;
+	atomic_dec(&fc->nr_queued);
+}
+
+/*
+ * Called with fc->lock held on a request that is still waiting to be
+ * read.  Returns false if a reader has already claimed it.
+ */
+static bool unqueue_request(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_queue *q = req->queue;
+	bool pending;
+
+	if (!q) {
+		if (req->state != FUSE_REQ_PENDING)
+			return false;
+		list_del(&req->list);
+		return true;
+	}
+
+	spin_lock(&q->lock);
+	pending = req->state == FUSE_REQ_PENDING;
+	if (pending)
+		dequeue_request_locked(fc, q, req);
+	spin_unlock(&q->lock);
+
+	return pending;
+}
+
+/* Takes a request read from a dispatch queue off the queue's io list */
+static void unlink_queued_request(struct fuse_req *req)
+{
+	struct fuse_queue *q = req->queue;
+
+	if (q) {
+		spin_lock(&q->lock);
+		list_del_init(&req->list);
+		spin_unlock(&q->lock);
+	}
+}
+
+/*
+ * Without dispatch queues the caller holds fc->lock.  With them only the
+ * queue's lock is taken, and -ENOTCONN is returned if the connection has
+ * been aborted; callers holding fc->lock on a live connection never see
+ * that.
+ */
+static int queue_request(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_queue *q = fuse_submit_queue(fc);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
-	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	if (!q) {
+		list_add_tail(&req->list, &fc->pending);
+		req->state = FUSE_REQ_PENDING;
+		wake_up(&fc->waitq);
+	} else {
+		spin_lock(&q->lock);
+		if (!q->connected) {
+			spin_unlock(&q->lock);
+			return -ENOTCONN;
+		}
+		req->queue = q;
+		req->state = FUSE_REQ_PENDING;
+		list_add_tail(&req->list, &q->pending);
+		atomic_inc(&fc->nr_queued);
+		q->queued++;
+		if (++q->nr_pending > q->max_pending)
+			q->max_pending = q->nr_pending;
+		spin_unlock(&q->lock);
+
+		/* pairs with set_current_state() in request_wait() */
+		smp_mb();
+		if (waitqueue_active(&q->waitq))
+			wake_up(&q->waitq);
+		else
+			wake_up(&fc->waitq);
+	}
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	return 0;
 }
 
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
@@ -339,8 +545,7 @@ __acquires(fc->lock)
 			return;
 
 		
-		if (req->state == FUSE_REQ_PENDING) {
-			list_del(&req->list);
+		if (unqueue_request(fc, req)) {
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -366,9 +571,33 @@ __acquires(fc->lock)
 	}
 }
 
+static void fuse_request_send_queued(struct fuse_conn *fc,
+				     struct fuse_req *req)
+{
+	if (fc->conn_error) {
+		req->out.h.error = -ECONNREFUSED;
+		return;
+	}
+	req->in.h.unique = fuse_get_unique(fc);
+	__fuse_get_request(req);
+	if (queue_request(fc, req)) {
+		__fuse_put_request(req);
+		req->out.h.error = -ENOTCONN;
+		return;
+	}
+
+	spin_lock(&fc->lock);
+	request_wait_answer(fc, req);
+	spin_unlock(&fc->lock);
+}
+
 void fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
 	req->isreply = 1;
+	if (ACCESS_ONCE(fc->nr_queues)) {
+		fuse_request_send_queued(fc, req);
+		return;
+	}
 	spin_lock(&fc->lock);
 	if (!fc->connected)
 		req->out.h.error = -ENOTCONN;
@@ -838,17 +1067,26 @@ static int forget_pending(struct fuse_conn *fc)
 
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
-		forget_pending(fc);
+	return !list_empty(&fc->pending) || atomic_read(&fc->nr_queued) ||
+		!list_empty(&fc->interrupts) || forget_pending(fc);
 }
 
-static void request_wait(struct fuse_conn *fc)
+/*
+ * Readers sleep on their own queue (that of their cpu, or of their file)
+ * and on the shared waitqueue.  A request is only announced on the shared
+ * waitqueue when nobody is waiting on its own queue, so a daemon with one
+ * reader per cpu or per file gets each request delivered to that reader.
+ */
+static void request_wait(struct fuse_conn *fc, struct fuse_queue *q)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
 	DECLARE_WAITQUEUE(wait, current);
+	DECLARE_WAITQUEUE(qwait, current);
 
 	add_wait_queue_exclusive(&fc->waitq, &wait);
+	if (q)
+		add_wait_queue_exclusive(&q->waitq, &qwait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -859,9 +1097,62 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
+	if (q)
+		remove_wait_queue(&q->waitq, &qwait);
 	remove_wait_queue(&fc->waitq, &wait);
 }
 
+static struct fuse_req *claim_queued_request(struct fuse_conn *fc,
+					     struct fuse_queue *q, bool steal)
+{
+	struct fuse_req *req = NULL;
+
+	spin_lock(&q->lock);
+	if (!list_empty(&q->pending)) {
+		req = list_entry(q->pending.next, struct fuse_req, list);
+		req->state = FUSE_REQ_READING;
+		dequeue_request_locked(fc, q, req);
+		list_add(&req->list, &q->io);
+		if (steal)
+			q->stolen++;
+		else
+			q->dispatched++;
+	}
+	spin_unlock(&q->lock);
+
+	return req;
+}
+
+/*
+ * Take the next request from the reader's own queue, or steal one from
+ * another queue.  Runs without fc->lock; may return NULL if other
+ * readers got there first.
+ */
+static struct fuse_req *next_queued_request(struct fuse_conn *fc,
+					    struct fuse_queue *q)
+{
+	struct fuse_req *req;
+	unsigned i, n;
+
+	if (q) {
+		req = claim_queued_request(fc, q, false);
+		if (req)
+			return req;
+	}
+
+	n = ACCESS_ONCE(fc->nr_queues);
+	smp_rmb();
+	for (i = 0; i < n; i++) {
+		if (fc->queues[i] == q)
+			continue;
+		req = claim_queued_request(fc, fc->queues[i], true);
+		if (req)
+			return req;
+	}
+
+	return NULL;
+}
+
 static int fuse_read_interrupt(struct fuse_conn *fc, struct fuse_copy_state *cs,
 			       size_t nbytes, struct fuse_req *req)
 __releases(fc->lock)
@@ -1011,17 +1302,33 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 {
 	int err;
 	struct fuse_req *req;
+	struct fuse_queue *q;
 	struct fuse_in *in;
 	unsigned reqsize;
 
  restart:
+	/*
+	 * Queued requests are claimed under the queue's lock alone; fc->lock
+	 * is only needed to sleep, or when an interrupt, forget or request
+	 * on the shared pending list may have to go first.
+	 */
+	q = fuse_reader_queue(fc, file);
+	if (atomic_read(&fc->nr_queued) && list_empty(&fc->interrupts) &&
+	    !forget_pending(fc) && list_empty(&fc->pending)) {
+		req = next_queued_request(fc, q);
+		if (req)
+			goto copy;
+	}
+
 	spin_lock(&fc->lock);
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
 	    !request_pending(fc))
 		goto err_unlock;
 
-	request_wait(fc);
+	if (!q && fc->perfd_queues && fc->connected)
+		q = fuse_attach_queue(fc, file);
+	request_wait(fc, q);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
@@ -1036,41 +1343,61 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	}
 
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if ((list_empty(&fc->pending) &&
+		     !atomic_read(&fc->nr_queued)) ||
+		    fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
-	req->state = FUSE_REQ_READING;
-	list_move(&req->list, &fc->io);
+	if (!list_empty(&fc->pending)) {
+		req = list_entry(fc->pending.next, struct fuse_req, list);
+		req->state = FUSE_REQ_READING;
+		list_move(&req->list, &fc->io);
+		spin_unlock(&fc->lock);
+	} else {
+		spin_unlock(&fc->lock);
+		req = next_queued_request(fc, fuse_reader_queue(fc, file));
+		if (!req)
+			goto restart;
+	}
 
+ copy:
 	in = &req->in;
 	reqsize = in->h.len;
 	
 	if (nbytes < reqsize) {
-		req->out.h.error = -EIO;
-		
-		if (in->h.opcode == FUSE_SETXATTR)
-			req->out.h.error = -E2BIG;
+		unlink_queued_request(req);
+		spin_lock(&fc->lock);
+		if (!req->aborted) {
+			req->out.h.error = -EIO;
+			
+			if (in->h.opcode == FUSE_SETXATTR)
+				req->out.h.error = -E2BIG;
+		}
 		request_end(fc, req);
 		goto restart;
 	}
-	spin_unlock(&fc->lock);
 	cs->req = req;
 	err = fuse_copy_one(cs, &in->h, sizeof(in->h));
 	if (!err)
 		err = fuse_copy_args(cs, in->numargs, in->argpages,
 				     (struct fuse_arg *) in->args, 0);
 	fuse_copy_finish(cs);
+	unlink_queued_request(req);
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (req->aborted) {
 		request_end(fc, req);
 		return -ENODEV;
 	}
+	if (!fc->connected) {
+		req->out.h.error = -ECONNABORTED;
+		request_end(fc, req);
+		return -ENODEV;
+	}
 	if (err) {
 		req->out.h.error = -EIO;
 		request_end(fc, req);
@@ -1672,6 +1999,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	if (!err && !oh.error)
+		fuse_passthrough_setup(fc, req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -1813,28 +2143,51 @@ __acquires(fc->lock)
 	}
 }
 
-static void end_io_requests(struct fuse_conn *fc)
+static void end_io_request(struct fuse_conn *fc, struct fuse_req *req)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
-	while (!list_empty(&fc->io)) {
-		struct fuse_req *req =
-			list_entry(fc->io.next, struct fuse_req, list);
-		void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
+	void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
 
-		req->aborted = 1;
-		req->out.h.error = -ECONNABORTED;
-		req->state = FUSE_REQ_FINISHED;
-		list_del_init(&req->list);
-		wake_up(&req->waitq);
-		if (end) {
-			req->end = NULL;
-			__fuse_get_request(req);
-			spin_unlock(&fc->lock);
-			wait_event(req->waitq, !req->locked);
-			end(fc, req);
-			fuse_put_request(fc, req);
-			spin_lock(&fc->lock);
+	req->aborted = 1;
+	req->out.h.error = -ECONNABORTED;
+	req->state = FUSE_REQ_FINISHED;
+	list_del_init(&req->list);
+	wake_up(&req->waitq);
+	if (end) {
+		req->end = NULL;
+		__fuse_get_request(req);
+		spin_unlock(&fc->lock);
+		wait_event(req->waitq, !req->locked);
+		end(fc, req);
+		fuse_put_request(fc, req);
+		spin_lock(&fc->lock);
+	}
+}
+
+static void end_io_requests(struct fuse_conn *fc)
+__releases(fc->lock)
+__acquires(fc->lock)
+{
+	struct fuse_req *req;
+	int i;
+
+	while (!list_empty(&fc->io))
+		end_io_request(fc, list_entry(fc->io.next, struct fuse_req,
+					      list));
+	for (i = 0; fc->queues && i < nr_cpu_ids; i++) {
+		struct fuse_queue *q = fc->queues[i];
+
+		for (;;) {
+			spin_lock(&q->lock);
+			if (list_empty(&q->io)) {
+				spin_unlock(&q->lock);
+				break;
+			}
+			req = list_entry(q->io.next, struct fuse_req, list);
+			list_del_init(&req->list);
+			spin_unlock(&q->lock);
+			end_io_request(fc, req);
 		}
 	}
 }
@@ -1843,9 +2196,28 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	LIST_HEAD(queued);
+	struct fuse_req *req;
+	int i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
 	end_requests(fc, &fc->pending);
+	fuse_queues_disconnect(fc);
+	if (fc->queues) {
+		for (i = 0; i < nr_cpu_ids; i++) {
+			struct fuse_queue *q = fc->queues[i];
+
+			spin_lock(&q->lock);
+			list_for_each_entry(req, &q->pending, list)
+				req->queue = NULL;
+			atomic_sub(q->nr_pending, &fc->nr_queued);
+			q->nr_pending = 0;
+			list_splice_tail_init(&q->pending, &queued);
+			spin_unlock(&q->lock);
+		}
+		end_requests(fc, &queued);
+	}
 	end_requests(fc, &fc->processing);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
@@ -1888,11 +2260,15 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 	struct fuse_conn *fc = fuse_get_conn(file);
 	if (fc) {
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
+		if (fc->queues)
+			fuse_detach_queue(fc, file);
+		if (!--fc->dev_count) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
 		spin_unlock(&fc->lock);
 		fuse_conn_put(fc);
 	}
@@ -1901,6 +2277,57 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+/*
+ * A daemon can open /dev/fuse again and attach the new file to its
+ * connection, so that each reader thread has a file of its own and, with
+ * FUSE_PERFD_QUEUES, a dispatch queue of its own.  The connection is
+ * torn down when the last of its files is released.
+ */
+static int fuse_dev_clone(struct file *file, struct file *old)
+{
+	struct fuse_conn *fc;
+	int err = -EINVAL;
+
+	mutex_lock(&fuse_mutex);
+	fc = old->private_data;
+	if (old->f_op == &fuse_dev_operations && fc && !file->private_data) {
+		spin_lock(&fc->lock);
+		err = -ENODEV;
+		if (fc->connected) {
+			fc->dev_count++;
+			file->private_data = fuse_conn_get(fc);
+			err = 0;
+		}
+		spin_unlock(&fc->lock);
+	}
+	mutex_unlock(&fuse_mutex);
+
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct file *old;
+	u32 oldfd;
+	int err;
+
+	if (cmd != FUSE_DEV_IOC_CLONE)
+		return -ENOTTY;
+	if (file->f_op != &fuse_dev_operations)
+		return -EINVAL;
+	if (get_user(oldfd, (u32 __user *) arg))
+		return -EFAULT;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EINVAL;
+	err = fuse_dev_clone(file, old);
+	fput(old);
+
+	return err;
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -1923,6 +2350,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -374,6 +374,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	req->out.args[1].value = &outopen;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	ff->passthrough_filp = req->passthrough_filp;
 	if (err) {
 		if (err == -ENOSYS)
 			fc->no_create = 1;
@@ -1209,6 +1210,49 @@ void fuse_release_nowrite(struct inode *inode)
 	spin_unlock(&fc->lock);
 }
 
+int fuse_flush_mtime(struct inode *inode)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct fuse_req *req;
+	struct fuse_setattr_in inarg;
+	struct fuse_attr_out outarg;
+	int err;
+
+	if (!test_and_clear_bit(FUSE_I_MTIME_DIRTY, &fi->state))
+		return 0;
+
+	req = fuse_get_req(fc);
+	if (IS_ERR(req)) {
+		set_bit(FUSE_I_MTIME_DIRTY, &fi->state);
+		return PTR_ERR(req);
+	}
+
+	memset(&inarg, 0, sizeof(inarg));
+	memset(&outarg, 0, sizeof(outarg));
+	inarg.valid = FATTR_MTIME;
+	inarg.mtime = inode->i_mtime.tv_sec;
+	inarg.mtimensec = inode->i_mtime.tv_nsec;
+	req->in.h.opcode = FUSE_SETATTR;
+	req->in.h.nodeid = get_node_id(inode);
+	req->in.numargs = 1;
+	req->in.args[0].size = sizeof(inarg);
+	req->in.args[0].value = &inarg;
+	req->out.numargs = 1;
+	if (fc->minor < 9)
+		req->out.args[0].size = FUSE_COMPAT_ATTR_OUT_SIZE;
+	else
+		req->out.args[0].size = sizeof(outarg);
+	req->out.args[0].value = &outarg;
+	fuse_request_send(fc, req);
+	err = req->out.h.error;
+	fuse_put_request(fc, req);
+	if (err)
+		set_bit(FUSE_I_MTIME_DIRTY, &fi->state);
+
+	return err;
+}
+
 static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 			   struct file *file)
 {
@@ -1218,7 +1262,8 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	struct fuse_setattr_in inarg;
 	struct fuse_attr_out outarg;
 	bool is_truncate = false;
-	loff_t oldsize;
+	bool is_wb;
+	loff_t oldsize, newsize;
 	int err;
 
 	if (!fuse_allow_task(fc, current))
@@ -1247,6 +1292,10 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	if (is_truncate)
 		fuse_set_nowrite(inode);
 
+	is_wb = fc->writeback_cache && S_ISREG(inode->i_mode);
+	if (is_wb && (attr->ia_valid & ATTR_MTIME))
+		clear_bit(FUSE_I_MTIME_DIRTY, &get_fuse_inode(inode)->state);
+
 	memset(&inarg, 0, sizeof(inarg));
 	memset(&outarg, 0, sizeof(outarg));
 	iattr_to_fattr(attr, &inarg);
@@ -1290,7 +1339,10 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	newsize = outarg.attr.size;
+	if (is_wb && !is_truncate)
+		newsize = oldsize;
+	i_size_write(inode, newsize);
 
 	if (is_truncate) {
 		
@@ -1298,8 +1350,8 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	}
 	spin_unlock(&fc->lock);
 
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
-		truncate_pagecache(inode, oldsize, outarg.attr.size);
+	if (S_ISREG(inode->i_mode) && oldsize != newsize) {
+		truncate_pagecache(inode, oldsize, newsize);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 
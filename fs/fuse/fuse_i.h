@@ -23,13 +23,15 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 #define FUSE_MAX_PAGES_PER_REQ 32
 
 #define FUSE_NOWRITE INT_MIN
 
 #define FUSE_NAME_MAX 1024
 
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 #define FUSE_DEFAULT_PERMISSIONS (1 << 0)
 
@@ -80,6 +82,13 @@ struct fuse_inode {
 
 	
 	struct list_head writepages;
+
+	
+	unsigned long state;
+};
+
+enum {
+	FUSE_I_MTIME_DIRTY,
 };
 
 struct fuse_conn;
@@ -117,6 +126,9 @@ struct fuse_file {
 
 	
 	bool flock:1;
+
+	
+	struct file *passthrough_filp;
 };
 
 struct fuse_in_arg {
@@ -222,6 +234,9 @@ struct fuse_req {
 	wait_queue_head_t waitq;
 
 	
+	struct fuse_queue *queue;
+
+	
 	union {
 		struct {
 			union {
@@ -268,8 +283,33 @@ struct fuse_req {
 
 	
 	struct file *stolen_file;
+
+	
+	struct file *passthrough_filp;
 };
 
+/*
+ * A dispatch queue, one per cpu or one per device file.  The lock
+ * protects the pending and io lists, the counters, and the PENDING ->
+ * READING transition of requests on the queue; requests are queued and
+ * claimed without fc->lock.  connected is cleared under both locks.
+ */
+struct fuse_queue {
+	spinlock_t lock;
+
+	struct list_head pending;
+	struct list_head io;
+	wait_queue_head_t waitq;
+	struct file *owner;
+	int connected;
+	unsigned nr_pending;
+
+	unsigned long queued;
+	unsigned long dispatched;
+	unsigned long stolen;
+	unsigned max_pending;
+} ____cacheline_aligned_in_smp;
+
 struct fuse_conn {
 	
 	spinlock_t lock;
@@ -302,6 +342,15 @@ struct fuse_conn {
 	struct list_head pending;
 
 	
+	struct fuse_queue **queues;
+
+	
+	unsigned nr_queues;
+
+	
+	atomic_t nr_queued;
+
+	
 	struct list_head processing;
 
 	
@@ -347,10 +396,13 @@ struct fuse_conn {
 	wait_queue_head_t reserved_req_waitq;
 
 	
-	u64 reqctr;
+	atomic64_t reqctr;
 
 	unsigned connected;
 
+	
+	unsigned dev_count;
+
 	unsigned conn_error:1;
 
 	
@@ -418,6 +470,18 @@ struct fuse_conn {
 	unsigned no_flock:1;
 
 	
+	unsigned passthrough:1;
+
+	
+	unsigned writeback_cache:1;
+
+	
+	unsigned percpu_queues:1;
+
+	
+	unsigned perfd_queues:1;
+
+	
 	atomic_t num_waiting;
 
 	
@@ -560,6 +624,12 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 
 void fuse_abort_conn(struct fuse_conn *fc);
 
+int fuse_queues_init(struct fuse_conn *fc, bool perfd);
+
+void fuse_queues_free(struct fuse_conn *fc);
+
+void fuse_queues_disconnect(struct fuse_conn *fc);
+
 void fuse_invalidate_attr(struct inode *inode);
 
 void fuse_invalidate_entry_cache(struct dentry *entry);
@@ -611,4 +681,17 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+int fuse_flush_mtime(struct inode *inode);
+
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif 
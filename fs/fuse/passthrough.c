@@ -0,0 +1,200 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/ratelimit.h>
+#include <linux/uio.h>
+
+/*
+ * Passthrough lets the daemon hand over an open file at FUSE_OPEN or
+ * FUSE_CREATE time.  Data I/O on the FUSE file is then served directly
+ * by that lower file, while lookup, permission and attribute requests
+ * still go to the daemon.
+ *
+ * The descriptor is resolved here, in the context of the daemon writing
+ * the reply to /dev/fuse, so it refers to the daemon's file table.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *open_out;
+	struct file *filp;
+	u32 flags;
+
+	if (req->in.h.opcode == FUSE_OPEN) {
+		open_out = req->out.args[0].value;
+		flags = ((struct fuse_open_in *)req->in.args[0].value)->flags;
+	} else if (req->in.h.opcode == FUSE_CREATE) {
+		open_out = req->out.args[1].value;
+		flags = ((struct fuse_create_in *)req->in.args[0].value)->flags;
+	} else {
+		return;
+	}
+
+	if (!(open_out->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	open_out->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	if (!fc->passthrough || (open_out->open_flags & FOPEN_DIRECT_IO))
+		return;
+
+	filp = fget(open_out->passthrough_fd);
+	if (!filp)
+		return;
+
+	if (!S_ISREG(filp->f_path.dentry->d_inode->i_mode) ||
+	    filp->f_path.dentry->d_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !filp->f_op || !filp->f_op->aio_read || !filp->f_op->aio_write)
+		goto out_fput;
+
+	if ((flags & O_ACCMODE) != O_WRONLY && !(filp->f_mode & FMODE_READ))
+		goto out_fput;
+	if ((flags & O_ACCMODE) != O_RDONLY && !(filp->f_mode & FMODE_WRITE))
+		goto out_fput;
+
+	open_out->open_flags |= FOPEN_PASSTHROUGH;
+	req->passthrough_filp = filp;
+	return;
+
+out_fput:
+	printk_ratelimited(KERN_WARNING "fuse: passthrough fd %u rejected\n",
+			   open_out->passthrough_fd);
+	fput(filp);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos,
+				   bool write)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct kiocb kiocb;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	ret = rw_verify_area(write ? WRITE : READ, lower, &pos, count);
+	if (ret < 0)
+		return ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = kiocb.ki_left;
+
+	if (write)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+
+	if (ret > 0) {
+		iocb->ki_pos = kiocb.ki_pos;
+		if (write)
+			fsnotify_modify(lower);
+		else
+			fsnotify_access(lower);
+	}
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	ssize_t ret;
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, false);
+	if (ret >= 0)
+		fsstack_copy_attr_atime(inode,
+				ff->passthrough_filp->f_path.dentry->d_inode);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct inode *inode = file->f_mapping->host;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(ff->passthrough_filp->f_mapping->host);
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, true);
+	if (ret > 0) {
+		fuse_write_update_size(inode, iocb->ki_pos);
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					pos >> PAGE_CACHE_SHIFT,
+					(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+	struct file *lower = ff->passthrough_filp;
+
+	if (!lower->f_op->splice_read)
+		return default_file_splice_read(in, ppos, pipe, len, flags);
+
+	return lower->f_op->splice_read(lower, ppos, pipe, len, flags);
+}
+
+/*
+ * Map the lower file directly: the vma takes a reference on the lower
+ * file and drops the one it held on the FUSE file, so faults never
+ * reach the FUSE page cache.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = lower;
+	get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+		return ret;
+	}
+
+	fput(file);
+	file_accessed(file);
+	return 0;
+}
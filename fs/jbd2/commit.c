@@ -177,6 +177,80 @@ static int journal_submit_data_buffers(journal_t *journal,
 	return ret;
 }
 
+/*
+ * Queued once the commit record of the committing transaction has been
+ * submitted, and flushed before the next commit starts.  If the running
+ * transaction has already been asked to commit, start writeback of the
+ * ordered data of up to j_commit_pipeline of its inodes, so that its own
+ * flushing phase finds those pages already on their way to disk.
+ * Writing ordered data early is always safe; its commit still waits for
+ * it.
+ */
+void jbd2_journal_pipeline_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_pipeline_work);
+	unsigned int depth = ACCESS_ONCE(journal->j_commit_pipeline);
+	transaction_t *next;
+	struct jbd2_inode *jinode;
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	unsigned int nr = 0;
+
+	read_lock(&journal->j_state_lock);
+	next = journal->j_running_transaction;
+	if (!next || !tid_geq(journal->j_commit_request, next->t_tid)) {
+		read_unlock(&journal->j_state_lock);
+		return;
+	}
+	read_unlock(&journal->j_state_lock);
+
+	spin_lock(&journal->j_list_lock);
+	list_for_each_entry(jinode, &next->t_inode_list, i_list) {
+		struct address_space *mapping = jinode->i_vfs_inode->i_mapping;
+
+		if (nr >= depth)
+			break;
+		set_bit(__JI_COMMIT_RUNNING, &jinode->i_flags);
+		spin_unlock(&journal->j_list_lock);
+		wbc.nr_to_write = mapping->nrpages * 2;
+		wbc.range_start = 0;
+		wbc.range_end = i_size_read(mapping->host);
+		generic_writepages(mapping, &wbc);
+		nr++;
+		spin_lock(&journal->j_list_lock);
+		clear_bit(__JI_COMMIT_RUNNING, &jinode->i_flags);
+		smp_mb__after_clear_bit();
+		wake_up_bit(&jinode->i_flags, __JI_COMMIT_RUNNING);
+	}
+	spin_unlock(&journal->j_list_lock);
+
+	if (nr) {
+		journal->j_pipelined_commits++;
+		journal->j_pipelined_inodes += nr;
+	}
+}
+
+static void journal_account_phases(journal_t *journal, ktime_t *stamps)
+{
+	int i;
+
+	for (i = 0; i < JBD2_NR_PHASES; i++) {
+		struct jbd2_phase_stats_s *ps = &journal->j_phase_stats[i];
+		u64 ns = ktime_to_ns(ktime_sub(stamps[i + 1], stamps[i]));
+		unsigned int ms = div_u64(ns, NSEC_PER_MSEC);
+		int bucket = 0;
+
+		/* buckets are <1ms, <2ms, <4ms, ... , >=64ms */
+		if (ms)
+			bucket = min(ilog2(ms) + 1, JBD2_PHASE_HIST - 1);
+		ps->ps_total_ns += ns;
+		if (ns > ps->ps_max_ns)
+			ps->ps_max_ns = ns;
+		ps->ps_hist[bucket]++;
+	}
+}
+
 static int journal_finish_inode_data_buffers(journal_t *journal,
 		transaction_t *commit_transaction)
 {
@@ -253,6 +327,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int err;
 	unsigned long long blocknr;
 	ktime_t start_time;
+	ktime_t phase_start[JBD2_NR_PHASES + 1];
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_header_t *header;
@@ -287,6 +362,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	J_ASSERT(journal->j_running_transaction != NULL);
 	J_ASSERT(journal->j_committing_transaction == NULL);
 
+	/* the pipelined writeback walks the running transaction's inodes */
+	flush_work(&journal->j_pipeline_work);
+
 	commit_transaction = journal->j_running_transaction;
 	J_ASSERT(commit_transaction->t_state == T_RUNNING);
 
@@ -300,6 +378,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
 	stats.run.rs_locked = jiffies;
+	phase_start[JBD2_PHASE_LOCKED] = ktime_get();
 	stats.run.rs_running = jbd2_time_diff(commit_transaction->t_start,
 					      stats.run.rs_locked);
 
@@ -361,6 +440,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	journal->j_committing_transaction = commit_transaction;
 	journal->j_running_transaction = NULL;
 	start_time = ktime_get();
+	phase_start[JBD2_PHASE_FLUSHING] = start_time;
 	commit_transaction->t_log_start = journal->j_head;
 	wake_up(&journal->j_wait_transaction_locked);
 	write_unlock(&journal->j_state_lock);
@@ -388,6 +468,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	write_unlock(&journal->j_state_lock);
 
 	trace_jbd2_commit_logging(journal, commit_transaction);
+	phase_start[JBD2_PHASE_LOGGING] = ktime_get();
 	stats.run.rs_logging = jiffies;
 	stats.run.rs_flushing = jbd2_time_diff(stats.run.rs_flushing,
 					       stats.run.rs_logging);
@@ -666,6 +747,7 @@ wait_for_iobuf:
 	J_ASSERT(commit_transaction->t_state == T_COMMIT_DFLUSH);
 	commit_transaction->t_state = T_COMMIT_JFLUSH;
 	write_unlock(&journal->j_state_lock);
+	phase_start[JBD2_PHASE_COMMIT_WAIT] = ktime_get();
 
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
@@ -674,6 +756,8 @@ wait_for_iobuf:
 		if (err)
 			__jbd2_journal_abort_hard(journal);
 	}
+	if (journal->j_commit_pipeline && !is_journal_aborted(journal))
+		queue_work(system_unbound_wq, &journal->j_pipeline_work);
 	if (cbh)
 		err = journal_wait_on_commit_record(journal, cbh);
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
@@ -681,6 +765,7 @@ wait_for_iobuf:
 	    journal->j_flags & JBD2_BARRIER) {
 		blkdev_issue_flush(journal->j_dev, GFP_NOFS, NULL);
 	}
+	phase_start[JBD2_NR_PHASES] = ktime_get();
 
 	if (err)
 		jbd2_journal_abort(journal, err);
@@ -803,6 +888,7 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal_account_phases(journal, phase_start);
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_COMMIT_CALLBACK;
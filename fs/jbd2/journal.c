@@ -773,6 +773,97 @@ static const struct file_operations jbd2_seq_info_fops = {
 	.release        = jbd2_seq_info_release,
 };
 
+static int jbd2_seq_commit_stats_show(struct seq_file *seq, void *v)
+{
+	static const char *phase_names[JBD2_NR_PHASES] = {
+		[JBD2_PHASE_LOCKED]		= "locked",
+		[JBD2_PHASE_FLUSHING]		= "flushing",
+		[JBD2_PHASE_LOGGING]		= "logging",
+		[JBD2_PHASE_COMMIT_WAIT]	= "commit_wait",
+	};
+	journal_t *journal = seq->private;
+	struct jbd2_phase_stats_s ps[JBD2_NR_PHASES];
+	unsigned long commits;
+	int i, j;
+
+	spin_lock(&journal->j_history_lock);
+	commits = journal->j_stats.ts_tid;
+	memcpy(ps, journal->j_phase_stats, sizeof(ps));
+	spin_unlock(&journal->j_history_lock);
+
+	seq_printf(seq, "commits: %lu\n", commits);
+	seq_printf(seq, "pipelined: %lu commits, %lu inodes\n",
+		   journal->j_pipelined_commits, journal->j_pipelined_inodes);
+	seq_printf(seq, "%-12s %10s %10s  <1ms <2ms <4ms <8ms <16ms <32ms "
+		   "<64ms >=64ms\n", "phase", "avg_us", "max_us");
+	for (i = 0; i < JBD2_NR_PHASES; i++) {
+		seq_printf(seq, "%-12s %10llu %10llu", phase_names[i],
+			   commits ? div_u64(div_u64(ps[i].ps_total_ns, 1000),
+					     commits) : 0,
+			   div_u64(ps[i].ps_max_ns, 1000));
+		for (j = 0; j < JBD2_PHASE_HIST; j++)
+			seq_printf(seq, " %lu", ps[i].ps_hist[j]);
+		seq_putc(seq, '\n');
+	}
+	return 0;
+}
+
+static int jbd2_seq_commit_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jbd2_seq_commit_stats_show, PDE(inode)->data);
+}
+
+static const struct file_operations jbd2_seq_commit_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jbd2_seq_commit_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int jbd2_seq_commit_pipeline_show(struct seq_file *seq, void *v)
+{
+	journal_t *journal = seq->private;
+
+	seq_printf(seq, "%u\n", journal->j_commit_pipeline);
+	return 0;
+}
+
+static int jbd2_seq_commit_pipeline_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, jbd2_seq_commit_pipeline_show,
+			   PDE(inode)->data);
+}
+
+static ssize_t jbd2_seq_commit_pipeline_write(struct file *file,
+					      const char __user *buf,
+					      size_t count, loff_t *ppos)
+{
+	journal_t *journal = PDE(file->f_path.dentry->d_inode)->data;
+	char kbuf[12];
+	unsigned int val;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+	if (kstrtouint(strstrip(kbuf), 0, &val))
+		return -EINVAL;
+	journal->j_commit_pipeline = val;
+	return count;
+}
+
+static const struct file_operations jbd2_seq_commit_pipeline_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jbd2_seq_commit_pipeline_open,
+	.read		= seq_read,
+	.write		= jbd2_seq_commit_pipeline_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct proc_dir_entry *proc_jbd2_stats;
 
 static void jbd2_stats_proc_init(journal_t *journal)
@@ -781,12 +872,19 @@ static void jbd2_stats_proc_init(journal_t *journal)
 	if (journal->j_proc_entry) {
 		proc_create_data("info", S_IRUGO, journal->j_proc_entry,
 				 &jbd2_seq_info_fops, journal);
+		proc_create_data("commit_stats", S_IRUGO, journal->j_proc_entry,
+				 &jbd2_seq_commit_stats_fops, journal);
+		proc_create_data("commit_pipeline", S_IRUGO | S_IWUSR,
+				 journal->j_proc_entry,
+				 &jbd2_seq_commit_pipeline_fops, journal);
 	}
 }
 
 static void jbd2_stats_proc_exit(journal_t *journal)
 {
 	remove_proc_entry("info", journal->j_proc_entry);
+	remove_proc_entry("commit_stats", journal->j_proc_entry);
+	remove_proc_entry("commit_pipeline", journal->j_proc_entry);
 	remove_proc_entry(journal->j_devname, proc_jbd2_stats);
 }
 
@@ -828,6 +926,8 @@ static journal_t * journal_init_common (void)
 	}
 
 	spin_lock_init(&journal->j_history_lock);
+	INIT_WORK(&journal->j_pipeline_work, jbd2_journal_pipeline_work);
+	journal->j_commit_pipeline = JBD2_DEFAULT_COMMIT_PIPELINE;
 
 	return journal;
 }
@@ -1233,6 +1333,7 @@ int jbd2_journal_destroy(journal_t *journal)
 	
 	if (journal->j_running_transaction)
 		jbd2_journal_commit_transaction(journal);
+	flush_work(&journal->j_pipeline_work);
 
 	
 
@@ -54,6 +54,12 @@ static const struct squashfs_decompressor squashfs_zlib_comp_ops = {
 };
 #endif
 
+#ifndef CONFIG_SQUASHFS_LZ4
+static const struct squashfs_decompressor squashfs_lz4_comp_ops = {
+	NULL, NULL, NULL, LZ4_COMPRESSION, "lz4", 0
+};
+#endif
+
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
 };
@@ -62,6 +68,7 @@ static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzo_comp_ops,
 	&squashfs_xz_comp_ops,
+	&squashfs_lz4_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
@@ -100,7 +107,7 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	strm = squashfs_decompressor_create(msblk, buffer, length);
 
 finished:
 	kfree(buffer);
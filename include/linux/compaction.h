@@ -13,6 +13,9 @@ extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
+extern int sysctl_kcompactd_order;
+extern int sysctl_kcompactd_blocks;
+extern int sysctl_kcompactd_interval;
 
 extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
@@ -21,6 +24,7 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 extern int compact_pgdat(pg_data_t *pgdat, int order);
 extern void reset_isolation_suitable(pg_data_t *pgdat);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
+extern void wakeup_kcompactd(struct zone *zone);
 
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -76,6 +80,10 @@ static inline void reset_isolation_suitable(pg_data_t *pgdat)
 {
 }
 
+static inline void wakeup_kcompactd(struct zone *zone)
+{
+}
+
 static inline unsigned long compaction_suitable(struct zone *zone, int order)
 {
 	return COMPACT_SKIPPED;
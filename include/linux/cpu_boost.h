@@ -0,0 +1,21 @@
+#ifndef _LINUX_CPU_BOOST_H
+#define _LINUX_CPU_BOOST_H
+
+struct task_struct;
+
+enum cpu_boost_src {
+	CPU_BOOST_SRC_INPUT,
+	CPU_BOOST_SRC_FRAME,
+	CPU_BOOST_SRC_BINDER,
+	NR_CPU_BOOST_SRC,
+};
+
+#ifdef CONFIG_CPU_BOOST
+extern void cpu_boost_binder_transaction(struct task_struct *target);
+#else
+static inline void cpu_boost_binder_transaction(struct task_struct *target)
+{
+}
+#endif
+
+#endif
@@ -516,6 +516,7 @@ struct fb_cursor_user {
 #define FB_EVENT_FB_UNBIND              0x0E
 #define FB_EVENT_REMAP_ALL_CONSOLE      0x0F
 #define FB_EVENT_PREBLANK               0x10
+#define FB_EVENT_FRAME_COMMIT           0x11
 
 struct fb_event {
 	struct fb_info *info;
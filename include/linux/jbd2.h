@@ -37,6 +37,7 @@
 #undef JBD2_PARANOID_IOFAIL
 
 #define JBD2_DEFAULT_MAX_COMMIT_AGE 5
+#define JBD2_DEFAULT_COMMIT_PIPELINE 16
 
 #ifdef CONFIG_JBD2_DEBUG
 #define JBD2_EXPENSIVE_CHECKING
@@ -379,6 +380,22 @@ struct transaction_stats_s {
 	struct transaction_run_stats_s run;
 };
 
+enum jbd2_commit_phase {
+	JBD2_PHASE_LOCKED,
+	JBD2_PHASE_FLUSHING,
+	JBD2_PHASE_LOGGING,
+	JBD2_PHASE_COMMIT_WAIT,
+	JBD2_NR_PHASES,
+};
+
+#define JBD2_PHASE_HIST	8
+
+struct jbd2_phase_stats_s {
+	u64			ps_total_ns;
+	u64			ps_max_ns;
+	unsigned long		ps_hist[JBD2_PHASE_HIST];
+};
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -507,6 +524,13 @@ struct journal_s
 	spinlock_t		j_history_lock;
 	struct proc_dir_entry	*j_proc_entry;
 	struct transaction_stats_s j_stats;
+	struct jbd2_phase_stats_s j_phase_stats[JBD2_NR_PHASES];
+
+	
+	unsigned int		j_commit_pipeline;
+	struct work_struct	j_pipeline_work;
+	unsigned long		j_pipelined_commits;
+	unsigned long		j_pipelined_inodes;
 
 	
 	unsigned int		j_failed_commit;
@@ -539,6 +563,7 @@ void __jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
 void jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
 
 extern void jbd2_journal_commit_transaction(journal_t *);
+extern void jbd2_journal_pipeline_work(struct work_struct *);
 
 int __jbd2_journal_clean_checkpoint_list(journal_t *journal);
 int __jbd2_journal_remove_checkpoint(struct journal_head *);
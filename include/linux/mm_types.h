@@ -163,6 +163,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info;
+#endif
 };
 
 struct core_thread {
@@ -267,6 +270,9 @@ struct mm_struct {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	pgtable_t pmd_huge_pte; 
 #endif
+#ifdef CONFIG_KSM
+	unsigned long ksm_merging_pages;	/* pages mapped from the stable tree */
+#endif
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
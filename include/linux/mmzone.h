@@ -183,9 +183,17 @@ struct per_cpu_pages {
 	int count;		
 	int high;		
 	int batch;		
+	int base_high;		/* high and batch before scaling */
+	int base_batch;
+	int scale;		/* high and batch are base << scale */
+	int refills;		/* refills and drains this vmstat interval */
 
 	
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	unsigned long alloc_hit;
+	unsigned long alloc_miss;
+	unsigned long lock_contended;
 };
 
 struct per_cpu_pageset {
@@ -431,6 +439,11 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_wake;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
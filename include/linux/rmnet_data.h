@@ -64,6 +64,10 @@ struct rmnet_nl_msg_s {
 			uint32_t id;
 			uint8_t  vnd_name[RMNET_MAX_STR_LEN];
 		} vnd;
+		struct {
+			uint8_t  dev[RMNET_MAX_STR_LEN];
+			uint32_t cpu_mask;
+		} rps_config;
 	};
 };
 
@@ -88,7 +92,9 @@ enum rmnet_netlink_message_types_e {
 
 	RMNET_NETLINK_NEW_VND,
 
-	RMNET_NETLINK_FREE_VND
+	RMNET_NETLINK_FREE_VND,
+	RMNET_NETLINK_SET_LINK_RPS_CONFIG,
+	RMNET_NETLINK_GET_LINK_RPS_CONFIG
 };
 
 enum rmnet_config_endpoint_modes_e {
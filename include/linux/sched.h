@@ -118,8 +118,26 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+struct sched_nr_avg_cpu {
+	u64 nr_prod;
+	u64 iowait_prod;
+	unsigned int avg;
+	unsigned int iowait_avg;
+};
+
+struct sched_nr_avg_window {
+	u64 last_time;
+	u64 window_ns;
+	unsigned int avg;
+	unsigned int iowait_avg;
+	struct sched_nr_avg_cpu __percpu *cpu;
+};
+
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
+extern int sched_nr_avg_window_init(struct sched_nr_avg_window *win);
+extern void sched_nr_avg_window_destroy(struct sched_nr_avg_window *win);
+extern u64 sched_nr_avg_window_update(struct sched_nr_avg_window *win);
 
 extern void calc_global_load(unsigned long ticks);
 
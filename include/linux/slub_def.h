@@ -36,8 +36,14 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	
 	CPU_PARTIAL_NODE,	
 	CPU_PARTIAL_DRAIN,	
+	ALLOC_PARTIAL_WALK,	
 	NR_SLUB_STAT_ITEMS };
 
+enum stat_time_item {
+	TIME_SLOWPATH,		
+	TIME_NEW_SLAB,		
+	NR_SLUB_TIME_ITEMS };
+
 struct kmem_cache_cpu {
 	void **freelist;	
 	unsigned long tid;	
@@ -46,6 +52,8 @@ struct kmem_cache_cpu {
 	int node;		
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
+	u64 time_ns[NR_SLUB_TIME_ITEMS];
+	u64 time_max_ns[NR_SLUB_TIME_ITEMS];
 #endif
 };
 
@@ -53,6 +61,9 @@ struct kmem_cache_node {
 	spinlock_t list_lock;	
 	unsigned long nr_partial;
 	struct list_head partial;
+#ifdef CONFIG_SLUB_STATS
+	unsigned long peak_partial;
+#endif
 #ifdef CONFIG_SLUB_DEBUG
 	atomic_long_t nr_slabs;
 	atomic_long_t total_objects;
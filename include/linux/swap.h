@@ -101,7 +101,7 @@ enum {
 	SWP_SOLIDSTATE	= (1 << 4),	
 	SWP_CONTINUED	= (1 << 5),	
 	SWP_BLKDEV	= (1 << 6),	
-					
+	SWP_VMA_RA	= (1 << 7),	
 	SWP_SCANNING	= (1 << 8),	
 };
 
@@ -138,6 +138,13 @@ struct swap_info_struct {
 	struct file *swap_file;		
 	unsigned int old_block_size;	
 	spinlock_t lock;		
+	atomic_t ra_hits;	
+	unsigned int ra_win;	
+	unsigned long ra_prev_offset;
+#ifdef CONFIG_FRONTSWAP
+	unsigned long *frontswap_map;	
+	atomic_t frontswap_pages;	
+#endif
 };
 
 struct swap_list_t {
@@ -182,6 +189,10 @@ static inline void lru_cache_add_file(struct page *page)
 extern unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 					gfp_t gfp_mask, nodemask_t *mask);
 extern int __isolate_lru_page(struct page *page, isolate_mode_t mode);
+extern int isolate_lru_page(struct page *page);
+#ifdef CONFIG_PROCESS_RECLAIM
+extern unsigned long reclaim_pages_from_list(struct list_head *page_list);
+#endif
 extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem,
 						  gfp_t gfp_mask, bool noswap);
 extern unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
@@ -245,6 +256,7 @@ static inline void mem_cgroup_uncharge_swap(swp_entry_t ent)
 #ifdef CONFIG_SWAP
 extern int swap_readpage(struct page *);
 extern int swap_writepage(struct page *page, struct writeback_control *wbc);
+extern int __swap_writepage(struct page *page, struct writeback_control *wbc);
 extern void end_swap_bio_read(struct bio *bio, int err);
 
 extern struct address_space swapper_space;
@@ -256,11 +268,17 @@ extern void __delete_from_swap_cache(struct page *);
 extern void delete_from_swap_cache(struct page *);
 extern void free_page_and_swap_cache(struct page *);
 extern void free_pages_and_swap_cache(struct page **, int);
-extern struct page *lookup_swap_cache(swp_entry_t);
+extern struct page *lookup_swap_cache(swp_entry_t, struct vm_area_struct *,
+			unsigned long);
 extern struct page *read_swap_cache_async(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern struct page *__read_swap_cache_async(swp_entry_t, gfp_t,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated);
 extern struct page *swapin_readahead(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern struct page *swap_vma_readahead(swp_entry_t, gfp_t,
+			struct vm_area_struct *vma, unsigned long addr);
 
 extern atomic_long_t nr_swap_pages;
 extern long total_swap_pages;
@@ -355,12 +373,19 @@ static inline struct page *swapin_readahead(swp_entry_t swp, gfp_t gfp_mask,
 	return NULL;
 }
 
+static inline struct page *swap_vma_readahead(swp_entry_t swp, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	return NULL;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
 }
 
-static inline struct page *lookup_swap_cache(swp_entry_t swp)
+static inline struct page *lookup_swap_cache(swp_entry_t swp,
+			struct vm_area_struct *vma, unsigned long addr)
 {
 	return NULL;
 }
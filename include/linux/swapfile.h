@@ -0,0 +1,9 @@
+#ifndef _LINUX_SWAPFILE_H
+#define _LINUX_SWAPFILE_H
+
+/*
+ * these were static in swapfile.c but frontswap.c needs them
+ */
+extern struct swap_info_struct *swap_info[];
+
+#endif
@@ -89,6 +89,39 @@ TRACE_EVENT(cpu_frequency_switch_end,
 	TP_printk("cpu_id=%lu", (unsigned long)__entry->cpu_id)
 );
 
+TRACE_EVENT(cpu_frequency_switch_latency,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int start_freq,
+		 unsigned int end_freq, s64 queue_us, s64 switch_us,
+		 s64 total_us),
+
+	TP_ARGS(cpu_id, start_freq, end_freq, queue_us, switch_us, total_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	u32,		start_freq	)
+		__field(	u32,		end_freq	)
+		__field(	s64,		queue_us	)
+		__field(	s64,		switch_us	)
+		__field(	s64,		total_us	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->start_freq = start_freq;
+		__entry->end_freq = end_freq;
+		__entry->queue_us = queue_us;
+		__entry->switch_us = switch_us;
+		__entry->total_us = total_us;
+	),
+
+	TP_printk("cpu_id=%lu start=%lu end=%lu queue_us=%lld switch_us=%lld total_us=%lld",
+		  (unsigned long)__entry->cpu_id,
+		  (unsigned long)__entry->start_freq,
+		  (unsigned long)__entry->end_freq,
+		  __entry->queue_us, __entry->switch_us, __entry->total_us)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
@@ -473,6 +473,9 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p)
 	spin_lock_init(&mm->page_table_lock);
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
+#ifdef CONFIG_KSM
+	mm->ksm_merging_pages = 0;
+#endif
 	mm_init_aio(mm);
 	mm_init_owner(mm, p);
 
@@ -15,45 +15,152 @@
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/seqlock.h>
 
-static DEFINE_PER_CPU(u64, nr_prod_sum);
-static DEFINE_PER_CPU(u64, last_time);
-static DEFINE_PER_CPU(u64, nr);
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
-static s64 last_get_time;
+/*
+ * Per-cpu running integrals of nr_running and nr_iowait over time.
+ * The only writer is sched_update_nr_prod(), which runs under the
+ * runqueue lock of @cpu with interrupts disabled, so the seqcount
+ * needs no lock of its own.  Readers never reset the sums; each
+ * consumer keeps its own previous sample and averages the delta, so
+ * any number of consumers can use windows of different lengths.
+ */
+struct nr_stats_s {
+	seqcount_t seq;
+	u64 nr_prod_sum;
+	u64 iowait_prod_sum;
+	u64 last_time;
+	unsigned long nr;
+};
 
-void sched_get_nr_running_avg(int *avg, int *iowait_avg)
+static DEFINE_PER_CPU(struct nr_stats_s, runqueue_stats);
+
+static DEFINE_PER_CPU(struct sched_nr_avg_cpu, legacy_avg_cpu);
+static struct sched_nr_avg_window legacy_window = {
+	.cpu = &legacy_avg_cpu,
+};
+
+static void sched_read_nr_prod(int cpu, u64 now, u64 *nr_prod,
+			       u64 *iowait_prod)
+{
+	struct nr_stats_s *stats = &per_cpu(runqueue_stats, cpu);
+	unsigned int seq;
+	u64 delta;
+
+	do {
+		seq = read_seqcount_begin(&stats->seq);
+		delta = now > stats->last_time ? now - stats->last_time : 0;
+		*nr_prod = stats->nr_prod_sum + stats->nr * delta;
+		*iowait_prod = stats->iowait_prod_sum +
+				nr_iowait_cpu(cpu) * delta;
+	} while (read_seqcount_retry(&stats->seq, seq));
+}
+
+static u64 sched_nr_avg_sample(struct sched_nr_avg_window *win,
+			       u64 *tmp_avg, u64 *tmp_iowait)
 {
 	int cpu;
 	u64 curr_time = sched_clock();
-	u64 diff = curr_time - last_get_time;
-	u64 tmp_avg = 0, tmp_iowait = 0;
+	u64 diff = curr_time - win->last_time;
+
+	*tmp_avg = 0;
+	*tmp_iowait = 0;
+
+	if ((s64)diff <= 0)
+		return 0;
+
+	win->last_time = curr_time;
+
+	for_each_possible_cpu(cpu) {
+		struct sched_nr_avg_cpu *c = per_cpu_ptr(win->cpu, cpu);
+		u64 nr_prod, iowait_prod;
+		u64 nr_delta, iowait_delta;
+
+		sched_read_nr_prod(cpu, curr_time, &nr_prod, &iowait_prod);
+		nr_delta = nr_prod - c->nr_prod;
+		iowait_delta = iowait_prod - c->iowait_prod;
+		c->nr_prod = nr_prod;
+		c->iowait_prod = iowait_prod;
+
+		c->avg = div64_u64(nr_delta << FSHIFT, diff);
+		c->iowait_avg = div64_u64(iowait_delta << FSHIFT, diff);
+
+		*tmp_avg += nr_delta;
+		*tmp_iowait += iowait_delta;
+	}
+
+	return diff;
+}
+
+/**
+ * sched_nr_avg_window_init - prepare a consumer window
+ * @win: window to initialize
+ *
+ * The first call to sched_nr_avg_window_update() after this reports
+ * the averages since @win was initialized.
+ */
+int sched_nr_avg_window_init(struct sched_nr_avg_window *win)
+{
+	u64 tmp_avg, tmp_iowait;
+
+	memset(win, 0, sizeof(*win));
+	win->cpu = alloc_percpu(struct sched_nr_avg_cpu);
+	if (!win->cpu)
+		return -ENOMEM;
+
+	sched_nr_avg_sample(win, &tmp_avg, &tmp_iowait);
+	return 0;
+}
+EXPORT_SYMBOL(sched_nr_avg_window_init);
+
+void sched_nr_avg_window_destroy(struct sched_nr_avg_window *win)
+{
+	free_percpu(win->cpu);
+	win->cpu = NULL;
+}
+EXPORT_SYMBOL(sched_nr_avg_window_destroy);
+
+/**
+ * sched_nr_avg_window_update - close the current window of @win
+ * @win: consumer window
+ *
+ * Computes the average number of running and iowait tasks since the
+ * previous update of @win, in FIXED_1 units, both summed over all
+ * cpus (win->avg, win->iowait_avg) and per cpu (per_cpu_ptr(win->cpu)).
+ * Never takes a lock that the scheduler fast path takes.
+ *
+ * Returns the length of the window in nanoseconds, or 0 if no time
+ * has elapsed since the previous update.
+ */
+u64 sched_nr_avg_window_update(struct sched_nr_avg_window *win)
+{
+	u64 tmp_avg, tmp_iowait;
+	u64 diff;
+
+	diff = sched_nr_avg_sample(win, &tmp_avg, &tmp_iowait);
+	if (!diff)
+		return 0;
+
+	win->avg = div64_u64(tmp_avg << FSHIFT, diff);
+	win->iowait_avg = div64_u64(tmp_iowait << FSHIFT, diff);
+	win->window_ns = diff;
+
+	return diff;
+}
+EXPORT_SYMBOL(sched_nr_avg_window_update);
+
+void sched_get_nr_running_avg(int *avg, int *iowait_avg)
+{
+	u64 tmp_avg, tmp_iowait;
+	u64 diff;
 
 	*avg = 0;
 	*iowait_avg = 0;
 
+	diff = sched_nr_avg_sample(&legacy_window, &tmp_avg, &tmp_iowait);
 	if (!diff)
 		return;
 
-	last_get_time = curr_time;
-	
-	for_each_possible_cpu(cpu) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
-		tmp_avg += per_cpu(nr, cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		tmp_iowait = per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait +=  nr_iowait_cpu(cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		per_cpu(last_time, cpu) = curr_time;
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
-	}
-
 	*avg = (int)div64_u64(tmp_avg * 100, diff);
 	*iowait_avg = (int)div64_u64(tmp_iowait * 100, diff);
 
@@ -66,20 +173,20 @@ EXPORT_SYMBOL(sched_get_nr_running_avg);
 
 void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 {
-	int diff;
-	s64 curr_time;
-	unsigned long flags;
-
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-	curr_time = sched_clock();
-	diff = curr_time - per_cpu(last_time, cpu);
-	per_cpu(last_time, cpu) = curr_time;
-	per_cpu(nr, cpu) = nr_running + (inc ? 1 : -1);
+	struct nr_stats_s *stats = &per_cpu(runqueue_stats, cpu);
+	u64 curr_time = sched_clock();
+	u64 diff = 0;
 
-	BUG_ON(per_cpu(nr, cpu) < 0);
+	BUG_ON(!inc && !nr_running);
 
-	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
-	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+	write_seqcount_begin(&stats->seq);
+	if (curr_time > stats->last_time) {
+		diff = curr_time - stats->last_time;
+		stats->last_time = curr_time;
+	}
+	stats->nr_prod_sum += nr_running * diff;
+	stats->iowait_prod_sum += nr_iowait_cpu(cpu) * diff;
+	stats->nr = inc ? nr_running + 1 : nr_running - 1;
+	write_seqcount_end(&stats->seq);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
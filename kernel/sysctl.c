@@ -230,6 +230,8 @@ static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int min_kcompactd_order = 1;
+static int max_kcompactd_order = MAX_ORDER - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1183,6 +1185,31 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "kcompactd_order",
+		.data		= &sysctl_kcompactd_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &min_kcompactd_order,
+		.extra2		= &max_kcompactd_order,
+	},
+	{
+		.procname	= "kcompactd_blocks",
+		.data		= &sysctl_kcompactd_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "kcompactd_interval_ms",
+		.data		= &sysctl_kcompactd_interval,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 
 #endif 
 	{
@@ -21,6 +21,7 @@
  
 /* BE VERY CAREFUL IF YOU CHANGE THIS CODE...!  */ 
  
+#include <linux/export.h>
 #include <linux/memcopy.h>
  
 /* 
@@ -124,6 +125,9 @@ do1:
 do0: 
     ((op_t *) dstp)[0] = a1; 
 } 
+#if IS_ENABLED(CONFIG_TEST_MEMCPY)
+EXPORT_SYMBOL(_wordcopy_fwd_aligned);
+#endif
  
 /* 
  * _wordcopy_fwd_dest_aligned -- Copy block beginning at SRCP to block 
@@ -210,6 +214,9 @@ do1:
 do0: 
     ((op_t *) dstp)[0] = MERGE (a2, sh_1, a3, sh_2); 
 } 
+#if IS_ENABLED(CONFIG_TEST_MEMCPY)
+EXPORT_SYMBOL(_wordcopy_fwd_dest_aligned);
+#endif
  
 /* 
  * _wordcopy_bwd_aligned -- Copy block finishing right before 
@@ -0,0 +1,203 @@
+/*
+ * Memory copy primitive speed tests
+ *
+ * Every primitive is run over a sweep of lengths and source/destination
+ * misalignments, and each point is printed as one line of key=value
+ * pairs:
+ *
+ *   test_memcpy: fn=memcpy len=4096 src_off=0 dst_off=0 ns=812345
+ *                bytes=4194304 cyc_per_byte=0.291 gb_per_s=5.163
+ *
+ * (on a single line).  cyc_per_byte is derived from the cpufreq
+ * frequency at the start of the run, so pin the frequency for stable
+ * numbers.  The module never stays loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/cpufreq.h>
+#include <linux/uaccess.h>
+#include <linux/memcopy.h>
+#include <net/checksum.h>
+
+#define TEST_MEMCPY_MAX		(64 * 1024)
+#define TEST_MEMCPY_SLACK	PAGE_SIZE
+
+enum {
+	TEST_MEMCPY,
+	TEST_COPY_PAGE,
+	TEST_COPY_TO_USER,
+	TEST_COPY_FROM_USER,
+	TEST_CSUM_COPY,
+	TEST_MEM_COPY_FWD,
+	TEST_NR,
+};
+
+static const char *test_names[TEST_NR] = {
+	[TEST_MEMCPY]		= "memcpy",
+	[TEST_COPY_PAGE]	= "copy_page",
+	[TEST_COPY_TO_USER]	= "__copy_to_user",
+	[TEST_COPY_FROM_USER]	= "__copy_from_user",
+	[TEST_CSUM_COPY]	= "csum_partial_copy_nocheck",
+	[TEST_MEM_COPY_FWD]	= "mem_copy_fwd",
+};
+
+static const unsigned int test_lens[] __initconst = {
+	16, 64, 256, 1024, 4096, 16384, 65536,
+};
+
+static const struct {
+	unsigned int src;
+	unsigned int dst;
+} test_offs[] __initconst = {
+	{ 0, 0 }, { 4, 0 }, { 0, 4 }, { 1, 0 }, { 0, 1 }, { 3, 7 },
+};
+
+static unsigned int mode = (1 << TEST_NR) - 1;
+module_param(mode, uint, 0);
+MODULE_PARM_DESC(mode, "Bitmask of primitives to test, in the order memcpy, "
+		 "copy_page, __copy_to_user, __copy_from_user, "
+		 "csum_partial_copy_nocheck, mem_copy_fwd");
+
+static unsigned int bytes = 4 * 1024 * 1024;
+module_param(bytes, uint, 0);
+MODULE_PARM_DESC(bytes, "Bytes copied per measurement");
+
+static unsigned int test_khz;
+
+static int __init test_run(int fn, void *dst, void *src, void __user *udst,
+			   void __user *usrc, unsigned int len)
+{
+	unsigned int i;
+	int ret = 0;
+
+	switch (fn) {
+	case TEST_MEMCPY:
+		memcpy(dst, src, len);
+		break;
+	case TEST_COPY_PAGE:
+		for (i = 0; i < len; i += PAGE_SIZE)
+			copy_page(dst + i, src + i);
+		break;
+	case TEST_COPY_TO_USER:
+		ret = __copy_to_user(udst, src, len) ? -EFAULT : 0;
+		break;
+	case TEST_COPY_FROM_USER:
+		ret = __copy_from_user(dst, usrc, len) ? -EFAULT : 0;
+		break;
+	case TEST_CSUM_COPY:
+		csum_partial_copy_nocheck(src, dst, len, 0);
+		break;
+	case TEST_MEM_COPY_FWD:
+		mem_copy_fwd((unsigned long)dst, (unsigned long)src, len);
+		break;
+	}
+	return ret;
+}
+
+/* Prints x / y with three decimals. */
+static void __init test_fixed3(char *buf, size_t size, u64 x, u64 y)
+{
+	u64 milli = y ? div64_u64(x * 1000, y) : 0;
+	u32 frac;
+
+	frac = do_div(milli, 1000);
+	snprintf(buf, size, "%llu.%03u", milli, frac);
+}
+
+static int __init test_point(int fn, void *kbuf, void __user *ubuf,
+			     unsigned int len, unsigned int src_off,
+			     unsigned int dst_off)
+{
+	void *src = kbuf + src_off;
+	void *dst = kbuf + TEST_MEMCPY_MAX + TEST_MEMCPY_SLACK + dst_off;
+	void __user *usrc = ubuf + src_off;
+	void __user *udst = ubuf + TEST_MEMCPY_MAX + TEST_MEMCPY_SLACK + dst_off;
+	unsigned int i, iters = max(bytes / len, 1U);
+	char cpb[24], gbps[24];
+	ktime_t start;
+	u64 ns;
+	int ret;
+
+	/* warm the caches and fault in the user pages */
+	ret = test_run(fn, dst, src, udst, usrc, len);
+	if (ret)
+		return ret;
+
+	start = ktime_get();
+	for (i = 0; i < iters; i++)
+		test_run(fn, dst, src, udst, usrc, len);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	test_fixed3(cpb, sizeof(cpb), div_u64(ns * test_khz, 1000),
+		    (u64)iters * len * 1000);
+	test_fixed3(gbps, sizeof(gbps), (u64)iters * len, ns);
+	printk(KERN_INFO "test_memcpy: fn=%s len=%u src_off=%u dst_off=%u "
+	       "ns=%llu bytes=%llu cyc_per_byte=%s gb_per_s=%s\n",
+	       test_names[fn], len, src_off, dst_off, ns,
+	       (u64)iters * len, cpb, gbps);
+
+	cond_resched();
+	return 0;
+}
+
+static int __init test_memcpy_init(void)
+{
+	size_t size = 2 * (TEST_MEMCPY_MAX + TEST_MEMCPY_SLACK);
+	unsigned long ubuf;
+	void *kbuf;
+	int fn, l, o, ret = 0;
+
+	kbuf = (void *)__get_free_pages(GFP_KERNEL, get_order(size));
+	if (!kbuf)
+		return -ENOMEM;
+	memset(kbuf, 0x5a, size);
+
+	ubuf = vm_mmap(NULL, 0, size, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (IS_ERR_VALUE(ubuf)) {
+		free_pages((unsigned long)kbuf, get_order(size));
+		return (int)ubuf;
+	}
+
+	test_khz = cpufreq_quick_get(raw_smp_processor_id());
+	printk(KERN_INFO "test_memcpy: cpu_khz=%u bytes=%u\n", test_khz, bytes);
+
+	for (fn = 0; fn < TEST_NR && !ret; fn++) {
+		if (!(mode & (1 << fn)))
+			continue;
+		for (l = 0; l < ARRAY_SIZE(test_lens) && !ret; l++) {
+			for (o = 0; o < ARRAY_SIZE(test_offs) && !ret; o++) {
+				if (fn == TEST_COPY_PAGE &&
+				    (test_lens[l] < PAGE_SIZE ||
+				     test_offs[o].src || test_offs[o].dst))
+					continue;
+				ret = test_point(fn, kbuf, (void __user *)ubuf,
+						 test_lens[l], test_offs[o].src,
+						 test_offs[o].dst);
+			}
+		}
+	}
+
+	vm_munmap(ubuf, size);
+	free_pages((unsigned long)kbuf, get_order(size));
+
+	if (ret)
+		return ret;
+	/* nothing to keep loaded; -EAGAIN lets the test be rerun at once */
+	return -EAGAIN;
+}
+module_init(test_memcpy_init);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Memory copy primitive speed tests");
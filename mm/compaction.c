@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -622,6 +624,19 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+/* Free blocks of at least @order in @zone, counted up to @target. */
+static unsigned long zone_free_blocks(struct zone *zone, int order,
+				      unsigned long target)
+{
+	unsigned long blocks = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER && blocks < target; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+
+	return blocks;
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -642,6 +657,13 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	if (cc->target_blocks) {
+		if (zone_free_blocks(zone, cc->order, cc->target_blocks) <
+		    cc->target_blocks)
+			return COMPACT_CONTINUE;
+		return COMPACT_PARTIAL;
+	}
+
 	
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -695,6 +717,9 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	unsigned long end_pfn = zone->zone_start_pfn + zone->spanned_pages;
 
 	ret = compaction_suitable(zone, cc->order);
+	/* one free block of the order is not enough for kcompactd */
+	if (ret == COMPACT_PARTIAL && cc->target_blocks)
+		ret = COMPACT_CONTINUE;
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -922,6 +947,133 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd keeps sysctl_kcompactd_blocks free blocks of
+ * sysctl_kcompactd_order in every zone of its node.  The page allocator
+ * wakes it whenever it takes pages from the buddy lists of a zone that
+ * has fallen below the target, and it then compacts the zone until the
+ * target is met, the scanners meet, or the fragmentation index says the
+ * zone is short of memory rather than fragmented.  After each run it
+ * ignores wakeups for sysctl_kcompactd_interval milliseconds.
+ */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER;
+int sysctl_kcompactd_blocks = 16;
+int sysctl_kcompactd_interval = 500;
+
+void wakeup_kcompactd(struct zone *zone)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+	unsigned long target = ACCESS_ONCE(sysctl_kcompactd_blocks);
+
+	if (!target || pgdat->kcompactd_wake ||
+	    !waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (zone_free_blocks(zone, ACCESS_ONCE(sysctl_kcompactd_order),
+			     target) >= target)
+		return;
+
+	pgdat->kcompactd_wake = true;
+	count_compact_event(KCOMPACTD_WAKE);
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = ACCESS_ONCE(sysctl_kcompactd_order);
+	unsigned long target = ACCESS_ONCE(sysctl_kcompactd_blocks);
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = true,
+			.target_blocks = target,
+		};
+		unsigned long status;
+
+		if (!populated_zone(zone))
+			continue;
+		if (zone_free_blocks(zone, order, target) >= target)
+			continue;
+		if (compaction_deferred(zone, order)) {
+			count_compact_event(KCOMPACTD_SKIP);
+			continue;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+		if (status == COMPACT_SKIPPED) {
+			count_compact_event(KCOMPACTD_SKIP);
+		} else if (zone_free_blocks(zone, order, target) >= target) {
+			count_compact_event(KCOMPACTD_SUCCESS);
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			if (order >= zone->compact_order_failed)
+				zone->compact_order_failed = order + 1;
+		} else {
+			count_compact_event(KCOMPACTD_FAIL);
+			if (status == COMPACT_COMPLETE)
+				defer_compaction(zone, order);
+		}
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     pgdat->kcompactd_wake ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		kcompactd_do_work(pgdat);
+
+		freezable_schedule_timeout_interruptible(
+			msecs_to_jiffies(ACCESS_ONCE(sysctl_kcompactd_interval)));
+		pgdat->kcompactd_wake = false;
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d",
+					       nid);
+		if (IS_ERR(pgdat->kcompactd)) {
+			pr_err("Failed to start kcompactd on node %d\n", nid);
+			pgdat->kcompactd = NULL;
+		}
+	}
+	return 0;
+}
+subsys_initcall(kcompactd_init);
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -57,6 +57,7 @@ static inline void get_page_foll(struct page *page)
 extern unsigned long highest_memmap_pfn;
 
 extern int isolate_lru_page(struct page *page);
+extern void decay_zone_pcp(struct zone *zone, struct per_cpu_pages *pcp);
 extern void putback_lru_page(struct page *page);
 extern unsigned long zone_reclaimable_pages(struct zone *zone);
 extern bool zone_reclaimable(struct zone *zone);
@@ -85,6 +86,7 @@ struct compact_control {
 	int migratetype;		
 	struct zone *zone;
 	bool contended;			
+	unsigned long target_blocks;	/* kcompactd: free blocks of order wanted */
 };
 
 unsigned long
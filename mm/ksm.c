@@ -37,7 +37,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 
-#ifdef CONFIG_KSM_HTC_POLICY
+#if defined(CONFIG_KSM_HTC_POLICY) || defined(CONFIG_KSM_ANDROID)
 #if defined(CONFIG_FB)
 #include <linux/notifier.h>
 #include <linux/fb.h>
@@ -63,6 +63,10 @@ struct mm_slot {
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+#ifdef CONFIG_KSM_ANDROID
+	bool zygote;			/* forked from or by zygote */
+	unsigned long enter_time;	/* jiffies when registered */
+#endif
 };
 
 struct ksm_scan {
@@ -96,6 +100,8 @@ struct rmap_item {
 #define SEQNR_MASK	0x0ff	
 #define UNSTABLE_FLAG	0x100	
 #define STABLE_FLAG	0x200	
+#define VOLATILE_SHIFT	10	/* passes left to skip a page seen changing */
+#define VOLATILE_MASK	(0x3 << VOLATILE_SHIFT)
 
 static struct rb_root root_stable_tree = RB_ROOT;
 static struct rb_root root_unstable_tree = RB_ROOT;
@@ -160,6 +166,39 @@ static char *resume_black_list[] = {
 };
 #endif
 
+#ifdef CONFIG_KSM_ANDROID
+/*
+ * Zygote-derived processes share most of their anonymous memory's
+ * contents, so they are scanned every pass; other registered processes
+ * only every ksm_other_scan_interval passes, and no process before it
+ * has been registered for ksm_min_age_secs.  A page whose checksum
+ * changed is skipped for the next three passes, the most the two
+ * VOLATILE_MASK bits can count down.
+ *
+ * Each batch scans between 1/8 of pages_to_scan and pages_to_scan pages:
+ * a pass that merged at least KSM_YIELD_HIGH pages per thousand scanned
+ * doubles the batch, one below KSM_YIELD_LOW halves it, and once it is at
+ * the minimum doubles the sleep between batches instead.
+ */
+#define KSM_YIELD_HIGH		20
+#define KSM_YIELD_LOW		2
+#define KSM_SLEEP_SHIFT_MAX	4
+#define KSM_LOAD_PAUSE_MSECS	1000
+
+static unsigned int ksm_other_scan_interval = 4;
+static unsigned int ksm_min_age_secs = 30;
+static unsigned int ksm_pause_screen_on = 1;
+static unsigned int ksm_pause_load_percent = 100;
+
+static unsigned int ksm_scan_batch = 100;
+static unsigned int ksm_sleep_shift;
+static unsigned int ksm_pass_yield;
+static unsigned long ksm_pass_scanned;
+static unsigned long ksm_pass_start_sharing;
+static bool ksm_screen_on = IS_ENABLED(CONFIG_FB);
+static bool ksm_load_paused;
+#endif
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -374,6 +413,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -428,6 +468,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -897,6 +938,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	rmap_item->head = stable_node;
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
+	rmap_item->mm->ksm_merging_pages++;
 
 	if (rmap_item->hlist.next)
 		ksm_pages_sharing++;
@@ -931,6 +973,9 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
+#ifdef CONFIG_KSM_ANDROID
+		rmap_item->address |= VOLATILE_MASK;
+#endif
 		return;
 	}
 
@@ -987,6 +1032,89 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+#ifdef CONFIG_KSM_ANDROID
+static bool ksm_skip_mm_slot(struct mm_slot *slot)
+{
+	struct rmap_item *rmap_item;
+
+	if (ksm_test_exit(slot->mm))
+		return false;
+	if (time_before(jiffies, slot->enter_time +
+			msecs_to_jiffies(ksm_min_age_secs * 1000)))
+		goto skip;
+	if (slot->zygote)
+		return false;
+	if (ksm_other_scan_interval &&
+	    !(ksm_scan.seqnr % ksm_other_scan_interval))
+		return false;
+skip:
+	/* the unstable tree is rebuilt every pass; drop this mm's part */
+	for (rmap_item = slot->rmap_list; rmap_item;
+	     rmap_item = rmap_item->rmap_list) {
+		if (rmap_item->address & UNSTABLE_FLAG) {
+			rmap_item->address &= ~(UNSTABLE_FLAG | SEQNR_MASK);
+			ksm_pages_unshared--;
+		}
+	}
+	return true;
+}
+
+static void ksm_pass_done(void)
+{
+	unsigned int min_batch = max(ksm_thread_pages_to_scan >> 3, 1U);
+	long merged = ksm_pages_sharing - ksm_pass_start_sharing;
+
+	ksm_scan.seqnr++;
+
+	ksm_pass_yield = ksm_pass_scanned && merged > 0 ?
+			 merged * 1000 / ksm_pass_scanned : 0;
+	if (ksm_pass_yield >= KSM_YIELD_HIGH) {
+		ksm_scan_batch = min(ksm_scan_batch * 2,
+				     ksm_thread_pages_to_scan);
+		ksm_sleep_shift = 0;
+	} else if (ksm_pass_yield < KSM_YIELD_LOW) {
+		if (ksm_scan_batch > min_batch)
+			ksm_scan_batch = max(ksm_scan_batch / 2, min_batch);
+		else if (ksm_sleep_shift < KSM_SLEEP_SHIFT_MAX)
+			ksm_sleep_shift++;
+	}
+
+	ksm_pass_scanned = 0;
+	ksm_pass_start_sharing = ksm_pages_sharing;
+}
+
+static bool ksm_load_high(void)
+{
+	unsigned long load;
+
+	if (!ksm_pause_load_percent)
+		return false;
+
+	load = (avenrun[0] * 100) >> FSHIFT;
+	return load > ksm_pause_load_percent * num_online_cpus();
+}
+
+static unsigned int ksm_sleep_millisecs(void)
+{
+	if (ksm_load_paused)
+		return KSM_LOAD_PAUSE_MSECS;
+	return ksm_thread_sleep_millisecs << ksm_sleep_shift;
+}
+
+static bool ksm_zygote_task(struct task_struct *task)
+{
+	bool ret;
+
+	if (!strncmp(task->comm, "zygote", 6))
+		return true;
+
+	rcu_read_lock();
+	ret = !strncmp(rcu_dereference(task->real_parent)->comm, "zygote", 6);
+	rcu_read_unlock();
+	return ret;
+}
+#endif
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1012,6 +1140,19 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+#ifdef CONFIG_KSM_ANDROID
+		if (ksm_skip_mm_slot(slot)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = list_entry(slot->mm_list.next,
+					  struct mm_slot, mm_list);
+			ksm_scan.mm_slot = slot;
+			spin_unlock(&ksm_mmlist_lock);
+			if (slot != &ksm_mm_head)
+				goto next_mm;
+			ksm_pass_done();
+			return NULL;
+		}
+#endif
 	}
 
 	mm = slot->mm;
@@ -1087,7 +1228,11 @@ next_mm:
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
+#ifdef CONFIG_KSM_ANDROID
+	ksm_pass_done();
+#else
 	ksm_scan.seqnr++;
+#endif
 
 #ifdef CONFIG_KSM_HTC_POLICY
 	
@@ -1106,6 +1251,14 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
+#ifdef CONFIG_KSM_ANDROID
+		ksm_pass_scanned++;
+		if (rmap_item->address & VOLATILE_MASK) {
+			rmap_item->address -= 1 << VOLATILE_SHIFT;
+			put_page(page);
+			continue;
+		}
+#endif
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
@@ -1117,6 +1270,9 @@ static int ksmd_should_run(void)
 	int ret = (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 #ifdef CONFIG_KSM_HTC_POLICY
 	ret = (ksm_enable_smart_scan) ? (ret && ((ksm_run_state == KRS_RUN) || (ksm_run_state == KRS_RESUME))) : (ret);
+#endif
+#ifdef CONFIG_KSM_ANDROID
+	ret = ret && !(ksm_pause_screen_on && ksm_screen_on);
 #endif
 	return ret;
 }
@@ -1245,6 +1401,28 @@ static struct notifier_block ksm_fb_notif =
 #endif
 #endif
 
+#if defined(CONFIG_KSM_ANDROID) && defined(CONFIG_FB)
+static int fb_notifier_callback(struct notifier_block *self,
+				 unsigned long event, void *data)
+{
+	struct fb_event *evdata = data;
+	int *blank;
+
+	if (evdata && evdata->data && event == FB_EVENT_BLANK) {
+		blank = evdata->data;
+		ksm_screen_on = *blank == FB_BLANK_UNBLANK;
+		if (!ksm_screen_on)
+			wake_up_interruptible(&ksm_thread_wait);
+	}
+
+	return 0;
+}
+
+static struct notifier_block ksm_fb_notif = {
+	.notifier_call = fb_notifier_callback,
+};
+#endif
+
 static int ksm_scan_thread(void *nothing)
 {
 	set_freezable();
@@ -1261,6 +1439,11 @@ static int ksm_scan_thread(void *nothing)
 
 			ksm_suspend_check();
 			ksm_scanning_count++;
+#elif defined(CONFIG_KSM_ANDROID)
+			ksm_load_paused = ksm_load_high();
+			if (!ksm_load_paused)
+				ksm_do_scan(min(ksm_scan_batch,
+						ksm_thread_pages_to_scan));
 #else
 			ksm_do_scan(ksm_thread_pages_to_scan);
 #endif
@@ -1270,8 +1453,13 @@ static int ksm_scan_thread(void *nothing)
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
+#ifdef CONFIG_KSM_ANDROID
+			schedule_timeout_interruptible(
+				msecs_to_jiffies(ksm_sleep_millisecs()));
+#else
 			schedule_timeout_interruptible(
 				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+#endif
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1345,6 +1533,11 @@ int __ksm_enter(struct mm_struct *mm)
 
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
 	atomic_inc(&mm->mm_count);
+#ifdef CONFIG_KSM_ANDROID
+	mm_slot->zygote = ksm_zygote_task(current);
+	mm_slot->enter_time = jiffies;
+	ksm_sleep_shift = 0;
+#endif
 
 	if (needs_wakeup)
 		wake_up_interruptible(&ksm_thread_wait);
@@ -1785,6 +1978,69 @@ static ssize_t scanning_count_show(struct kobject *kobj,
 KSM_ATTR_RO(scanning_count);
 #endif
 
+#ifdef CONFIG_KSM_ANDROID
+#define KSM_ANDROID_ATTR(_name, _var)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", _var);				\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	unsigned long val;						\
+	int err;							\
+									\
+	err = strict_strtoul(buf, 10, &val);				\
+	if (err || val > UINT_MAX)					\
+		return -EINVAL;						\
+									\
+	_var = val;							\
+	wake_up_interruptible(&ksm_thread_wait);			\
+	return count;							\
+}									\
+KSM_ATTR(_name)
+
+KSM_ANDROID_ATTR(other_scan_interval, ksm_other_scan_interval);
+KSM_ANDROID_ATTR(min_age_secs, ksm_min_age_secs);
+KSM_ANDROID_ATTR(pause_screen_on, ksm_pause_screen_on);
+KSM_ANDROID_ATTR(pause_load_percent, ksm_pause_load_percent);
+
+static ssize_t scan_batch_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", min(ksm_scan_batch,
+					ksm_thread_pages_to_scan));
+}
+KSM_ATTR_RO(scan_batch);
+
+static ssize_t scan_sleep_millisecs_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_sleep_millisecs());
+}
+KSM_ATTR_RO(scan_sleep_millisecs);
+
+static ssize_t pass_yield_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pass_yield);
+}
+KSM_ATTR_RO(pass_yield);
+
+static ssize_t paused_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	if (ksm_pause_screen_on && ksm_screen_on)
+		return sprintf(buf, "screen_on\n");
+	if (ksm_load_paused)
+		return sprintf(buf, "load\n");
+	return sprintf(buf, "none\n");
+}
+KSM_ATTR_RO(paused);
+#endif
+
 static ssize_t sleep_millisecs_show(struct kobject *kobj,
 				    struct kobj_attribute *attr, char *buf)
 {
@@ -1929,6 +2185,16 @@ static struct attribute *ksm_attrs[] = {
 	&suspend_count_attr.attr,
 	&resume_count_attr.attr,
 	&scanning_count_attr.attr,
+#endif
+#ifdef CONFIG_KSM_ANDROID
+	&other_scan_interval_attr.attr,
+	&min_age_secs_attr.attr,
+	&pause_screen_on_attr.attr,
+	&pause_load_percent_attr.attr,
+	&scan_batch_attr.attr,
+	&scan_sleep_millisecs_attr.attr,
+	&pass_yield_attr.attr,
+	&paused_attr.attr,
 #endif
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1979,7 +2245,7 @@ static int __init ksm_init(void)
 	hotplug_memory_notifier(ksm_memory_callback, 100);
 #endif
 
-#ifdef CONFIG_KSM_HTC_POLICY
+#if defined(CONFIG_KSM_HTC_POLICY) || defined(CONFIG_KSM_ANDROID)
 #if defined(CONFIG_FB)
 	fb_register_client(&ksm_fb_notif);
 #endif
@@ -501,6 +501,45 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+/*
+ * A pcp list that has to refill from or drain to the buddy lists
+ * PCP_BURST_REFILLS << scale times within one vmstat interval doubles its
+ * high and batch, up to PCP_SCALE_MAX doublings, so that allocation and
+ * free bursts take zone->lock less often.  Every interval that is quieter
+ * than that halves them again, and an interval that finds the zone below
+ * its high watermark returns them to the configured values.
+ */
+#define PCP_SCALE_MAX		2
+#define PCP_BURST_REFILLS	8
+
+static void pcp_set_scale(struct per_cpu_pages *pcp, int scale)
+{
+	pcp->scale = scale;
+	pcp->high = pcp->base_high << scale;
+	pcp->batch = pcp->base_batch << scale;
+}
+
+static inline void pcp_lock_zone(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	if (unlikely(!spin_trylock(&zone->lock))) {
+		pcp->lock_contended++;
+		spin_lock(&zone->lock);
+	}
+}
+
+static void pcp_note_refill(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	unsigned long mark;
+
+	if (++pcp->refills < (PCP_BURST_REFILLS << pcp->scale) ||
+	    pcp->scale >= PCP_SCALE_MAX || percpu_pagelist_fraction)
+		return;
+
+	mark = high_wmark_pages(zone) + (pcp->base_high << (pcp->scale + 1));
+	if (zone_watermark_ok(zone, 0, mark, 0, 0))
+		pcp_set_scale(pcp, pcp->scale + 1);
+}
+
 static void free_pcppages_bulk(struct zone *zone, int count,
 					struct per_cpu_pages *pcp)
 {
@@ -509,7 +548,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int to_free = count;
 	int mt = 0;
 
-	spin_lock(&zone->lock);
+	pcp_lock_zone(zone, pcp);
 	zone->pages_scanned = 0;
 
 	while (to_free) {
@@ -940,13 +979,14 @@ retry_reserve :
 	return page;
 }
 
-static int rmqueue_bulk(struct zone *zone, unsigned int order,
-			unsigned long count, struct list_head *list,
-			int migratetype, int cold, int cma)
+static int rmqueue_bulk(struct zone *zone, struct per_cpu_pages *pcp,
+			unsigned int order, unsigned long count,
+			struct list_head *list, int migratetype, int cold,
+			int cma)
 {
 	int mt = migratetype, i;
 
-	spin_lock(&zone->lock);
+	pcp_lock_zone(zone, pcp);
 	for (i = 0; i < count; ++i) {
 		struct page *page;
 		if (cma)
@@ -976,6 +1016,26 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	return i;
 }
 
+void decay_zone_pcp(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (pcp->scale) {
+		if (!zone_watermark_ok(zone, 0, high_wmark_pages(zone), 0, 0))
+			pcp_set_scale(pcp, 0);
+		else if (pcp->refills < (PCP_BURST_REFILLS << pcp->scale))
+			pcp_set_scale(pcp, pcp->scale - 1);
+
+		if (pcp->count > pcp->high) {
+			free_pcppages_bulk(zone, pcp->count - pcp->high, pcp);
+			pcp->count = pcp->high;
+		}
+	}
+	pcp->refills = 0;
+	local_irq_restore(flags);
+}
+
 #ifdef CONFIG_NUMA
 void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 {
@@ -1116,6 +1176,7 @@ void free_hot_cold_page(struct page *page, int cold)
 	if (pcp->count >= pcp->high) {
 		free_pcppages_bulk(zone, pcp->batch, pcp);
 		pcp->count -= pcp->batch;
+		pcp_note_refill(zone, pcp);
 	}
 
 out:
@@ -1213,6 +1274,7 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	unsigned long flags;
 	struct page *page;
 	int cold = !!(gfp_flags & __GFP_COLD);
+	bool buddy_alloc = order != 0;
 
 again:
 	if (likely(order == 0)) {
@@ -1223,12 +1285,17 @@ again:
 		pcp = &this_cpu_ptr(zone->pageset)->pcp;
 		list = &pcp->lists[migratetype];
 		if (list_empty(list)) {
-			pcp->count += rmqueue_bulk(zone, 0,
+			buddy_alloc = true;
+			pcp->alloc_miss++;
+			pcp->count += rmqueue_bulk(zone, pcp, 0,
 					pcp->batch, list,
 					migratetype, cold,
 					gfp_flags & __GFP_CMA);
 			if (unlikely(list_empty(list)))
 				goto failed;
+			pcp_note_refill(zone, pcp);
+		} else {
+			pcp->alloc_hit++;
 		}
 
 		if (cold)
@@ -1258,6 +1325,9 @@ again:
 	zone_statistics(preferred_zone, zone, gfp_flags);
 	local_irq_restore(flags);
 
+	if (buddy_alloc)
+		wakeup_kcompactd(zone);
+
 	VM_BUG_ON(bad_range(zone, page));
 	if (prep_new_page(page, order, gfp_flags))
 		goto again;
@@ -3054,8 +3124,9 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 
 	pcp = &p->pcp;
 	pcp->count = 0;
-	pcp->high = 6 * batch;
-	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_high = 6 * batch;
+	pcp->base_batch = max(1UL, 1 * batch);
+	pcp_set_scale(pcp, 0);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -3067,10 +3138,11 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	struct per_cpu_pages *pcp;
 
 	pcp = &p->pcp;
-	pcp->high = high;
-	pcp->batch = max(1UL, high/4);
+	pcp->base_high = high;
+	pcp->base_batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
-		pcp->batch = PAGE_SHIFT * 8;
+		pcp->base_batch = PAGE_SHIFT * 8;
+	pcp_set_scale(pcp, 0);
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -3487,6 +3559,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat_resize_init(pgdat);
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat->kswapd_max_order = 0;
 	pgdat_page_cgroup_init(pgdat);
 
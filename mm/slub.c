@@ -20,6 +20,8 @@
 #include <linux/fault-inject.h>
 #include <linux/stacktrace.h>
 #include <linux/prefetch.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
 
 #include <trace/events/kmem.h>
 #include <htc_debug/stability/htc_report_meminfo.h>
@@ -129,6 +131,28 @@ static inline void stat(const struct kmem_cache *s, enum stat_item si)
 #endif
 }
 
+static inline u64 stat_time_start(void)
+{
+#ifdef CONFIG_SLUB_STATS
+	return local_clock();
+#else
+	return 0;
+#endif
+}
+
+static inline void stat_time(const struct kmem_cache *s,
+			     enum stat_time_item si, u64 start)
+{
+#ifdef CONFIG_SLUB_STATS
+	struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+	u64 delta = local_clock() - start;
+
+	c->time_ns[si] += delta;
+	if (delta > c->time_max_ns[si])
+		c->time_max_ns[si] = delta;
+#endif
+}
+
 
 int slab_is_available(void)
 {
@@ -1238,6 +1262,10 @@ static inline void add_partial(struct kmem_cache_node *n,
 				struct page *page, int tail)
 {
 	n->nr_partial++;
+#ifdef CONFIG_SLUB_STATS
+	if (n->nr_partial > n->peak_partial)
+		n->peak_partial = n->nr_partial;
+#endif
 	if (tail == DEACTIVATE_TO_TAIL)
 		list_add_tail(&page->lru, &n->partial);
 	else
@@ -1294,6 +1322,7 @@ static void *get_partial_node(struct kmem_cache *s,
 		void *t = acquire_slab(s, n, page, object == NULL);
 		int available;
 
+		stat(s, ALLOC_PARTIAL_WALK);
 		if (!t)
 			break;
 
@@ -1770,9 +1799,11 @@ static inline void *new_slab_objects(struct kmem_cache *s, gfp_t flags,
 {
 	void *object;
 	struct kmem_cache_cpu *c;
+	u64 start = stat_time_start();
 	struct page *page = new_slab(s, flags, node);
 
 	if (page) {
+		stat_time(s, TIME_NEW_SLAB, start);
 		c = __this_cpu_ptr(s->cpu_slab);
 		if (c->page)
 			flush_slab(s, c);
@@ -1818,11 +1849,13 @@ static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
 {
 	void **object;
 	unsigned long flags;
+	u64 start = stat_time_start();
 
 	local_irq_save(flags);
 #ifdef CONFIG_PREEMPT
 	c = this_cpu_ptr(s->cpu_slab);
 #endif
+	stat(s, ALLOC_SLOWPATH);
 
 	if (!c->page)
 		goto new_slab;
@@ -1838,8 +1871,6 @@ redo:
 	if (object)
 		goto load_freelist;
 
-	stat(s, ALLOC_SLOWPATH);
-
 	object = get_freelist(s, c->page);
 
 	if (!object) {
@@ -1853,6 +1884,7 @@ redo:
 load_freelist:
 	c->freelist = get_freepointer(s, object);
 	c->tid = next_tid(c->tid);
+	stat_time(s, TIME_SLOWPATH, start);
 	local_irq_restore(flags);
 	return object;
 
@@ -1878,6 +1910,7 @@ new_slab:
 			if (!(gfpflags & __GFP_NOWARN) && printk_ratelimit())
 				slab_out_of_memory(s, gfpflags, node);
 
+			stat_time(s, TIME_SLOWPATH, start);
 			local_irq_restore(flags);
 			return NULL;
 		}
@@ -1893,6 +1926,7 @@ new_slab:
 	c->freelist = get_freepointer(s, object);
 	deactivate_slab(s, c);
 	c->node = NUMA_NO_NODE;
+	stat_time(s, TIME_SLOWPATH, start);
 	local_irq_restore(flags);
 	return object;
 }
@@ -2228,6 +2262,9 @@ init_kmem_cache_node(struct kmem_cache_node *n, struct kmem_cache *s)
 	atomic_long_set(&n->total_objects, 0);
 	INIT_LIST_HEAD(&n->full);
 #endif
+#ifdef CONFIG_SLUB_STATS
+	n->peak_partial = 0;
+#endif
 }
 
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
@@ -4316,6 +4353,7 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_PARTIAL_WALK, alloc_partial_walk);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4385,6 +4423,7 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_partial_walk_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -4707,3 +4746,165 @@ static int __init slab_proc_init(void)
 }
 module_init(slab_proc_init);
 #endif 
+
+#if defined(CONFIG_SLUB_STATS) && defined(CONFIG_DEBUG_FS)
+static unsigned long sum_stat(struct kmem_cache *s, enum stat_item si)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->stat[si];
+	return sum;
+}
+
+static u64 sum_time(struct kmem_cache *s, enum stat_time_item si,
+		    unsigned long nr, u64 *max_ns)
+{
+	u64 total = 0;
+	int cpu;
+
+	*max_ns = 0;
+	for_each_online_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+		total += c->time_ns[si];
+		*max_ns = max(*max_ns, c->time_max_ns[si]);
+	}
+	return nr ? div64_u64(total, nr) : 0;
+}
+
+static void slub_stats_reset(struct kmem_cache *s)
+{
+	int cpu, node;
+
+	for_each_online_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+		memset(c->stat, 0, sizeof(c->stat));
+		memset(c->time_ns, 0, sizeof(c->time_ns));
+		memset(c->time_max_ns, 0, sizeof(c->time_max_ns));
+	}
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+
+		if (n)
+			n->peak_partial = n->nr_partial;
+	}
+}
+
+static void *slub_stats_start(struct seq_file *m, loff_t *pos)
+{
+	down_read(&slub_lock);
+	if (!*pos)
+		seq_puts(m, "# name            <fastpath> <slowpath> <fast%> "
+			 "<partial_walk> <partial> <peak_partial> "
+			 "<cpu_cmpxchg_fail> <cmpxchg_fail> "
+			 "<slowpath_avg_ns> <slowpath_max_ns> "
+			 "<new_slab> <new_slab_avg_ns> <new_slab_max_ns>\n");
+
+	return seq_list_start(&slab_caches, *pos);
+}
+
+static void *slub_stats_next(struct seq_file *m, void *p, loff_t *pos)
+{
+	return seq_list_next(p, &slab_caches, pos);
+}
+
+static void slub_stats_stop(struct seq_file *m, void *p)
+{
+	up_read(&slub_lock);
+}
+
+static int slub_stats_show(struct seq_file *m, void *p)
+{
+	struct kmem_cache *s = list_entry(p, struct kmem_cache, list);
+	unsigned long fast, slow, new_slab;
+	unsigned long nr_partial = 0, peak_partial = 0;
+	u64 slow_avg, slow_max, slab_avg, slab_max;
+	int node;
+
+	fast = sum_stat(s, ALLOC_FASTPATH);
+	slow = sum_stat(s, ALLOC_SLOWPATH);
+	new_slab = sum_stat(s, ALLOC_SLAB);
+	slow_avg = sum_time(s, TIME_SLOWPATH, slow, &slow_max);
+	slab_avg = sum_time(s, TIME_NEW_SLAB, new_slab, &slab_max);
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+
+		if (!n)
+			continue;
+		nr_partial += n->nr_partial;
+		peak_partial += n->peak_partial;
+	}
+
+	seq_printf(m, "%-17s %10lu %10lu %3llu %10lu %6lu %6lu %8lu %8lu",
+		   s->name, fast, slow,
+		   fast + slow ? div64_u64((u64)fast * 100, (u64)fast + slow) : 0,
+		   sum_stat(s, ALLOC_PARTIAL_WALK), nr_partial, peak_partial,
+		   sum_stat(s, CMPXCHG_DOUBLE_CPU_FAIL),
+		   sum_stat(s, CMPXCHG_DOUBLE_FAIL));
+	seq_printf(m, " %8llu %10llu %8lu %8llu %10llu\n",
+		   slow_avg, slow_max, new_slab, slab_avg, slab_max);
+	return 0;
+}
+
+static const struct seq_operations slub_stats_op = {
+	.start = slub_stats_start,
+	.next = slub_stats_next,
+	.stop = slub_stats_stop,
+	.show = slub_stats_show,
+};
+
+static int slub_stats_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &slub_stats_op);
+}
+
+/*
+ * Writing "0" resets the statistics of every cache, writing a cache name
+ * resets only that cache.
+ */
+static ssize_t slub_stats_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	char buf[64], *name;
+	struct kmem_cache *s;
+	int ret = -EINVAL;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	name = strim(buf);
+
+	down_read(&slub_lock);
+	list_for_each_entry(s, &slab_caches, list) {
+		if (!strcmp(name, "0") || !strcmp(name, s->name)) {
+			slub_stats_reset(s);
+			ret = count;
+		}
+	}
+	up_read(&slub_lock);
+	return ret;
+}
+
+static const struct file_operations slub_stats_fops = {
+	.open		= slub_stats_open,
+	.read		= seq_read,
+	.write		= slub_stats_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init slub_stats_debugfs_init(void)
+{
+	debugfs_create_file("slub_stats", S_IRUSR | S_IWUSR, NULL, NULL,
+			    &slub_stats_fops);
+	return 0;
+}
+late_initcall(slub_stats_debugfs_init);
+#endif
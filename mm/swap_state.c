@@ -11,6 +11,7 @@
 #include <linux/kernel_stat.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/swapfile.h>
 #include <linux/init.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
@@ -194,25 +195,69 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
-struct page * lookup_swap_cache(swp_entry_t entry)
+/*
+ * Each VMA keeps the address of its last swap fault, the readahead window
+ * used for it and the number of readahead pages hit since, packed in one
+ * word: the address in the page frame bits, the window and the hits in
+ * the offset bits below it.
+ */
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+#define SWAP_RA_VMA_ORDER_MAX	4
+#define SWAP_RA_VMA_MAX		(1 << SWAP_RA_VMA_ORDER_MAX)
+
+struct page * lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+				unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			atomic_inc(&swap_info[swp_type(entry)]->ra_hits);
+			if (vma) {
+				unsigned long ra_val;
+				unsigned int hits;
+
+				ra_val = atomic_long_read(&vma->swap_readahead_info);
+				hits = SWAP_RA_HITS(ra_val);
+				if (hits < SWAP_RA_HITS_MAX)
+					hits++;
+				atomic_long_set(&vma->swap_readahead_info,
+						SWAP_RA_VAL(addr, SWAP_RA_WIN(ra_val),
+							    hits));
+			}
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
+
 	do {
 		found_page = find_get_page(&swapper_space, entry.val);
 		if (found_page)
@@ -245,7 +290,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		if (likely(!err)) {
 			radix_tree_preload_end();
 			lru_cache_add_anon(new_page);
-			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -259,15 +304,95 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_was_allocated;
+	struct page *page;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_was_allocated);
+	if (page_was_allocated)
+		swap_readpage(page);
+	return page;
+}
+
+/*
+ * Size the next readahead window from the readahead pages hit since the
+ * last one: grow it while they keep being used, collapse it to the
+ * faulting page when none were and the faults are not sequential, but
+ * never shrink it by more than half in one step.
+ */
+static unsigned int __swapin_nr_pages(unsigned long prev, unsigned long offset,
+				      unsigned int hits, unsigned int max_pages,
+				      unsigned int prev_win)
+{
+	unsigned int pages, last_ra;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		if (offset != prev + 1 && offset != prev - 1)
+			pages = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	last_ra = prev_win / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+
+	return pages;
+}
+
+static unsigned long swapin_nr_pages(struct swap_info_struct *si,
+				     unsigned long offset)
+{
+	unsigned int hits, pages, max_pages;
+
+	max_pages = 1 << ACCESS_ONCE(page_cluster);
+	if (max_pages <= 1)
+		return 1;
+
+	hits = atomic_xchg(&si->ra_hits, 0);
+	pages = __swapin_nr_pages(ACCESS_ONCE(si->ra_prev_offset), offset, hits,
+				  max_pages, ACCESS_ONCE(si->ra_win));
+	ACCESS_ONCE(si->ra_prev_offset) = offset;
+	ACCESS_ONCE(si->ra_win) = pages;
+
+	return pages;
+}
+
+static void swap_ra_read(struct page *page, bool readahead)
+{
+	swap_readpage(page);
+	if (readahead) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+}
+
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
+	struct swap_info_struct *si = swap_info[swp_type(entry)];
 	struct page *page;
-	unsigned long offset = swp_offset(entry);
+	unsigned long entry_offset = swp_offset(entry);
+	unsigned long offset = entry_offset;
 	unsigned long start_offset, end_offset;
-	unsigned long mask = (1UL << page_cluster) - 1;
+	unsigned long mask;
+	bool page_allocated;
+
+	mask = swapin_nr_pages(si, offset) - 1;
+	if (!mask)
+		goto skip;
 
-	
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
 	if (!start_offset)	
@@ -275,12 +400,107 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+					       gfp_mask, vma, addr,
+					       &page_allocated);
 		if (!page)
 			continue;
+		if (page_allocated)
+			swap_ra_read(page, offset != entry_offset);
 		page_cache_release(page);
 	}
 	lru_add_drain();	
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * Read ahead the swap entries mapped next to the faulting address rather
+ * than the ones stored next to its slot.  The window follows the
+ * direction of the faults when they are sequential and is centred on the
+ * fault otherwise; it never leaves the VMA or the page table of the fault.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long faddr)
+{
+	struct swap_info_struct *si = swap_info[swp_type(fentry)];
+	unsigned long ra_val, fpfn, ppfn, start, end, lo, hi, pfn;
+	unsigned int max_win, win, hits, prev_win, i;
+	pte_t ptes[SWAP_RA_VMA_MAX], *pte;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	struct page *page;
+	bool page_allocated;
+
+	if (!(si->flags & SWP_VMA_RA))
+		return swapin_readahead(fentry, gfp_mask, vma, faddr);
+
+	faddr &= PAGE_MASK;
+	max_win = 1 << min_t(unsigned int, ACCESS_ONCE(page_cluster),
+			     SWAP_RA_VMA_ORDER_MAX);
+	if (max_win == 1)
+		goto skip;
+
+	fpfn = faddr >> PAGE_SHIFT;
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	ppfn = SWAP_RA_ADDR(ra_val) >> PAGE_SHIFT;
+	hits = SWAP_RA_HITS(ra_val);
+	prev_win = SWAP_RA_WIN(ra_val);
+	win = __swapin_nr_pages(ppfn, fpfn, hits, max_win, prev_win);
+	atomic_long_set(&vma->swap_readahead_info, SWAP_RA_VAL(faddr, win, 0));
+	if (win == 1)
+		goto skip;
+
+	lo = max(vma->vm_start, faddr & PMD_MASK) >> PAGE_SHIFT;
+	hi = (min(vma->vm_end - 1, (faddr & PMD_MASK) + PMD_SIZE - 1) >>
+	      PAGE_SHIFT) + 1;
+	if (fpfn == ppfn + 1)
+		start = fpfn;
+	else if (fpfn == ppfn - 1)
+		start = fpfn - min(fpfn - lo, (unsigned long)win - 1);
+	else
+		start = fpfn - min(fpfn - lo, (unsigned long)(win - 1) / 2);
+	end = min(start + win, hi);
+
+	pgd = pgd_offset(vma->vm_mm, faddr);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		goto skip;
+	pud = pud_offset(pgd, faddr);
+	if (pud_none(*pud) || pud_bad(*pud))
+		goto skip;
+	pmd = pmd_offset(pud, faddr);
+	if (pmd_none(*pmd) || pmd_bad(*pmd))
+		goto skip;
+
+	/*
+	 * The ptes are sampled without the page table lock; a stale one at
+	 * worst reads a slot nobody wants, swapcache_prepare() catches
+	 * freed ones.
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < end - start; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0, pfn = start; pfn < end; i++, pfn++) {
+		swp_entry_t entry;
+
+		if (!is_swap_pte(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = __read_swap_cache_async(entry, gfp_mask, vma,
+					       pfn << PAGE_SHIFT,
+					       &page_allocated);
+		if (!page)
+			continue;
+		if (page_allocated)
+			swap_ra_read(page, pfn != fpfn);
+		page_cache_release(page);
+	}
+	lru_add_drain();
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, faddr);
+}
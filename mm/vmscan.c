@@ -748,6 +748,54 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim pages isolated from a process' page tables regardless of their
+ * referenced bits.  The pages may come from any zone; pages that cannot
+ * be reclaimed go back on the LRU.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	unsigned long nr_reclaimed = 0;
+	unsigned long dummy1, dummy2;
+	struct page *page, *next;
+	LIST_HEAD(zone_pages);
+
+	while (!list_empty(page_list)) {
+		struct zone *zone = page_zone(lru_to_page(page_list));
+		unsigned long nr_isolated[2] = { 0, };
+
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			nr_isolated[page_is_file_cache(page)]++;
+			list_move(&page->lru, &zone_pages);
+		}
+
+		nr_reclaimed += shrink_page_list(&zone_pages, zone, &sc,
+						 TTU_UNMAP|TTU_IGNORE_ACCESS,
+						 &dummy1, &dummy2, true);
+		mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_isolated[0]);
+		mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_isolated[1]);
+
+		while (!list_empty(&zone_pages)) {
+			page = lru_to_page(&zone_pages);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+	}
+
+	return nr_reclaimed;
+}
+#endif
+
 int __isolate_lru_page(struct page *page, isolate_mode_t mode)
 {
 	int ret = -EINVAL;
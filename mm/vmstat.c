@@ -329,6 +329,7 @@ void refresh_cpu_vm_stats(int cpu)
 #endif
 			}
 		cond_resched();
+		decay_zone_pcp(zone, &p->pcp);
 #ifdef CONFIG_NUMA
 		if (!p->expire || !p->pcp.count)
 			continue;
@@ -596,6 +597,10 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_skip",
+	"compact_daemon_success",
+	"compact_daemon_fail",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -618,6 +623,10 @@ const char * const vmstat_text[] = {
 	"thp_collapse_alloc_failed",
 	"thp_split",
 #endif
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
 
 #endif 
 };
@@ -828,11 +837,19 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              scale: %i"
+			   "\n              hit:   %lu"
+			   "\n              miss:  %lu"
+			   "\n              contended: %lu",
 			   i,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
-			   pageset->pcp.batch);
+			   pageset->pcp.batch,
+			   pageset->pcp.scale,
+			   pageset->pcp.alloc_hit,
+			   pageset->pcp.alloc_miss,
+			   pageset->pcp.lock_contended);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -0,0 +1,571 @@
+/*
+ * zswap.c - compressed swap cache backed by zsmalloc
+ *
+ * Pages handed to swap_writepage() are compressed with LZO and kept in a
+ * zsmalloc pool instead of being written to the swap device.  When the
+ * pool reaches its limit, stores are refused and a worker writes the
+ * least recently used entries back to the real device until the pool is
+ * below the limit again.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/frontswap.h>
+#include <linux/rbtree.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/pagemap.h>
+#include <linux/writeback.h>
+#include <linux/workqueue.h>
+#include <linux/lzo.h>
+#include <linux/debugfs.h>
+#include <linux/zsmalloc.h>
+
+static atomic_t zswap_stored_pages = ATOMIC_INIT(0);
+
+static u64 zswap_pool_limit_hit;
+static u64 zswap_written_back_pages;
+static u64 zswap_writeback_skipped;
+static u64 zswap_reject_compress_poor;
+static u64 zswap_reject_alloc_fail;
+static u64 zswap_reject_kmemcache_fail;
+static u64 zswap_duplicate_entry;
+static u64 zswap_loads;
+
+static bool zswap_enabled = 1;
+module_param_named(enabled, zswap_enabled, bool, 0444);
+
+static unsigned int zswap_max_pool_percent = 20;
+module_param_named(max_pool_percent, zswap_max_pool_percent, uint, 0644);
+
+/* Pages that compress worse than this go straight to the device. */
+#define ZSWAP_MAX_COMPRESSED	(PAGE_SIZE * 3 / 4)
+
+#define ZSWAP_POOL_GFP		(__GFP_NORETRY | __GFP_NOWARN | __GFP_HIGHMEM)
+
+struct zswap_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	unsigned type;
+	pgoff_t offset;
+	int refcount;
+	unsigned int length;
+	unsigned long handle;
+};
+
+/*
+ * One tree per swap device.  The lock covers the rbtree, the LRU and the
+ * entry refcounts.
+ */
+struct zswap_tree {
+	struct rb_root rbroot;
+	struct list_head lru;
+	spinlock_t lock;
+};
+
+static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
+static struct zs_pool *zswap_pool;
+static struct kmem_cache *zswap_entry_cache;
+
+static DEFINE_PER_CPU(u8 *, zswap_dstmem);
+static DEFINE_PER_CPU(void *, zswap_workmem);
+
+static void zswap_writeback_fn(struct work_struct *work);
+static DECLARE_WORK(zswap_writeback_work, zswap_writeback_fn);
+
+static unsigned long zswap_pool_pages(void)
+{
+	return zs_get_total_size_bytes(zswap_pool) >> PAGE_SHIFT;
+}
+
+static unsigned long zswap_max_pool_pages(void)
+{
+	return totalram_pages * zswap_max_pool_percent / 100;
+}
+
+static bool zswap_is_full(void)
+{
+	return zswap_pool_pages() >= zswap_max_pool_pages();
+}
+
+static struct zswap_entry *zswap_entry_alloc(gfp_t gfp)
+{
+	struct zswap_entry *entry;
+
+	entry = kmem_cache_alloc(zswap_entry_cache, gfp);
+	if (!entry)
+		return NULL;
+	RB_CLEAR_NODE(&entry->rbnode);
+	INIT_LIST_HEAD(&entry->lru);
+	entry->refcount = 1;
+	return entry;
+}
+
+static void zswap_free_entry(struct zswap_entry *entry)
+{
+	zs_free(zswap_pool, entry->handle);
+	kmem_cache_free(zswap_entry_cache, entry);
+	atomic_dec(&zswap_stored_pages);
+}
+
+/* caller must hold the tree lock */
+static void zswap_entry_get(struct zswap_entry *entry)
+{
+	entry->refcount++;
+}
+
+/* caller must hold the tree lock */
+static void zswap_entry_put(struct zswap_entry *entry)
+{
+	if (--entry->refcount == 0)
+		zswap_free_entry(entry);
+}
+
+static struct zswap_entry *zswap_rb_search(struct rb_root *root,
+					   pgoff_t offset)
+{
+	struct rb_node *node = root->rb_node;
+	struct zswap_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zswap_entry, rbnode);
+		if (entry->offset > offset)
+			node = node->rb_left;
+		else if (entry->offset < offset)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+static void zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct zswap_entry *myentry;
+
+	while (*link) {
+		parent = *link;
+		myentry = rb_entry(parent, struct zswap_entry, rbnode);
+		if (myentry->offset > entry->offset)
+			link = &(*link)->rb_left;
+		else
+			link = &(*link)->rb_right;
+	}
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, root);
+}
+
+/* caller must hold the tree lock; drops the tree's reference */
+static void zswap_erase(struct zswap_tree *tree, struct zswap_entry *entry)
+{
+	rb_erase(&entry->rbnode, &tree->rbroot);
+	RB_CLEAR_NODE(&entry->rbnode);
+	list_del_init(&entry->lru);
+	zswap_entry_put(entry);
+}
+
+static void zswap_decompress(struct zswap_entry *entry, struct page *page)
+{
+	size_t dlen = PAGE_SIZE;
+	u8 *src, *dst;
+	int ret;
+
+	src = zs_map_object(zswap_pool, entry->handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	ret = lzo1x_decompress_safe(src, entry->length, dst, &dlen);
+	kunmap_atomic(dst);
+	zs_unmap_object(zswap_pool, entry->handle);
+	BUG_ON(ret != LZO_E_OK || dlen != PAGE_SIZE);
+}
+
+/*
+ * Decompress an entry into a fresh swap cache page and send that to the
+ * device.  If the page is already in the swap cache the entry is still
+ * backing it, so it is left alone.
+ */
+static int zswap_writeback_entry(struct zswap_tree *tree,
+				 struct zswap_entry *entry)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	swp_entry_t swpentry = swp_entry(entry->type, entry->offset);
+	bool page_was_allocated;
+	struct page *page;
+
+	page = __read_swap_cache_async(swpentry, GFP_KERNEL, NULL, 0,
+				       &page_was_allocated);
+	if (!page)
+		return -ENOMEM;
+	if (!page_was_allocated) {
+		page_cache_release(page);
+		return -EEXIST;
+	}
+
+	/*
+	 * With the page locked in the swap cache the slot can no longer be
+	 * freed or stored again, but it may have been reused since the entry
+	 * was picked; then the new contents are read the ordinary way.
+	 */
+	spin_lock(&tree->lock);
+	if (zswap_rb_search(&tree->rbroot, entry->offset) != entry) {
+		spin_unlock(&tree->lock);
+		swap_readpage(page);
+		page_cache_release(page);
+		return -EEXIST;
+	}
+	spin_unlock(&tree->lock);
+
+	zswap_decompress(entry, page);
+	SetPageUptodate(page);
+
+	spin_lock(&tree->lock);
+	zswap_erase(tree, entry);
+	spin_unlock(&tree->lock);
+
+	SetPageReclaim(page);
+	__swap_writepage(page, &wbc);
+	page_cache_release(page);
+	return 0;
+}
+
+static int zswap_writeback_one(void)
+{
+	static unsigned next_type;
+	struct zswap_entry *entry = NULL;
+	struct zswap_tree *tree;
+	unsigned i, type;
+	int ret;
+
+	for (i = 0; i < MAX_SWAPFILES; i++) {
+		type = (next_type + i) % MAX_SWAPFILES;
+		tree = zswap_trees[type];
+		if (!tree)
+			continue;
+		spin_lock(&tree->lock);
+		if (!list_empty(&tree->lru)) {
+			entry = list_entry(tree->lru.prev, struct zswap_entry,
+					   lru);
+			/* to the head, so a skipped entry is not retried at once */
+			list_move(&entry->lru, &tree->lru);
+			zswap_entry_get(entry);
+		}
+		spin_unlock(&tree->lock);
+		if (entry)
+			break;
+	}
+	if (!entry)
+		return -ENOENT;
+	next_type = type + 1;
+
+	ret = zswap_writeback_entry(tree, entry);
+	if (ret)
+		zswap_writeback_skipped++;
+	else
+		zswap_written_back_pages++;
+
+	spin_lock(&tree->lock);
+	zswap_entry_put(entry);
+	spin_unlock(&tree->lock);
+	return 0;
+}
+
+/* write back until the pool is 1/16 below its limit */
+static void zswap_writeback_fn(struct work_struct *work)
+{
+	unsigned long max = zswap_max_pool_pages();
+	unsigned long target = max - (max >> 4);
+	unsigned long budget = atomic_read(&zswap_stored_pages);
+
+	while (budget-- && zswap_pool_pages() > target) {
+		if (zswap_writeback_one())
+			break;
+		cond_resched();
+	}
+}
+
+static int zswap_frontswap_put_page(unsigned type, pgoff_t offset,
+				    struct page *page)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entry, *dupentry;
+	size_t dlen;
+	u8 *src, *dst, *buf;
+	unsigned long handle;
+	int ret;
+
+	if (!tree)
+		return -ENODEV;
+
+	/* drop any older copy first: a failed store must leave nothing */
+	spin_lock(&tree->lock);
+	dupentry = zswap_rb_search(&tree->rbroot, offset);
+	if (dupentry) {
+		zswap_duplicate_entry++;
+		zswap_erase(tree, dupentry);
+	}
+	spin_unlock(&tree->lock);
+
+	if (zswap_is_full()) {
+		zswap_pool_limit_hit++;
+		queue_work(system_unbound_wq, &zswap_writeback_work);
+		return -ENOMEM;
+	}
+
+	entry = zswap_entry_alloc(GFP_NOIO | __GFP_NOWARN);
+	if (!entry) {
+		zswap_reject_kmemcache_fail++;
+		return -ENOMEM;
+	}
+
+	dst = get_cpu_var(zswap_dstmem);
+	src = kmap_atomic(page);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &dlen,
+			       __get_cpu_var(zswap_workmem));
+	kunmap_atomic(src);
+	if (ret != LZO_E_OK) {
+		ret = -EINVAL;
+		goto putcpu;
+	}
+	if (dlen > ZSWAP_MAX_COMPRESSED) {
+		zswap_reject_compress_poor++;
+		ret = -E2BIG;
+		goto putcpu;
+	}
+
+	handle = zs_malloc(zswap_pool, dlen);
+	if (!handle) {
+		zswap_reject_alloc_fail++;
+		ret = -ENOMEM;
+		goto putcpu;
+	}
+	buf = zs_map_object(zswap_pool, handle, ZS_MM_WO);
+	memcpy(buf, dst, dlen);
+	zs_unmap_object(zswap_pool, handle);
+	put_cpu_var(zswap_dstmem);
+
+	entry->type = type;
+	entry->offset = offset;
+	entry->handle = handle;
+	entry->length = dlen;
+	atomic_inc(&zswap_stored_pages);
+
+	spin_lock(&tree->lock);
+	dupentry = zswap_rb_search(&tree->rbroot, offset);
+	if (dupentry) {
+		zswap_duplicate_entry++;
+		zswap_erase(tree, dupentry);
+	}
+	zswap_rb_insert(&tree->rbroot, entry);
+	list_add(&entry->lru, &tree->lru);
+	spin_unlock(&tree->lock);
+	return 0;
+
+putcpu:
+	put_cpu_var(zswap_dstmem);
+	kmem_cache_free(zswap_entry_cache, entry);
+	return ret;
+}
+
+static int zswap_frontswap_get_page(unsigned type, pgoff_t offset,
+				    struct page *page)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entry;
+
+	if (!tree)
+		return -1;
+
+	spin_lock(&tree->lock);
+	entry = zswap_rb_search(&tree->rbroot, offset);
+	if (!entry) {
+		spin_unlock(&tree->lock);
+		return -1;
+	}
+	zswap_entry_get(entry);
+	spin_unlock(&tree->lock);
+
+	zswap_decompress(entry, page);
+	zswap_loads++;
+
+	spin_lock(&tree->lock);
+	if (!list_empty(&entry->lru))
+		list_move(&entry->lru, &tree->lru);
+	zswap_entry_put(entry);
+	spin_unlock(&tree->lock);
+	return 0;
+}
+
+static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entry;
+
+	if (!tree)
+		return;
+
+	spin_lock(&tree->lock);
+	entry = zswap_rb_search(&tree->rbroot, offset);
+	if (entry)
+		zswap_erase(tree, entry);
+	spin_unlock(&tree->lock);
+}
+
+static void zswap_frontswap_invalidate_area(unsigned type)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct rb_node *node;
+
+	if (!tree)
+		return;
+
+	spin_lock(&tree->lock);
+	while ((node = rb_first(&tree->rbroot)))
+		zswap_erase(tree, rb_entry(node, struct zswap_entry, rbnode));
+	spin_unlock(&tree->lock);
+}
+
+static void zswap_frontswap_init(unsigned type)
+{
+	struct zswap_tree *tree;
+
+	if (zswap_trees[type])
+		return;
+
+	tree = kzalloc(sizeof(*tree), GFP_KERNEL);
+	if (!tree) {
+		pr_err("zswap: alloc failed, zswap disabled for swap type %d\n",
+		       type);
+		return;
+	}
+	tree->rbroot = RB_ROOT;
+	INIT_LIST_HEAD(&tree->lru);
+	spin_lock_init(&tree->lock);
+	zswap_trees[type] = tree;
+}
+
+static struct frontswap_ops zswap_frontswap_ops = {
+	.put_page = zswap_frontswap_put_page,
+	.get_page = zswap_frontswap_get_page,
+	.invalidate_page = zswap_frontswap_invalidate_page,
+	.invalidate_area = zswap_frontswap_invalidate_area,
+	.init = zswap_frontswap_init
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int zswap_pool_pages_get(void *data, u64 *val)
+{
+	*val = zswap_pool_pages();
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(zswap_pool_pages_fops, zswap_pool_pages_get,
+			NULL, "%llu\n");
+
+static int zswap_stored_pages_get(void *data, u64 *val)
+{
+	*val = atomic_read(&zswap_stored_pages);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(zswap_stored_pages_fops, zswap_stored_pages_get,
+			NULL, "%llu\n");
+
+static int __init zswap_debugfs_init(void)
+{
+	struct dentry *root = debugfs_create_dir("zswap", NULL);
+
+	if (root == NULL)
+		return -ENXIO;
+	debugfs_create_file("pool_pages", S_IRUGO, root, NULL,
+			    &zswap_pool_pages_fops);
+	debugfs_create_file("stored_pages", S_IRUGO, root, NULL,
+			    &zswap_stored_pages_fops);
+	debugfs_create_u64("loads", S_IRUGO, root, &zswap_loads);
+	debugfs_create_u64("pool_limit_hit", S_IRUGO, root,
+			   &zswap_pool_limit_hit);
+	debugfs_create_u64("written_back_pages", S_IRUGO, root,
+			   &zswap_written_back_pages);
+	debugfs_create_u64("writeback_skipped", S_IRUGO, root,
+			   &zswap_writeback_skipped);
+	debugfs_create_u64("reject_compress_poor", S_IRUGO, root,
+			   &zswap_reject_compress_poor);
+	debugfs_create_u64("reject_alloc_fail", S_IRUGO, root,
+			   &zswap_reject_alloc_fail);
+	debugfs_create_u64("reject_kmemcache_fail", S_IRUGO, root,
+			   &zswap_reject_kmemcache_fail);
+	debugfs_create_u64("duplicate_entry", S_IRUGO, root,
+			   &zswap_duplicate_entry);
+	return 0;
+}
+#else
+static int __init zswap_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static int __init zswap_percpu_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(zswap_dstmem, cpu) = kmalloc(PAGE_SIZE * 2, GFP_KERNEL);
+		per_cpu(zswap_workmem, cpu) = vmalloc(LZO1X_MEM_COMPRESS);
+		if (!per_cpu(zswap_dstmem, cpu) || !per_cpu(zswap_workmem, cpu))
+			goto fail;
+	}
+	return 0;
+
+fail:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zswap_dstmem, cpu));
+		vfree(per_cpu(zswap_workmem, cpu));
+		per_cpu(zswap_dstmem, cpu) = NULL;
+		per_cpu(zswap_workmem, cpu) = NULL;
+	}
+	return -ENOMEM;
+}
+
+static int __init init_zswap(void)
+{
+	if (!zswap_enabled)
+		return 0;
+
+	pr_info("zswap: loading\n");
+	zswap_pool = zs_create_pool(ZSWAP_POOL_GFP);
+	if (!zswap_pool)
+		goto error;
+	zswap_entry_cache = KMEM_CACHE(zswap_entry, 0);
+	if (!zswap_entry_cache)
+		goto cachefail;
+	if (zswap_percpu_init())
+		goto percpufail;
+
+	frontswap_register_ops(&zswap_frontswap_ops);
+	zswap_debugfs_init();
+	return 0;
+
+percpufail:
+	kmem_cache_destroy(zswap_entry_cache);
+cachefail:
+	zs_destroy_pool(zswap_pool);
+error:
+	pr_err("zswap: init failed\n");
+	zswap_enabled = 0;
+	return -ENOMEM;
+}
+late_initcall(init_zswap);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Compressed cache for swap pages");
@@ -25,6 +25,7 @@
 #include "rmnet_data_handlers.h"
 #include "rmnet_data_vnd.h"
 #include "rmnet_data_private.h"
+#include "rmnet_map.h"
 
 static struct sock *nl_socket_handle;
 #define RMNET_KERNEL_PRE_3_8
@@ -70,6 +71,7 @@ int rmnet_config_init(void)
 void rmnet_config_exit(void)
 {
 	netlink_kernel_release(nl_socket_handle);
+	rmnet_map_debugfs_exit();
 }
 
 
@@ -265,6 +267,54 @@ static inline void _rmnet_netlink_get_link_ingress_data_format
 	resp_rmnet->data_format.flags = config->ingress_data_format;
 }
 
+static void _rmnet_netlink_set_link_rps_config
+					(struct rmnet_nl_msg_s *rmnet_header,
+					 struct rmnet_nl_msg_s *resp_rmnet)
+{
+	struct net_device *dev;
+	_RMNET_NETLINK_NULL_CHECKS();
+
+	resp_rmnet->crd = RMNET_NETLINK_MSG_RETURNCODE;
+
+	dev = dev_get_by_name(&init_net, rmnet_header->rps_config.dev);
+	if (!dev) {
+		resp_rmnet->return_code = RMNET_CONFIG_NO_SUCH_DEVICE;
+		return;
+	}
+
+	resp_rmnet->return_code =
+		rmnet_set_rps_config(dev, rmnet_header->rps_config.cpu_mask);
+	dev_put(dev);
+}
+
+static void _rmnet_netlink_get_link_rps_config
+					(struct rmnet_nl_msg_s *rmnet_header,
+					 struct rmnet_nl_msg_s *resp_rmnet)
+{
+	struct net_device *dev;
+	struct rmnet_phys_ep_conf_s *config;
+	_RMNET_NETLINK_NULL_CHECKS();
+	resp_rmnet->crd = RMNET_NETLINK_MSG_RETURNCODE;
+
+	dev = dev_get_by_name(&init_net, rmnet_header->rps_config.dev);
+	if (!dev) {
+		resp_rmnet->return_code = RMNET_CONFIG_NO_SUCH_DEVICE;
+		return;
+	}
+
+	config = _rmnet_get_phys_ep_config(dev);
+	if (!config) {
+		resp_rmnet->return_code = RMNET_CONFIG_INVALID_REQUEST;
+		dev_put(dev);
+		return;
+	}
+
+	resp_rmnet->crd = RMNET_NETLINK_MSG_RETURNDATA;
+	resp_rmnet->arg_length = RMNET_NL_MSG_SIZE(rps_config);
+	resp_rmnet->rps_config.cpu_mask = config->rps_mask;
+	dev_put(dev);
+}
+
 void rmnet_config_netlink_msg_handler(struct sk_buff *skb)
 {
 	struct nlmsghdr *nlmsg_header, *resp_nlmsg;
@@ -343,6 +393,14 @@ void rmnet_config_netlink_msg_handler(struct sk_buff *skb)
 		_rmnet_netlink_set_logical_ep_config(rmnet_header, resp_rmnet);
 		break;
 
+	case RMNET_NETLINK_SET_LINK_RPS_CONFIG:
+		_rmnet_netlink_set_link_rps_config(rmnet_header, resp_rmnet);
+		break;
+
+	case RMNET_NETLINK_GET_LINK_RPS_CONFIG:
+		_rmnet_netlink_get_link_rps_config(rmnet_header, resp_rmnet);
+		break;
+
 	case RMNET_NETLINK_NEW_VND:
 		resp_rmnet->crd = RMNET_NETLINK_MSG_RETURNCODE;
 		resp_rmnet->return_code =
@@ -379,10 +437,11 @@ int rmnet_unassociate_network_device(struct net_device *dev)
 	if (!config)
 		return RMNET_CONFIG_UNKNOWN_ERROR;
 
-	kfree(config);
-
 	netdev_rx_handler_unregister(dev);
 
+	rmnet_map_agg_exit(config);
+	kfree(config);
+
 	return RMNET_CONFIG_OK;
 }
 
@@ -433,6 +492,33 @@ int rmnet_set_egress_data_format(struct net_device *dev,
 	return RMNET_CONFIG_OK;
 }
 
+/*
+ * Steers the deaggregated ingress flows of @dev over the cpus set in
+ * @cpu_mask by flow hash; a mask of 0 keeps them on the receiving cpu.
+ */
+int rmnet_set_rps_config(struct net_device *dev, uint32_t cpu_mask)
+{
+	struct rmnet_phys_ep_conf_s *config;
+	ASSERT_RTNL();
+
+	LOGL("%s(%s,0x%08X);", __func__, dev->name, cpu_mask);
+
+	if (!dev)
+		return RMNET_CONFIG_NO_SUCH_DEVICE;
+
+	config = _rmnet_get_phys_ep_config(dev);
+
+	if (!config)
+		return RMNET_CONFIG_INVALID_REQUEST;
+
+	if (cpu_mask & ~cpumask_bits(cpu_possible_mask)[0])
+		return RMNET_CONFIG_BAD_ARGUMENTS;
+
+	config->rps_mask = cpu_mask;
+
+	return RMNET_CONFIG_OK;
+}
+
 int rmnet_associate_network_device(struct net_device *dev)
 {
 	struct rmnet_phys_ep_conf_s *config;
@@ -458,12 +544,14 @@ int rmnet_associate_network_device(struct net_device *dev)
 	memset(config, 0, sizeof(struct rmnet_phys_ep_conf_s));
 	config->dev = dev;
 	spin_lock_init(&config->agg_lock);
+	rmnet_map_agg_init(config);
 
 	rc = netdev_rx_handler_register(dev, rmnet_rx_handler, config);
 
 	if (rc) {
 		LOGM("%s(): netdev_rx_handler_register returns %d\n",
 		     __func__, rc);
+		rmnet_map_agg_exit(config);
 		kfree(config);
 		return RMNET_CONFIG_DEVICE_IN_USE;
 	}
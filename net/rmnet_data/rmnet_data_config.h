@@ -16,11 +16,14 @@
 
 #include <linux/types.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
 #define _RMNET_DATA_CONFIG_H_
 
 #define	RMNET_DATA_MAX_LOGICAL_EP	32
+#define RMNET_MAP_AGG_DEPTH_BUCKETS	6
 
 struct rmnet_logical_ep_conf_s {
 	uint8_t refcount;
@@ -29,20 +32,40 @@ struct rmnet_logical_ep_conf_s {
 	struct net_device *egress_dev;
 };
 
+struct rmnet_map_agg_stats_s {
+	uint64_t packets;
+	uint64_t frames;
+	uint32_t flush_size;
+	uint32_t flush_count;
+	uint32_t flush_timer;
+	uint32_t max_depth;
+	uint32_t depth[RMNET_MAP_AGG_DEPTH_BUCKETS];
+	uint64_t latency_total_us;
+	uint32_t latency_max_us;
+};
+
 struct rmnet_phys_ep_conf_s {
 	struct net_device *dev;
 	struct rmnet_logical_ep_conf_s local_ep;
 	struct rmnet_logical_ep_conf_s muxed_ep[RMNET_DATA_MAX_LOGICAL_EP];
 	uint32_t	ingress_data_format;
 	uint32_t	egress_data_format;
+	uint32_t	rps_mask;
 
 	
 	uint16_t egress_agg_size;
 	uint16_t egress_agg_count;
 	spinlock_t agg_lock;
 	struct sk_buff *agg_skb;
+	struct sk_buff *agg_tail;
 	uint8_t agg_state;
-	uint8_t agg_count;
+	uint16_t agg_count;
+	ktime_t agg_start;
+	ktime_t agg_deadline;
+	struct hrtimer agg_timer;
+	struct tasklet_struct agg_flush;
+	struct rmnet_map_agg_stats_s agg_stats;
+	struct dentry *agg_debugfs;
 };
 
 int rmnet_config_init(void);
@@ -55,6 +78,7 @@ int rmnet_set_egress_data_format(struct net_device *dev,
 				 uint32_t egress_data_format,
 				 uint16_t agg_size,
 				 uint16_t agg_count);
+int rmnet_set_rps_config(struct net_device *dev, uint32_t cpu_mask);
 int rmnet_associate_network_device(struct net_device *dev);
 int _rmnet_set_logical_endpoint_config(struct net_device *dev,
 				       int config_id,
@@ -180,6 +180,11 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 	uint8_t mux_id;
 	uint16_t len;
 
+	if (!pskb_may_pull(skb, sizeof(struct rmnet_map_header_s) + 1)) {
+		kfree_skb(skb);
+		return RX_HANDLER_CONSUMED;
+	}
+
 	mux_id = RMNET_MAP_GET_MUX_ID(skb);
 	len = RMNET_MAP_GET_LENGTH(skb) - RMNET_MAP_GET_PAD(skb);
 
@@ -205,7 +210,7 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	pskb_trim(skb, len);
 	__rmnet_data_set_skb_proto(skb);
 
 	return __rmnet_deliver_skb(skb, ep);
@@ -215,14 +220,28 @@ static rx_handler_result_t rmnet_map_ingress_handler(struct sk_buff *skb,
 					    struct rmnet_phys_ep_conf_s *config)
 {
 	struct sk_buff *skbn;
+	uint32_t offset = 0;
 	int rc, co = 0;
 
 	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_DEAGGREGATION) {
-		while ((skbn = rmnet_map_deaggregate(skb, config)) != 0) {
+		while ((skbn = rmnet_map_deaggregate(skb, config, &offset))
+		       != 0) {
 			LOGD("co=%d\n", co);
-			_rmnet_map_ingress_handler(skbn, config);
+			switch (_rmnet_map_ingress_handler(skbn, config)) {
+			case RX_HANDLER_ANOTHER:
+				rmnet_vnd_gro_receive(skbn, config->rps_mask);
+				break;
+
+			case RX_HANDLER_PASS:
+				kfree_skb(skbn);
+				break;
+
+			default:
+				break;
+			}
 			co++;
 		}
+		rmnet_vnd_gro_flush();
 		kfree_skb(skb);
 		rc = RX_HANDLER_CONSUMED;
 	} else {
@@ -16,11 +16,18 @@
  */
 
 #include <linux/types.h>
+#include <linux/module.h>
 #include <linux/rmnet_data.h>
 #include <linux/msm_rmnet.h>
 #include <linux/etherdevice.h>
 #include <linux/if_arp.h>
 #include <linux/spinlock.h>
+#include <linux/ipv6.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <net/ip.h>
 #include <net/pkt_sched.h>
 #include "rmnet_data_config.h"
 #include "rmnet_data_handlers.h"
@@ -29,6 +36,27 @@
 
 struct net_device *rmnet_devices[RMNET_DATA_MAX_VND];
 
+unsigned int rmnet_data_gro = 1;
+module_param(rmnet_data_gro, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_data_gro, "Pass deaggregated packets through GRO");
+
+struct rmnet_vnd_gro_s {
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
+	struct sk_buff_head process_queue;
+#ifdef CONFIG_SMP
+	struct call_single_data csd;
+#endif
+	uint32_t rx_local;
+	uint32_t rx_steered_out;
+	uint32_t rx_steered_in;
+	uint32_t rx_ipi;
+};
+
+static DEFINE_PER_CPU(struct rmnet_vnd_gro_s, rmnet_vnd_gro);
+static DEFINE_PER_CPU(uint32_t, rmnet_vnd_ipi_pending);
+static struct net_device rmnet_vnd_gro_dev;
+
 struct rmnet_vnd_private_s {
 	uint8_t qos_mode:1;
 	uint8_t reserved:7;
@@ -61,6 +89,223 @@ int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev)
 	return RX_HANDLER_PASS;
 }
 
+/*
+ * TCP GRO only coalesces segments with a verified checksum.  MAP carries
+ * no checksum offload, so compute the full packet sum once here; the
+ * stack then skips its own verification of the merged segment.
+ */
+static void rmnet_vnd_gro_csum(struct sk_buff *skb)
+{
+	uint8_t proto;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_IP):
+		if (!pskb_may_pull(skb, sizeof(struct iphdr)))
+			return;
+		if (ip_is_fragment(ip_hdr(skb)))
+			return;
+		proto = ip_hdr(skb)->protocol;
+		break;
+
+	case htons(ETH_P_IPV6):
+		if (!pskb_may_pull(skb, sizeof(struct ipv6hdr)))
+			return;
+		proto = ipv6_hdr(skb)->nexthdr;
+		break;
+
+	default:
+		return;
+	}
+
+	if (proto != IPPROTO_TCP)
+		return;
+
+	skb->csum = skb_checksum(skb, 0, skb->len, 0);
+	skb->ip_summed = CHECKSUM_COMPLETE;
+}
+
+/*
+ * rx_queue is fed by the cpu that owns it and by the cpus that steer
+ * flows to it.  As with the core backlog, whoever sets NAPI_STATE_SCHED
+ * kicks the poll, and the poll clears it under the queue lock once both
+ * queues are empty, so a packet queued remotely is never left behind.
+ */
+static int rmnet_vnd_gro_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_vnd_gro_s *gro;
+	struct sk_buff *skb;
+	int work = 0;
+
+	gro = container_of(napi, struct rmnet_vnd_gro_s, napi);
+	while (work < budget) {
+		skb = __skb_dequeue(&gro->process_queue);
+		if (skb) {
+			if (rmnet_data_gro)
+				napi_gro_receive(napi, skb);
+			else
+				netif_receive_skb(skb);
+			work++;
+			continue;
+		}
+
+		napi_gro_flush(napi);
+		local_irq_disable();
+		spin_lock(&gro->rx_queue.lock);
+		if (skb_queue_empty(&gro->rx_queue)) {
+			__napi_complete(napi);
+			spin_unlock(&gro->rx_queue.lock);
+			local_irq_enable();
+			break;
+		}
+		skb_queue_splice_tail_init(&gro->rx_queue,
+					   &gro->process_queue);
+		spin_unlock(&gro->rx_queue.lock);
+		local_irq_enable();
+	}
+
+	return work;
+}
+
+#ifdef CONFIG_SMP
+static void rmnet_vnd_gro_kick(void *info)
+{
+	struct rmnet_vnd_gro_s *gro = info;
+
+	gro->rx_ipi++;
+	__napi_schedule(&gro->napi);
+}
+
+/*
+ * Picks the cpu for @skb out of @mask by the hash of its inner IP
+ * 5-tuple, so that every packet of a flow is handled by the same cpu.
+ */
+static int rmnet_vnd_steer_cpu(struct sk_buff *skb, uint32_t mask)
+{
+	int cpu, n, idx;
+
+	mask &= cpumask_bits(cpu_online_mask)[0];
+	n = hweight32(mask);
+	if (n <= 1)
+		return n ? __ffs(mask) : smp_processor_id();
+
+	idx = ((u64)skb_get_rxhash(skb) * n) >> 32;
+	for_each_set_bit(cpu, (unsigned long *)&mask, 32)
+		if (idx-- == 0)
+			break;
+
+	return cpu;
+}
+#endif
+
+/*
+ * Deaggregated packets are queued on a per-cpu NAPI context instead of
+ * entering the stack one at a time, so that GRO can merge the segments
+ * of one MAP aggregate before they reach IP.  With a non-zero @rps_mask
+ * each flow is steered to one of the cpus in the mask; the target cpus
+ * are kicked by rmnet_vnd_gro_flush() once the aggregate is done.
+ */
+void rmnet_vnd_gro_receive(struct sk_buff *skb, uint32_t rps_mask)
+{
+	struct rmnet_vnd_gro_s *gro;
+	int cpu = smp_processor_id();
+	int target = cpu;
+	int kick;
+
+	skb_reset_mac_header(skb);
+	if (!rmnet_data_gro && !rps_mask) {
+		netif_receive_skb(skb);
+		return;
+	}
+
+	if (skb->ip_summed == CHECKSUM_NONE)
+		rmnet_vnd_gro_csum(skb);
+
+#ifdef CONFIG_SMP
+	if (rps_mask)
+		target = rmnet_vnd_steer_cpu(skb, rps_mask);
+#endif
+
+	gro = &per_cpu(rmnet_vnd_gro, target);
+	spin_lock(&gro->rx_queue.lock);
+	__skb_queue_tail(&gro->rx_queue, skb);
+	if (target != cpu)
+		gro->rx_steered_in++;
+	kick = !test_and_set_bit(NAPI_STATE_SCHED, &gro->napi.state);
+	spin_unlock(&gro->rx_queue.lock);
+
+	if (target == cpu) {
+		gro->rx_local++;
+		if (kick)
+			__napi_schedule(&gro->napi);
+		return;
+	}
+
+	per_cpu(rmnet_vnd_gro, cpu).rx_steered_out++;
+	if (kick)
+		__get_cpu_var(rmnet_vnd_ipi_pending) |= 1 << target;
+}
+
+void rmnet_vnd_gro_flush(void)
+{
+#ifdef CONFIG_SMP
+	uint32_t pending = __get_cpu_var(rmnet_vnd_ipi_pending);
+	int cpu;
+
+	if (!pending)
+		return;
+
+	__get_cpu_var(rmnet_vnd_ipi_pending) = 0;
+	for_each_set_bit(cpu, (unsigned long *)&pending, 32)
+		__smp_call_function_single(cpu,
+				&per_cpu(rmnet_vnd_gro, cpu).csd, 0);
+#endif
+}
+
+static int rmnet_vnd_rps_stats_show(struct seq_file *s, void *unused)
+{
+	int cpu;
+
+	seq_puts(s, "cpu local steered_out steered_in ipi\n");
+	for_each_possible_cpu(cpu) {
+		struct rmnet_vnd_gro_s *gro = &per_cpu(rmnet_vnd_gro, cpu);
+
+		seq_printf(s, "%d %u %u %u %u\n", cpu, gro->rx_local,
+			   gro->rx_steered_out, gro->rx_steered_in,
+			   gro->rx_ipi);
+	}
+	return 0;
+}
+
+static int rmnet_vnd_rps_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rmnet_vnd_rps_stats_show, 0);
+}
+
+static ssize_t rmnet_vnd_rps_stats_write(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rmnet_vnd_gro_s *gro = &per_cpu(rmnet_vnd_gro, cpu);
+
+		gro->rx_local = 0;
+		gro->rx_steered_out = 0;
+		gro->rx_steered_in = 0;
+		gro->rx_ipi = 0;
+	}
+	return count;
+}
+
+static const struct file_operations rmnet_vnd_rps_stats_fops = {
+	.open		= rmnet_vnd_rps_stats_open,
+	.read		= seq_read,
+	.write		= rmnet_vnd_rps_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int rmnet_vnd_tx_fixup(struct sk_buff *skb, struct net_device *dev)
 {
 	struct rmnet_vnd_private_s *dev_conf;
@@ -254,12 +499,43 @@ void rmnet_vnd_exit(void)
 			unregister_netdev(rmnet_devices[i]);
 			free_netdev(rmnet_devices[i]);
 	}
+
+	for_each_possible_cpu(i) {
+		struct rmnet_vnd_gro_s *gro = &per_cpu(rmnet_vnd_gro, i);
+
+		napi_disable(&gro->napi);
+		netif_napi_del(&gro->napi);
+		skb_queue_purge(&gro->rx_queue);
+		skb_queue_purge(&gro->process_queue);
+	}
 }
 
 int rmnet_vnd_init(void)
 {
+	int cpu;
+
 	memset(rmnet_devices, 0,
 	       sizeof(struct net_device *) * RMNET_DATA_MAX_VND);
+
+	init_dummy_netdev(&rmnet_vnd_gro_dev);
+	for_each_possible_cpu(cpu) {
+		struct rmnet_vnd_gro_s *gro = &per_cpu(rmnet_vnd_gro, cpu);
+
+		skb_queue_head_init(&gro->rx_queue);
+		skb_queue_head_init(&gro->process_queue);
+#ifdef CONFIG_SMP
+		gro->csd.func = rmnet_vnd_gro_kick;
+		gro->csd.info = gro;
+#endif
+		netif_napi_add(&rmnet_vnd_gro_dev, &gro->napi,
+			       rmnet_vnd_gro_poll, 64);
+		napi_enable(&gro->napi);
+	}
+
+	if (rmnet_map_debugfs_dir())
+		debugfs_create_file("rps", S_IRUGO | S_IWUSR,
+				    rmnet_map_debugfs_dir(), 0,
+				    &rmnet_vnd_rps_stats_fops);
 	return 0;
 }
 
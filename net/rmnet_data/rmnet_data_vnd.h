@@ -26,6 +26,8 @@ struct rmnet_logical_ep_conf_s *rmnet_vnd_get_le_config(struct net_device *dev);
 int rmnet_vnd_create_dev(int id, struct net_device **new_device);
 int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev);
 int rmnet_vnd_tx_fixup(struct sk_buff *skb, struct net_device *dev);
+void rmnet_vnd_gro_receive(struct sk_buff *skb, uint32_t rps_mask);
+void rmnet_vnd_gro_flush(void);
 int rmnet_vnd_is_vnd(struct net_device *dev);
 int rmnet_vnd_init(void);
 void rmnet_vnd_exit(void);
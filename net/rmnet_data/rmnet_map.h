@@ -18,6 +18,7 @@
 #define _RMNET_MAP_H_
 
 #define RMNET_MAP_MAX_FLOWS 8
+#define RMNET_MAP_DEAGG_HEADER_ROOM 128
 
 struct rmnet_map_header_s {
 #ifndef RMNET_USE_BIG_ENDIAN_STRUCTS
@@ -117,7 +118,8 @@ enum rmnet_map_commands_e {
 
 enum rmnet_map_agg_state_e {
 	RMNET_MAP_AGG_IDLE,
-	RMNET_MAP_TXFER_SCHEDULED
+	RMNET_MAP_TXFER_SCHEDULED,
+	RMNET_MAP_AGG_STOPPED
 };
 
 #define RMNET_MAP_P_ICMP4  0x01
@@ -132,7 +134,8 @@ enum rmnet_map_agg_state_e {
 
 uint8_t rmnet_map_demultiplex(struct sk_buff *skb);
 struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
-				      struct rmnet_phys_ep_conf_s *config);
+				      struct rmnet_phys_ep_conf_s *config,
+				      uint32_t *offset);
 
 #define RMNET_MAP_GET_MUX_ID(Y) (((struct rmnet_map_header_s *)Y->data)->mux_id)
 #define RMNET_MAP_GET_CD_BIT(Y) (((struct rmnet_map_header_s *)Y->data)->cd_bit)
@@ -148,5 +151,9 @@ rx_handler_result_t rmnet_map_command(struct sk_buff *skb,
 				      struct rmnet_phys_ep_conf_s *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_agg_init(struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_agg_exit(struct rmnet_phys_ep_conf_s *config);
+struct dentry *rmnet_map_debugfs_dir(void);
+void rmnet_map_debugfs_exit(void);
 
 #endif 
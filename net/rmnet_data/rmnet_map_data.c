@@ -20,15 +20,21 @@
 #include <linux/netdevice.h>
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
-#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "rmnet_data_config.h"
 #include "rmnet_map.h"
 #include "rmnet_data_private.h"
 
-struct agg_work {
-	struct delayed_work work;
-	struct rmnet_phys_ep_conf_s *config;
-};
+unsigned int rmnet_map_agg_time_us = 1000;
+module_param(rmnet_map_agg_time_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_map_agg_time_us,
+		 "Maximum time a packet waits in the egress aggregate");
+
+static struct dentry *rmnet_map_debugfs_root;
 
 
 struct rmnet_map_header_s *rmnet_map_add_map_header(struct sk_buff *skb,
@@ -61,146 +67,438 @@ struct rmnet_map_header_s *rmnet_map_add_map_header(struct sk_buff *skb,
 	return map_header;
 }
 
+static struct sk_buff *rmnet_map_deaggregate_frags(struct sk_buff *skb,
+						   uint32_t offset,
+						   uint32_t len)
+{
+	struct sk_buff *skbn;
+	uint32_t hlen, copy, start, end;
+	int i, nr_frags = 0;
+
+	hlen = skb_headlen(skb);
+	copy = offset < hlen ? min(hlen - offset, len) : 0;
+
+	skbn = netdev_alloc_skb(skb->dev,
+			max_t(uint32_t, copy, RMNET_MAP_DEAGG_HEADER_ROOM));
+	if (!skbn)
+		return 0;
+
+	if (copy) {
+		memcpy(skb_put(skbn, copy), skb->data + offset, copy);
+		offset += copy;
+		len -= copy;
+	}
+
+	start = hlen;
+	for (i = 0; len && i < skb_shinfo(skb)->nr_frags; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		end = start + skb_frag_size(frag);
+		if (offset < end) {
+			struct page *page = skb_frag_page(frag);
+
+			if (nr_frags == MAX_SKB_FRAGS)
+				goto fail;
+
+			/*
+			 * Each packet keeps the whole page alive, so charge
+			 * the socket for all of it, not just the bytes used.
+			 */
+			copy = min(end - offset, len);
+			__skb_frag_ref(frag);
+			skb_add_rx_frag(skbn, nr_frags++, page,
+					frag->page_offset + offset - start,
+					copy, PAGE_SIZE <<
+					compound_order(compound_head(page)));
+			offset += copy;
+			len -= copy;
+		}
+		start = end;
+	}
+
+	
+	if (len)
+		goto fail;
+
+	return skbn;
+
+fail:
+	kfree_skb(skbn);
+	return 0;
+}
+
+/*
+ * Returns the MAP packet at *offset in the aggregate @skb and advances
+ * *offset past it; the aggregate itself is left untouched.  Packets of
+ * a page based aggregate reference its pages instead of cloning it.
+ */
 struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
-				      struct rmnet_phys_ep_conf_s *config)
+				      struct rmnet_phys_ep_conf_s *config,
+				      uint32_t *offset)
 {
 	struct sk_buff *skbn;
-	struct rmnet_map_header_s *maph;
+	struct rmnet_map_header_s *maph, maph_buf;
 	uint32_t packet_len;
-	uint8_t ip_byte;
+	uint8_t *ip_byte, ip_buf;
 
-	if (skb->len == 0)
+	if (*offset >= skb->len)
+		return 0;
+
+	maph = skb_header_pointer(skb, *offset, sizeof(maph_buf), &maph_buf);
+	if (!maph)
 		return 0;
 
-	maph = (struct rmnet_map_header_s *) skb->data;
 	packet_len = ntohs(maph->pkt_len) + sizeof(struct rmnet_map_header_s);
-	if ((((int)skb->len) - ((int)packet_len)) < 0) {
+	if (skb->len - *offset < packet_len) {
 		LOGM("%s(): Got malformed packet. Dropping\n", __func__);
 		return 0;
 	}
 
-	skbn = skb_clone(skb, GFP_ATOMIC);
-	if (!skbn)
+	
+	ip_byte = skb_header_pointer(skb, *offset + sizeof(maph_buf), 1,
+				     &ip_buf);
+	if (!ip_byte || ((*ip_byte & 0xF0) != 0x40 &&
+			 (*ip_byte & 0xF0) != 0x60)) {
+		LOGM("%s() Unknown IP type: 0x%02X\n", __func__,
+		     ip_byte ? *ip_byte & 0xF0 : 0);
 		return 0;
+	}
 
-	LOGD("Trimming to %d bytes\n", packet_len);
-	LOGD("before skbn->len = %d", skbn->len);
-	skb_trim(skbn, packet_len);
-	skb_pull(skb, packet_len);
-	LOGD("after skbn->len = %d", skbn->len);
+	if (skb_is_nonlinear(skb)) {
+		skbn = rmnet_map_deaggregate_frags(skb, *offset, packet_len);
+		if (!skbn)
+			return 0;
+		skbn->protocol = skb->protocol;
+	} else {
+		skbn = skb_clone(skb, GFP_ATOMIC);
+		if (!skbn)
+			return 0;
 
-	
-	ip_byte = (skbn->data[4]) & 0xF0;
-	if (ip_byte != 0x40 && ip_byte != 0x60) {
-		LOGM("%s() Unknown IP type: 0x%02X\n", __func__, ip_byte);
-		kfree_skb(skbn);
-		return 0;
+		LOGD("Trimming to %d bytes\n", packet_len);
+		skb_pull(skbn, *offset);
+		skb_trim(skbn, packet_len);
 	}
 
+	*offset += packet_len;
 	return skbn;
 }
 
-static void rmnet_map_flush_packet_queue(struct work_struct *work)
+enum rmnet_map_flush_reason_e {
+	RMNET_MAP_FLUSH_SIZE,
+	RMNET_MAP_FLUSH_COUNT,
+	RMNET_MAP_FLUSH_TIMER
+};
+
+/*
+ * Takes the pending aggregate off @config and accounts for it.  Must be
+ * called with agg_lock held; the caller transmits the result after
+ * dropping the lock.
+ */
+static struct sk_buff *rmnet_map_agg_detach(struct rmnet_phys_ep_conf_s *config,
+					    int reason)
+{
+	struct rmnet_map_agg_stats_s *stats = &config->agg_stats;
+	struct sk_buff *skb = config->agg_skb;
+	uint32_t latency;
+	int bucket;
+
+	if (!skb)
+		return 0;
+
+	latency = (uint32_t)ktime_us_delta(ktime_get(), config->agg_start);
+	stats->frames++;
+	stats->packets += config->agg_count;
+	stats->latency_total_us += latency;
+	if (latency > stats->latency_max_us)
+		stats->latency_max_us = latency;
+	if (config->agg_count > stats->max_depth)
+		stats->max_depth = config->agg_count;
+	bucket = min(fls(config->agg_count) - 1,
+		     RMNET_MAP_AGG_DEPTH_BUCKETS - 1);
+	stats->depth[bucket]++;
+
+	switch (reason) {
+	case RMNET_MAP_FLUSH_SIZE:
+		stats->flush_size++;
+		break;
+	case RMNET_MAP_FLUSH_COUNT:
+		stats->flush_count++;
+		break;
+	default:
+		stats->flush_timer++;
+		break;
+	}
+
+	if (config->agg_count > 1)
+		LOGL("Agg count: %d\n", config->agg_count);
+
+	config->agg_skb = 0;
+	config->agg_tail = 0;
+	config->agg_count = 0;
+	if (reason != RMNET_MAP_FLUSH_TIMER)
+		hrtimer_try_to_cancel(&config->agg_timer);
+	config->agg_state = RMNET_MAP_AGG_IDLE;
+
+	return skb;
+}
+
+static void rmnet_map_flush_packet_queue(unsigned long data)
 {
-	struct agg_work *real_work;
 	struct rmnet_phys_ep_conf_s *config;
 	unsigned long flags;
 	struct sk_buff *skb;
 
-	skb = 0;
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
-	LOGD("Entering flush thread\n");
+	config = (struct rmnet_phys_ep_conf_s *)data;
+	LOGD("Entering flush tasklet\n");
 	spin_lock_irqsave(&config->agg_lock, flags);
-	if (likely(config->agg_state == RMNET_MAP_TXFER_SCHEDULED)) {
-		if (likely(config->agg_skb)) {
-			
-			if (config->agg_count > 1)
-				LOGL("Agg count: %d\n", config->agg_count);
-			skb = config->agg_skb;
-			config->agg_skb = 0;
-		}
-		config->agg_state = RMNET_MAP_AGG_IDLE;
-	} else {
-		
-		LOGE("%s(): Ran queued command when state %s\n",
-			"is idle. State machine likely broken", __func__);
-	}
-
+	/*
+	 * The timer of an aggregate that was already sent for size or
+	 * count may still have run; leave a newer aggregate to its own
+	 * timer.
+	 */
+	if (config->agg_skb &&
+	    ktime_to_ns(ktime_sub(ktime_get(), config->agg_deadline)) < 0)
+		skb = 0;
+	else
+		skb = rmnet_map_agg_detach(config, RMNET_MAP_FLUSH_TIMER);
 	spin_unlock_irqrestore(&config->agg_lock, flags);
+
 	if (skb)
 		dev_queue_xmit(skb);
-	kfree(work);
 }
 
+static enum hrtimer_restart rmnet_map_agg_timer_fn(struct hrtimer *t)
+{
+	struct rmnet_phys_ep_conf_s *config;
+
+	config = container_of(t, struct rmnet_phys_ep_conf_s, agg_timer);
+	tasklet_schedule(&config->agg_flush);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Opens a new aggregate with @skb.  If the physical device advertises
+ * NETIF_F_FRAGLIST the packets are chained on the frag_list of an empty
+ * head; otherwise they are copied into one linear buffer sized for
+ * egress_agg_size and the caller frees @skb.
+ */
+static struct sk_buff *rmnet_map_agg_start(struct sk_buff *skb,
+					   struct rmnet_phys_ep_conf_s *config)
+{
+	struct sk_buff *head;
+
+	if (!(skb->dev->features & NETIF_F_FRAGLIST))
+		return skb_copy_expand(skb, 0,
+				       config->egress_agg_size - skb->len,
+				       GFP_ATOMIC);
+
+	head = alloc_skb(0, GFP_ATOMIC);
+	if (!head)
+		return 0;
+
+	head->dev = skb->dev;
+	head->protocol = skb->protocol;
+	head->priority = skb->priority;
+	skb_copy_queue_mapping(head, skb);
+	skb_reset_network_header(head);
+	skb_reset_transport_header(head);
+	skb_reset_mac_header(head);
+
+	skb->next = 0;
+	skb_shinfo(head)->frag_list = skb;
+	config->agg_tail = skb;
+	head->len = skb->len;
+	head->data_len = skb->len;
+	head->truesize += skb->truesize;
+	return head;
+}
+
+/*
+ * An aggregate is sent when the next packet would push it past
+ * egress_agg_size, when it holds egress_agg_count packets, or
+ * rmnet_map_agg_time_us after its first packet was queued.
+ */
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config) {
-	uint8_t *dest_buff;
-	struct agg_work *work;
+	struct sk_buff *agg_skb = 0;
+	struct sk_buff *full_skb = 0;
+	struct sk_buff *copied = 0;
+	struct sk_buff *head;
 	unsigned long flags;
-	struct sk_buff *agg_skb;
-	int size;
-
 
 	if (!skb || !config)
 		BUG();
-	size = config->egress_agg_size-skb->len;
 
-	if (size < 2000) {
-		LOGL("Invalid length %d\n", size);
+	if (skb->len >= config->egress_agg_size) {
+		LOGL("Invalid length %d\n", skb->len);
+		dev_queue_xmit(skb);
 		return;
 	}
 
-new_packet:
 	spin_lock_irqsave(&config->agg_lock, flags);
-	if (!config->agg_skb) {
-		config->agg_skb = skb_copy_expand(skb, 0, size, GFP_ATOMIC);
-		if (!config->agg_skb) {
-			config->agg_skb = 0;
-			config->agg_count = 0;
+	if (config->agg_state == RMNET_MAP_AGG_STOPPED) {
+		spin_unlock_irqrestore(&config->agg_lock, flags);
+		dev_queue_xmit(skb);
+		return;
+	}
+
+	head = config->agg_skb;
+	if (head &&
+	    (skb->len > (config->egress_agg_size - head->len) ||
+	     (!skb_has_frag_list(head) && skb->len > skb_tailroom(head))))
+		agg_skb = rmnet_map_agg_detach(config, RMNET_MAP_FLUSH_SIZE);
+
+	head = config->agg_skb;
+	if (!head) {
+		head = rmnet_map_agg_start(skb, config);
+		if (!head) {
 			spin_unlock_irqrestore(&config->agg_lock, flags);
+			if (agg_skb)
+				dev_queue_xmit(agg_skb);
 			dev_queue_xmit(skb);
 			return;
 		}
-		config->agg_count = 1;
-		kfree_skb(skb);
-		goto schedule;
+		if (!skb_has_frag_list(head))
+			copied = skb;
+
+		config->agg_skb = head;
+		config->agg_start = ktime_get();
+		config->agg_deadline = ktime_add_us(config->agg_start,
+						    rmnet_map_agg_time_us);
+		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
+		hrtimer_start(&config->agg_timer, config->agg_deadline,
+			      HRTIMER_MODE_ABS);
+	} else if (skb_has_frag_list(head)) {
+		skb->next = 0;
+		config->agg_tail->next = skb;
+		config->agg_tail = skb;
+		head->len += skb->len;
+		head->data_len += skb->len;
+		head->truesize += skb->truesize;
+	} else {
+		skb_copy_bits(skb, 0, skb_put(head, skb->len), skb->len);
+		copied = skb;
 	}
+	config->agg_count++;
 
-	if (skb->len > (config->egress_agg_size - config->agg_skb->len)) {
-		if (config->agg_count > 1)
-			LOGL("Agg count: %d\n", config->agg_count);
-		agg_skb = config->agg_skb;
-		config->agg_skb = 0;
-		config->agg_count = 0;
-		spin_unlock_irqrestore(&config->agg_lock, flags);
+	if (config->egress_agg_count &&
+	    config->agg_count >= config->egress_agg_count)
+		full_skb = rmnet_map_agg_detach(config, RMNET_MAP_FLUSH_COUNT);
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+
+	if (copied)
+		consume_skb(copied);
+	if (agg_skb)
 		dev_queue_xmit(agg_skb);
-		goto new_packet;
-	}
+	if (full_skb)
+		dev_queue_xmit(full_skb);
+}
 
-	dest_buff = skb_put(config->agg_skb, skb->len);
-	memcpy(dest_buff, skb->data, skb->len);
-	config->agg_count++;
-	kfree_skb(skb);
-
-schedule:
-	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
-		work = (struct agg_work *)
-			kmalloc(sizeof(struct agg_work), GFP_ATOMIC);
-		if (!work) {
-			LOGE("%s(): Failed to allocate work item for packet %s",
-			     "transfer. DATA PATH LIKELY BROKEN!\n", __func__);
-			config->agg_state = RMNET_MAP_AGG_IDLE;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			return;
-		}
-		INIT_DELAYED_WORK((struct delayed_work *)work,
-				  rmnet_map_flush_packet_queue);
-		work->config = config;
-		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		schedule_delayed_work((struct delayed_work *)work, 1);
+static int rmnet_map_agg_stats_show(struct seq_file *s, void *unused)
+{
+	struct rmnet_phys_ep_conf_s *config = s->private;
+	struct rmnet_map_agg_stats_s stats;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	stats = config->agg_stats;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+
+	seq_printf(s, "packets: %llu\n", stats.packets);
+	seq_printf(s, "frames: %llu\n", stats.frames);
+	seq_printf(s, "flush_size: %u\n", stats.flush_size);
+	seq_printf(s, "flush_count: %u\n", stats.flush_count);
+	seq_printf(s, "flush_timer: %u\n", stats.flush_timer);
+	seq_printf(s, "max_depth: %u\n", stats.max_depth);
+	seq_puts(s, "depth:");
+	for (i = 0; i < RMNET_MAP_AGG_DEPTH_BUCKETS; i++)
+		seq_printf(s, " %u", stats.depth[i]);
+	seq_puts(s, "\n");
+	seq_printf(s, "latency_avg_us: %llu\n", stats.frames ?
+		   div64_u64(stats.latency_total_us, stats.frames) : 0);
+	seq_printf(s, "latency_max_us: %u\n", stats.latency_max_us);
+	return 0;
+}
+
+static int rmnet_map_agg_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rmnet_map_agg_stats_show, inode->i_private);
+}
+
+static ssize_t rmnet_map_agg_stats_write(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct rmnet_phys_ep_conf_s *config = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	memset(&config->agg_stats, 0, sizeof(config->agg_stats));
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+	return count;
+}
+
+static const struct file_operations rmnet_map_agg_stats_fops = {
+	.open		= rmnet_map_agg_stats_open,
+	.read		= seq_read,
+	.write		= rmnet_map_agg_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+struct dentry *rmnet_map_debugfs_dir(void)
+{
+	if (!rmnet_map_debugfs_root)
+		rmnet_map_debugfs_root = debugfs_create_dir("rmnet_data", 0);
+	if (IS_ERR_OR_NULL(rmnet_map_debugfs_root)) {
+		rmnet_map_debugfs_root = 0;
+		return 0;
 	}
+	return rmnet_map_debugfs_root;
+}
+
+void rmnet_map_agg_init(struct rmnet_phys_ep_conf_s *config)
+{
+	hrtimer_init(&config->agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	config->agg_timer.function = rmnet_map_agg_timer_fn;
+	tasklet_init(&config->agg_flush, rmnet_map_flush_packet_queue,
+		     (unsigned long)config);
+
+	if (rmnet_map_debugfs_dir())
+		config->agg_debugfs = debugfs_create_file(config->dev->name,
+						S_IRUGO | S_IWUSR,
+						rmnet_map_debugfs_root, config,
+						&rmnet_map_agg_stats_fops);
+}
+
+void rmnet_map_agg_exit(struct rmnet_phys_ep_conf_s *config)
+{
+	unsigned long flags;
+	struct sk_buff *skb;
+
+	debugfs_remove(config->agg_debugfs);
+	config->agg_debugfs = 0;
+
+	/* Egress racing with teardown now transmits unaggregated. */
+	spin_lock_irqsave(&config->agg_lock, flags);
+	skb = config->agg_skb;
+	config->agg_skb = 0;
+	config->agg_tail = 0;
+	config->agg_count = 0;
+	config->agg_state = RMNET_MAP_AGG_STOPPED;
 	spin_unlock_irqrestore(&config->agg_lock, flags);
-	return;
+
+	hrtimer_cancel(&config->agg_timer);
+	tasklet_kill(&config->agg_flush);
+
+	if (skb)
+		kfree_skb(skb);
 }
 
+void rmnet_map_debugfs_exit(void)
+{
+	debugfs_remove_recursive(rmnet_map_debugfs_root);
+	rmnet_map_debugfs_root = 0;
+}